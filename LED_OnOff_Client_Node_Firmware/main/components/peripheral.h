@@ -76,6 +76,10 @@ void run_client_as_delay(uint8_t* code, node_type node, uint8_t* current_count,
 
 void run_light_as_delay(effect effect_used, colour colour_used, uint8_t* current_count, uint16_t delay_repititions);
 
+void effect_wake(void);
+
+void power_init(void);
+
 void display_code(uint8_t code);
 
 void publish_msg(uint8_t code);
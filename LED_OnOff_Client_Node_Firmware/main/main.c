@@ -11,6 +11,7 @@
 
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "esp_timer.h"
 
 #include "esp_ble_mesh_common_api.h"
 #include "esp_ble_mesh_provisioning_api.h"
@@ -30,6 +31,11 @@
 
 #define CID_ESP 0x02E5
 
+/* Role of the node in its device UUID, after the match prefix and the Bluetooth address.
+ * The provisioner configures the node from the template of the role */
+#define NODE_ROLE_UUID_OFFSET   (2 + BD_ADDR_LEN)
+#define NODE_ROLE               0x02    /* OnOff client */
+
 static uint8_t dev_uuid[16] = { 0x32, 0x10 };
 static node_type used_node_type = BUTTONS_VIB_NODE;
 
@@ -159,6 +165,7 @@ static void example_ble_mesh_provisioning_cb(esp_ble_mesh_prov_cb_event_t event,
         ESP_LOGI(TAG, "ESP_BLE_MESH_NODE_PROV_LINK_OPEN_EVT, bearer %s",
             param->node_prov_link_open.bearer == ESP_BLE_MESH_PROV_ADV ? "PB-ADV" : "PB-GATT");
         indicator_code = get_indicator_code(PURPLE, STATIC, OFF);
+        effect_wake();
         break;
     case ESP_BLE_MESH_NODE_PROV_LINK_CLOSE_EVT:
         ESP_LOGI(TAG, "ESP_BLE_MESH_NODE_PROV_LINK_CLOSE_EVT, bearer %s",
@@ -295,8 +302,12 @@ static void example_ble_mesh_config_server_cb(esp_ble_mesh_cfg_server_cb_event_t
             ESP_LOG_BUFFER_HEX("AppKey", param->value.state_change.appkey_add.app_key, 16);
 
             root_models[1].keys[0] = param->value.state_change.appkey_add.app_idx;
+            /* The client sends with this AppKey without being bound, kept to restore it after a reset */
+            store.app_idx = param->value.state_change.appkey_add.app_idx;
+            mesh_example_info_store(); /* Store proper mesh example info */
 
             indicator_code = get_indicator_code(PURPLE, LED_OFF, OFF);
+            effect_wake();
 
             HAS_APPKEY = true;
             break;
@@ -354,6 +365,7 @@ void app_main(void)
     ESP_LOGI(TAG, "Initializing...");
 
     LED_init();
+    power_init();
     indicator_code = get_indicator_code(CYAN, BLINKING, OFF);
 
     err = nvs_flash_init();
@@ -376,6 +388,7 @@ void app_main(void)
     }
 
     ble_mesh_get_dev_uuid(dev_uuid);
+    dev_uuid[NODE_ROLE_UUID_OFFSET] = NODE_ROLE;
 
     /* Initialize the Bluetooth Mesh Subsystem */
     err = ble_mesh_init();
@@ -383,6 +396,19 @@ void app_main(void)
         ESP_LOGE(TAG, "Bluetooth mesh init failed (err %d)", err);
     }
 
+    /* With CONFIG_BLE_MESH_SETTINGS the stack has restored the keys and the sequence number of a node
+     * provisioned before the reset, it is operational again without the provisioner */
+    if (esp_ble_mesh_node_is_provisioned()) {
+        mesh_example_info_restore();
+        if (store.app_idx != ESP_BLE_MESH_KEY_UNUSED) {
+            root_models[1].keys[0] = store.app_idx;
+            indicator_code = get_indicator_code(PURPLE, LED_OFF, OFF);
+            effect_wake();
+            HAS_APPKEY = true;
+            ESP_LOGI(TAG, "Mesh state restored, operational %u ms after reset", (uint32_t) (esp_timer_get_time() / 1000));
+        }
+    }
+
     while(1){
     	printf("counter = %d \n", counter);
     	run_client_as_delay(&indicator_code, used_node_type, &count,  &buzzer_count, 50);
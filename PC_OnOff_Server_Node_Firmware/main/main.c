@@ -10,6 +10,7 @@
 
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "esp_timer.h"
 
 #include "esp_ble_mesh_defs.h"
 #include "esp_ble_mesh_common_api.h"
@@ -22,12 +23,18 @@
 #include "components/peripheral.h"
 
 #include "ble_mesh_example_init.h"
+#include "ble_mesh_example_nvs.h"
 
 #define TAG "MAIN"
 #define TEST_TAG "TEST"
 
 #define CID_ESP 0x02E5
 
+/* Role of the node in its device UUID, after the match prefix and the Bluetooth address.
+ * The provisioner configures the node from the template of the role */
+#define NODE_ROLE_UUID_OFFSET   (2 + BD_ADDR_LEN)
+#define NODE_ROLE               0x03    /* OnOff server */
+
 static uint8_t dev_uuid[16] = { 0x32, 0x10 };
 
 colour colour_used = CYAN;
@@ -35,6 +42,10 @@ effect effect_used = BLINKING;
 
 static int8_t HAS_APPKEY = false;   /* Flag is true when device is provisioned and has AppKey*/
 
+static nvs_handle_t NVS_HANDLE;
+static const char * NVS_KEY = "onoff_server";
+static uint16_t app_idx = ESP_BLE_MESH_KEY_UNUSED;   /* AppKey Index, kept in nvs to restore HAS_APPKEY */
+
 static esp_ble_mesh_cfg_srv_t config_server = {
     .relay = ESP_BLE_MESH_RELAY_DISABLED,
     .beacon = ESP_BLE_MESH_BEACON_ENABLED,
@@ -189,6 +200,7 @@ static void example_ble_mesh_provisioning_cb(esp_ble_mesh_prov_cb_event_t event,
             param->node_prov_link_open.bearer == ESP_BLE_MESH_PROV_ADV ? "PB-ADV" : "PB-GATT");
 		colour_used = PURPLE;
 		effect_used = STATIC;
+		effect_wake();
         break;
     case ESP_BLE_MESH_NODE_PROV_LINK_CLOSE_EVT:
         ESP_LOGI(TAG, "ESP_BLE_MESH_NODE_PROV_LINK_CLOSE_EVT, bearer %s",
@@ -205,6 +217,17 @@ static void example_ble_mesh_provisioning_cb(esp_ble_mesh_prov_cb_event_t event,
     case ESP_BLE_MESH_NODE_SET_UNPROV_DEV_NAME_COMP_EVT:
         ESP_LOGI(TAG, "ESP_BLE_MESH_NODE_SET_UNPROV_DEV_NAME_COMP_EVT, err_code %d", param->node_set_unprov_dev_name_comp.err_code);
         break;
+#if defined(CONFIG_BLE_MESH_FRIEND)
+    case ESP_BLE_MESH_FRIEND_FRIENDSHIP_ESTABLISH_EVT:
+        /* Messages to the Low Power Node are queued here until it polls */
+        ESP_LOGI(TAG, "ESP_BLE_MESH_FRIEND_FRIENDSHIP_ESTABLISH_EVT, lpn 0x%04x",
+            param->frnd_friendship_establish.lpn_addr);
+        break;
+    case ESP_BLE_MESH_FRIEND_FRIENDSHIP_TERMINATE_EVT:
+        ESP_LOGW(TAG, "ESP_BLE_MESH_FRIEND_FRIENDSHIP_TERMINATE_EVT, lpn 0x%04x, reason %d",
+            param->frnd_friendship_terminate.lpn_addr, param->frnd_friendship_terminate.reason);
+        break;
+#endif
     default:
         break;
     }
@@ -263,7 +286,10 @@ static void example_ble_mesh_config_server_cb(esp_ble_mesh_cfg_server_cb_event_t
                 param->value.state_change.appkey_add.net_idx,
                 param->value.state_change.appkey_add.app_idx);
             ESP_LOG_BUFFER_HEX("AppKey", param->value.state_change.appkey_add.app_key, 16);
+            app_idx = param->value.state_change.appkey_add.app_idx;
+            ble_mesh_nvs_store(NVS_HANDLE, NVS_KEY, &app_idx, sizeof(app_idx));
             HAS_APPKEY = true;
+            effect_wake();
             break;
         case ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND:
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND");
@@ -321,6 +347,7 @@ void app_main(void)
     ESP_LOGI(TAG, "Initializing...");
 
     LED_init();
+    power_init();
 	colour_used = CYAN;
 	effect_used = BLINKING;
 
@@ -337,7 +364,14 @@ void app_main(void)
         return;
     }
 
+    /* Open nvs namespace for storing/restoring the AppKey Index */
+    err = ble_mesh_nvs_open(&NVS_HANDLE);
+    if (err) {
+        return;
+    }
+
     ble_mesh_get_dev_uuid(dev_uuid);
+    dev_uuid[NODE_ROLE_UUID_OFFSET] = NODE_ROLE;
 
     /* Initialize the Bluetooth Mesh Subsystem */
     err = ble_mesh_init();
@@ -345,6 +379,19 @@ void app_main(void)
         ESP_LOGE(TAG, "Bluetooth mesh init failed (err %d)", err);
     }
 
+    /* With CONFIG_BLE_MESH_SETTINGS the stack has restored the keys, bindings and publications of a node
+     * provisioned before the reset, it is operational again without the provisioner */
+    if (esp_ble_mesh_node_is_provisioned()) {
+        bool exist = false;
+
+        ble_mesh_nvs_restore(NVS_HANDLE, NVS_KEY, &app_idx, sizeof(app_idx), &exist);
+        if (exist && app_idx != ESP_BLE_MESH_KEY_UNUSED) {
+            HAS_APPKEY = true;
+            effect_wake();
+            ESP_LOGI(TAG, "Mesh state restored, operational %u ms after reset", (uint32_t) (esp_timer_get_time() / 1000));
+        }
+    }
+
     set_AppKey(&HAS_APPKEY);
 
     while(1){
@@ -356,7 +403,7 @@ void app_main(void)
 
     	}
 
-    	run_light_as_delay(effect_used, colour_used, &count, 5);
+    	run_light_as_delay(effect_used, colour_used, &count, 50);
     }
 
 }
@@ -2,6 +2,9 @@
 #include <string.h>
 
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "nvs_flash.h"
 
 #include "esp_ble_mesh_defs.h"
@@ -17,22 +20,41 @@
 #include "ble_mesh_example_init.h"
 #include "LED.h"
 #include "peripheral.h"
+#include "node_db.h"
+#include "telemetry_decode.h"
 
 #define TAG "BLE_Mesh"
 #define DATA_TAG "DATA"
 #define CONTROL_TAG "CONTROL"
+#define BACKFILL_TAG "BACKFILL"
 #define CID_ESP             0x02E5
 
 
+/* Backfill vendor models, the sensor node logs its samples and replays the ones the gateway missed.
+ * See backfill.h of the sensor node for the message layout */
+#define BACKFILL_MODEL_ID_SERVER    0x0010
+#define BACKFILL_MODEL_ID_CLIENT    0x0011
+#define BACKFILL_OP_STATUS          ESP_BLE_MESH_MODEL_OP_3(0x01, CID_ESP)
+#define BACKFILL_OP_ACK             ESP_BLE_MESH_MODEL_OP_3(0x02, CID_ESP)
+#define BACKFILL_OP_GET             ESP_BLE_MESH_MODEL_OP_3(0x03, CID_ESP)
+#define BACKFILL_OP_DATA            ESP_BLE_MESH_MODEL_OP_3(0x04, CID_ESP)
+
+/* Delta encoded sample batches of the sensor node, published by its telemetry server.
+ * See telemetry.h of the sensor node for the message layout */
+#define TELEMETRY_MODEL_ID_SERVER   0x0012
+#define TELEMETRY_OP_BATCH          ESP_BLE_MESH_MODEL_OP_3(0x05, CID_ESP)
+
+
 #define BYTES_PER_LINE 16
 
 
+
 #define PROV_OWN_ADDR       0x0001
 
 
 #define MSG_SEND_TTL        3
 #define MSG_SEND_REL        false
-#define MSG_TIMEOUT         0
+#define MSG_TIMEOUT         5000    /* ms without status until a timeout event, a configuration step is then sent again */
 #define MSG_ROLE            ROLE_PROVISIONER
 
 
@@ -43,12 +65,165 @@
 #define APP_KEY_OCTET       0x12
 
 
+/* Configuration of the nodes after provisioning. Every node being configured has a job that sends one message
+ * at a time and goes to the next step on its status, up to CONFIG_PARALLEL_NODES nodes are configured at the
+ * same time. A step without status, or whose message could not be sent, is sent again after a backoff that doubles
+ * every retry. A node of which a step fails CONFIG_STEP_RETRIES more times is left until the next boot. Nodes wait
+ * in the node database, unconfigured, for a free job. Resends and the hand out of free jobs run from a timer, so a
+ * job that ends never starts the next one inside the call that ended it */
+#define CONFIG_PARALLEL_NODES   4
+#define CONFIG_STEP_RETRIES     3
+#define CONFIG_RETRY_BACKOFF_MS 250                                     /* before the first resend */
+
+
+/* Publication of the Sensor Server on every element of a sensor node, the node publishes its Sensor Status
+ * at this period. Publish Period: 6 bit step count with the resolution in the top 2 bits (100 ms, 1 s, 10 s, 10 min) */
+#define SENSOR_PUB_ADDR         0xFFFF
+#define SENSOR_PUB_TTL          7
+#define SENSOR_PUB_PERIOD       ((0x01 << 6) | 1)                       /* 1 s */
+#define SENSOR_PUB_RETRANSMIT   ESP_BLE_MESH_PUBLISH_TRANSMIT(0, 50)    /* no retransmissions */
+
+/* Publication of the OnOff Server on every element of the PC node, a server publishes its OnOff Status when it
+ * changes. The clients send to all nodes (0xFFFF), so the servers are not subscribed to any group */
+#define ONOFF_PUB_ADDR          0xFFFF
+#define ONOFF_PUB_TTL           7
+#define ONOFF_PUB_PERIOD        0                                       /* only on a change */
+#define ONOFF_PUB_RETRANSMIT    ESP_BLE_MESH_PUBLISH_TRANSMIT(0, 50)
+
+
+/* Role of a node in its device UUID, after the match prefix and the Bluetooth address that ble_mesh_get_dev_uuid
+ * puts there. The nodes use the same values, a node without a known role is configured from its Composition Data */
+#define NODE_ROLE_UUID_OFFSET   (2 + BD_ADDR_LEN)
+#define NODE_ROLE_UNKNOWN       0x00
+#define NODE_ROLE_SENSOR        0x01
+#define NODE_ROLE_ONOFF_CLIENT  0x02                                    /* LED and relay nodes */
+#define NODE_ROLE_ONOFF_SERVER  0x03                                    /* PC node */
+#define NODE_ROLE_COUNT         4
+
+
 #define COMP_DATA_1_OCTET(msg, offset)      (msg[offset])
 #define COMP_DATA_2_OCTET(msg, offset)      (msg[offset + 1] << 8 | msg[offset])
 
 
+struct backfill_status {
+    uint8_t  boot;
+    uint32_t first_sequence;
+    uint32_t next_sequence;
+} __attribute__((packed));
+
+struct backfill_data_header {
+    uint8_t  boot;
+    uint32_t uptime_s;
+    uint32_t first_sequence;
+    uint8_t  count;
+} __attribute__((packed));
+
+struct backfill_data_record {
+    uint8_t  offset;
+    uint8_t  boot;
+    uint8_t  zone;
+    uint16_t property_id;
+    uint32_t time_s;
+    int32_t  value;
+} __attribute__((packed));
+
+
+
+/* Properties of the sensor nodes, every encoding of a raw value has a property ID of its own (see encoding.h
+ * of the node), so a value is read from its property ID alone and printed in the units of the fine property */
+static const struct sensor_property_format {
+    uint16_t property_id;
+    bool     is_signed;
+    int32_t  step;              /* fine units per raw value unit */
+} sensor_property_formats[] = {
+    { 0x0075, true,  1 },       /* Precise Present Ambient Temperature, 0.01 C */
+    { 0x004F, true,  50 },      /* Present Ambient Temperature, the coarse 0x0075 in 0.5 C */
+    { 0x00A7, false, 1 },       /* Present Ambient Relative Humidity, 0.01 % */
+    { 0x0059, false, 1 },       /* Present Input Voltage, 1/64 V */
+};
+
+enum config_step {
+    CONFIG_STEP_COMP_DATA,              /* Config Composition Data Get, only when the role is not known */
+    CONFIG_STEP_APP_KEY,                /* Config AppKey Add */
+    CONFIG_STEP_ACTIONS,                /* the actions of the template of the role */
+    CONFIG_STEP_DONE,
+};
+
+enum config_action_type {
+    CONFIG_BIND,                        /* Config Model App Bind */
+    CONFIG_SUB,                         /* Config Model Subscription Add of addr */
+    CONFIG_PUB,                         /* Config Model Publication Set to addr */
+};
+
+struct config_action {
+    uint8_t  type;
+    bool     every_element;             /* on every element of the node, otherwise on the primary element */
+    uint16_t model_id;
+    uint16_t company_id;
+    uint16_t addr;
+    uint8_t  ttl;
+    uint8_t  period;
+    uint8_t  retransmit;
+};
+
+/* A sensor node with several sensor zones has a Sensor Server on every element, the backfill and telemetry
+ * servers are on the primary element */
+static const struct config_action sensor_actions[] = {
+    { .type = CONFIG_BIND, .every_element = true, .model_id = ESP_BLE_MESH_MODEL_ID_SENSOR_SRV, .company_id = ESP_BLE_MESH_CID_NVAL },
+    { .type = CONFIG_BIND, .every_element = true, .model_id = ESP_BLE_MESH_MODEL_ID_SENSOR_SETUP_SRV, .company_id = ESP_BLE_MESH_CID_NVAL },
+    { .type = CONFIG_BIND, .every_element = false, .model_id = BACKFILL_MODEL_ID_SERVER, .company_id = CID_ESP },
+    { .type = CONFIG_BIND, .every_element = false, .model_id = TELEMETRY_MODEL_ID_SERVER, .company_id = CID_ESP },
+    { .type = CONFIG_PUB, .every_element = true, .model_id = ESP_BLE_MESH_MODEL_ID_SENSOR_SRV, .company_id = ESP_BLE_MESH_CID_NVAL,
+      .addr = SENSOR_PUB_ADDR, .ttl = SENSOR_PUB_TTL, .period = SENSOR_PUB_PERIOD, .retransmit = SENSOR_PUB_RETRANSMIT },
+};
+
+/* The clients send to all nodes themselves, they keep the AppKey Index of the bind */
+static const struct config_action onoff_client_actions[] = {
+    { .type = CONFIG_BIND, .every_element = false, .model_id = ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI, .company_id = ESP_BLE_MESH_CID_NVAL },
+};
+
+static const struct config_action onoff_server_actions[] = {
+    { .type = CONFIG_BIND, .every_element = true, .model_id = ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV, .company_id = ESP_BLE_MESH_CID_NVAL },
+    { .type = CONFIG_PUB, .every_element = true, .model_id = ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV, .company_id = ESP_BLE_MESH_CID_NVAL,
+      .addr = ONOFF_PUB_ADDR, .ttl = ONOFF_PUB_TTL, .period = ONOFF_PUB_PERIOD, .retransmit = ONOFF_PUB_RETRANSMIT },
+};
+
+/* Configuration templates of the roles, what to bind, subscribe and publish after the AppKey Add */
+static const struct config_template {
+    const char *name;
+    const struct config_action *actions;
+    uint8_t action_count;
+} config_templates[NODE_ROLE_COUNT] = {
+    [NODE_ROLE_SENSOR]       = { "sensor", sensor_actions, ARRAY_SIZE(sensor_actions) },
+    [NODE_ROLE_ONOFF_CLIENT] = { "OnOff client", onoff_client_actions, ARRAY_SIZE(onoff_client_actions) },
+    [NODE_ROLE_ONOFF_SERVER] = { "OnOff server", onoff_server_actions, ARRAY_SIZE(onoff_server_actions) },
+};
+
+static struct config_job {
+    uint16_t addr;                      /* primary address of the node, unassigned when the job is free */
+    uint16_t element_addr;              /* element of the step */
+    const struct config_template *template; /* NULL while the role is not known */
+    uint8_t  step;
+    uint8_t  action;                    /* of the template during CONFIG_STEP_ACTIONS */
+    uint8_t  retries;                   /* of the step */
+    int64_t  resend_at;                 /* us, 0 when the step is not waiting to be sent again */
+    int64_t  start;                     /* us */
+} config_jobs[CONFIG_PARALLEL_NODES];
+
+/* The jobs are used from the mesh callbacks and from the timer, the lock is taken again by nested calls */
+static SemaphoreHandle_t config_lock = NULL;
+static esp_timer_handle_t config_timer = NULL;
+static bool config_schedule_pending;    /* free jobs are handed out at the next timer run */
+
+/* Throughput since the jobs were last all free */
+static struct {
+    uint8_t  active;
+    uint16_t configured;
+    uint16_t failed;
+    int64_t  start;                     /* us */
+} config_run;
+
 static uint8_t  dev_uuid[ESP_BLE_MESH_OCTET16_LEN];
-static uint16_t server_address = ESP_BLE_MESH_ADDR_UNASSIGNED;
 static uint16_t sensor_prop_id;
 
 
@@ -87,8 +262,28 @@ static esp_ble_mesh_model_t root_models[] = {
 	ESP_BLE_MESH_MODEL_GEN_ONOFF_CLI(&onoff_cli_pub, &onoff_client),
 };
 
+static esp_ble_mesh_client_op_pair_t backfill_op_pair[] = {
+    { BACKFILL_OP_GET, BACKFILL_OP_DATA },
+};
+
+static esp_ble_mesh_client_t backfill_client = {
+    .op_pair_size = ARRAY_SIZE(backfill_op_pair),
+    .op_pair = backfill_op_pair,
+};
+
+static esp_ble_mesh_model_op_t backfill_ops[] = {
+    ESP_BLE_MESH_MODEL_OP(BACKFILL_OP_STATUS, sizeof(struct backfill_status)),
+    ESP_BLE_MESH_MODEL_OP(BACKFILL_OP_DATA, sizeof(struct backfill_data_header)),
+    ESP_BLE_MESH_MODEL_OP(TELEMETRY_OP_BATCH, 2),
+    ESP_BLE_MESH_MODEL_OP_END,
+};
+
+static esp_ble_mesh_model_t vnd_models[] = {
+    ESP_BLE_MESH_VENDOR_MODEL(CID_ESP, BACKFILL_MODEL_ID_CLIENT, backfill_ops, NULL, &backfill_client),
+};
+
 static esp_ble_mesh_elem_t elements[] = {
-    ESP_BLE_MESH_ELEMENT(0, root_models, ESP_BLE_MESH_MODEL_NONE),
+    ESP_BLE_MESH_ELEMENT(0, root_models, vnd_models),
 };
 
 static esp_ble_mesh_comp_t composition = {
@@ -123,18 +318,21 @@ static void example_ble_mesh_set_msg_common(esp_ble_mesh_client_common_param_t *
 
 
 
+static void example_ble_mesh_config_schedule_later(void);
+
 static esp_err_t prov_complete(uint16_t node_index, const esp_ble_mesh_octet16_t uuid, uint16_t primary_addr, uint8_t element_num, uint16_t net_idx)
 {
-    esp_ble_mesh_client_common_param_t common = {0};
-    esp_ble_mesh_cfg_client_get_state_t get = {0};
-    esp_ble_mesh_node_t *node = NULL;
     char name[11] = {'\0'};
     esp_err_t err = ESP_OK;
 
     ESP_LOGI(TAG, "node_index %u, primary_addr 0x%04x, element_num %u, net_idx 0x%03x", node_index, primary_addr, element_num, net_idx);
     ESP_LOG_BUFFER_HEX("uuid", uuid, ESP_BLE_MESH_OCTET16_LEN);
 
-    server_address = primary_addr;
+    /* The database keeps what the configuration does to the node, a node provisioned again starts over */
+    err = node_db_add(primary_addr);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add node 0x%04x to the node database (err %d)", primary_addr, err);
+    }
 
     sprintf(name, "%s%02x", "NODE-", node_index);
     err = esp_ble_mesh_provisioner_set_node_name(node_index, name);
@@ -143,19 +341,8 @@ static esp_err_t prov_complete(uint16_t node_index, const esp_ble_mesh_octet16_t
         return ESP_FAIL;
     }
 
-    node = esp_ble_mesh_provisioner_get_node_with_addr(primary_addr);
-    if (node == NULL) {
-        ESP_LOGE(TAG, "Failed to get node 0x%04x info", primary_addr);
-        return ESP_FAIL;
-    }
-
-    example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET);
-    get.comp_data_get.page = COMP_DATA_PAGE_0;
-    err = esp_ble_mesh_config_client_get_state(&common, &get);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send Config Composition Data Get");
-        return ESP_FAIL;
-    }
+    /* The node is configured as soon as a job is free */
+    example_ble_mesh_config_schedule_later();
 
     return ESP_OK;
 }
@@ -176,6 +363,7 @@ static void recv_unprov_adv_pkt(uint8_t dev_uuid[ESP_BLE_MESH_OCTET16_LEN], uint
     ESP_LOG_BUFFER_HEX("Device address", addr, BD_ADDR_LEN);
     ESP_LOGI(TAG, "Address type 0x%02x, adv type 0x%02x", addr_type, adv_type);
     ESP_LOG_BUFFER_HEX("Device UUID", dev_uuid, ESP_BLE_MESH_OCTET16_LEN);
+    ESP_LOGI(TAG, "Node role 0x%02x", dev_uuid[NODE_ROLE_UUID_OFFSET]);
     ESP_LOGI(TAG, "oob info 0x%04x, bearer %s", oob_info, (bearer & ESP_BLE_MESH_PROV_ADV) ? "PB-ADV" : "PB-GATT");
 
     memcpy(add_dev.addr, addr, BD_ADDR_LEN);
@@ -201,6 +389,8 @@ static void example_ble_mesh_provisioning_cb(esp_ble_mesh_prov_cb_event_t event,
         break;
     case ESP_BLE_MESH_PROVISIONER_PROV_ENABLE_COMP_EVT:
         ESP_LOGI(TAG, "ESP_BLE_MESH_PROVISIONER_PROV_ENABLE_COMP_EVT, err_code %d", param->provisioner_prov_enable_comp.err_code);
+        /* Nodes of which the configuration did not finish before the restart go on */
+        example_ble_mesh_config_schedule_later();
         break;
     case ESP_BLE_MESH_PROVISIONER_PROV_DISABLE_COMP_EVT:
         ESP_LOGI(TAG, "ESP_BLE_MESH_PROVISIONER_PROV_DISABLE_COMP_EVT, err_code %d", param->provisioner_prov_disable_comp.err_code);
@@ -241,12 +431,16 @@ static void example_ble_mesh_provisioning_cb(esp_ble_mesh_prov_cb_event_t event,
             prov_key.app_idx = param->provisioner_add_app_key_comp.app_idx;
             esp_err_t err = esp_ble_mesh_provisioner_bind_app_key_to_local_model(PROV_OWN_ADDR, prov_key.app_idx, ESP_BLE_MESH_MODEL_ID_SENSOR_CLI, ESP_BLE_MESH_CID_NVAL);
             esp_err_t err2 = esp_ble_mesh_provisioner_bind_app_key_to_local_model(PROV_OWN_ADDR, prov_key.app_idx, ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI, ESP_BLE_MESH_CID_NVAL);
+            esp_err_t err3 = esp_ble_mesh_provisioner_bind_app_key_to_local_model(PROV_OWN_ADDR, prov_key.app_idx, BACKFILL_MODEL_ID_CLIENT, CID_ESP);
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "Failed to bind AppKey to sensor client");
             }
             if (err2 != ESP_OK) {
                 ESP_LOGE(TAG, "Failed to bind AppKey to onoff client");
             }
+            if (err3 != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to bind AppKey to backfill client");
+            }
         }
         break;
     case ESP_BLE_MESH_PROVISIONER_BIND_APP_KEY_TO_MODEL_COMP_EVT:
@@ -260,11 +454,13 @@ static void example_ble_mesh_provisioning_cb(esp_ble_mesh_prov_cb_event_t event,
     }
 }
 
-static void example_ble_mesh_parse_node_comp_data(const uint8_t *data, uint16_t length)
+static uint8_t example_ble_mesh_parse_node_comp_data(const uint8_t *data, uint16_t length)
+/* Logs the Composition Data, returns the role of which the template fits the models of the node */
 {
     uint16_t cid, pid, vid, crpl, feat;
     uint16_t loc, model_id, company_id;
     uint8_t nums, numv;
+    uint8_t role = NODE_ROLE_UNKNOWN;
     uint16_t offset;
     int i;
 
@@ -287,6 +483,13 @@ static void example_ble_mesh_parse_node_comp_data(const uint8_t *data, uint16_t
             model_id = COMP_DATA_2_OCTET(data, offset);
             ESP_LOGI(TAG, "* SIG Model ID 0x%04x *", model_id);
             offset += 2;
+            if (model_id == ESP_BLE_MESH_MODEL_ID_SENSOR_SRV) {
+                role = NODE_ROLE_SENSOR;
+            } else if (model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV && role != NODE_ROLE_SENSOR) {
+                role = NODE_ROLE_ONOFF_SERVER;
+            } else if (model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI && role == NODE_ROLE_UNKNOWN) {
+                role = NODE_ROLE_ONOFF_CLIENT;
+            }
         }
         for (i = 0; i < numv; i++) {
             company_id = COMP_DATA_2_OCTET(data, offset);
@@ -296,84 +499,445 @@ static void example_ble_mesh_parse_node_comp_data(const uint8_t *data, uint16_t
         }
     }
     ESP_LOGI(TAG, "******** Composition Data End ********");
+    return role;
 }
 
 
 
-static void example_ble_mesh_config_client_cb(esp_ble_mesh_cfg_client_cb_event_t event, esp_ble_mesh_cfg_client_cb_param_t *param)
+static uint8_t example_ble_mesh_bound_bit(uint16_t model_id, uint16_t company_id)
+/* NODE_DB_BOUND_ bit of a model of a node, 0 for models the database does not follow */
+{
+    if (company_id == CID_ESP) {
+        switch (model_id) {
+        case BACKFILL_MODEL_ID_SERVER:
+            return NODE_DB_BOUND_BACKFILL_SRV;
+        case TELEMETRY_MODEL_ID_SERVER:
+            return NODE_DB_BOUND_TELEMETRY_SRV;
+        default:
+            return 0;
+        }
+    }
+    switch (model_id) {
+    case ESP_BLE_MESH_MODEL_ID_SENSOR_SRV:
+        return NODE_DB_BOUND_SENSOR_SRV;
+    case ESP_BLE_MESH_MODEL_ID_SENSOR_SETUP_SRV:
+        return NODE_DB_BOUND_SENSOR_SETUP_SRV;
+    case ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV:
+        return NODE_DB_BOUND_ONOFF_SRV;
+    case ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI:
+        return NODE_DB_BOUND_ONOFF_CLI;
+    default:
+        return 0;
+    }
+}
+
+static void example_ble_mesh_node_seen(uint16_t addr)
+/* The database is keyed on the primary address, messages can come from any element of a node */
+{
+    esp_ble_mesh_node_t *node = esp_ble_mesh_provisioner_get_node_with_addr(addr);
+
+    if (node) {
+        node_db_seen(node->unicast_addr);
+    }
+}
+
+static struct config_job *example_ble_mesh_config_job(uint16_t addr)
+/* Job of the node with primary address addr, a free job for ESP_BLE_MESH_ADDR_UNASSIGNED */
+{
+    for (uint8_t i = 0; i < CONFIG_PARALLEL_NODES; i++) {
+        if (config_jobs[i].addr == addr) {
+            return &config_jobs[i];
+        }
+    }
+    return NULL;
+}
+
+static const struct config_template *example_ble_mesh_config_template(uint8_t role)
+{
+    if (role >= NODE_ROLE_COUNT || config_templates[role].actions == NULL) {
+        return NULL;
+    }
+    return &config_templates[role];
+}
+
+static uint32_t example_ble_mesh_config_opcode(const struct config_job *job)
+/* Opcode of the message of the step the job is at */
+{
+    switch (job->step) {
+    case CONFIG_STEP_COMP_DATA:
+        return ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET;
+    case CONFIG_STEP_APP_KEY:
+        return ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD;
+    default:
+        break;
+    }
+    switch (job->template->actions[job->action].type) {
+    case CONFIG_SUB:
+        return ESP_BLE_MESH_MODEL_OP_MODEL_SUB_ADD;
+    case CONFIG_PUB:
+        return ESP_BLE_MESH_MODEL_OP_MODEL_PUB_SET;
+    default:
+        return ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND;
+    }
+}
+
+static esp_err_t example_ble_mesh_config_send(struct config_job *job)
+/* Sends the message of the step the job is at */
 {
     esp_ble_mesh_client_common_param_t common = {0};
+    esp_ble_mesh_cfg_client_get_state_t get = {0};
     esp_ble_mesh_cfg_client_set_state_t set = {0};
-    static uint16_t wait_model_id, wait_cid;
+    const struct config_action *action = NULL;
     esp_ble_mesh_node_t *node = NULL;
-    esp_err_t err = ESP_OK;
 
-    ESP_LOGI(TAG, "Config client, event %u, addr 0x%04x, opcode 0x%04x", event, param->params->ctx.addr, param->params->opcode);
+    node = esp_ble_mesh_provisioner_get_node_with_addr(job->addr);
+    if (node == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
 
-    if (param->error_code) {
-        ESP_LOGE(TAG, "Send config client message failed (err %d)", param->error_code);
+    example_ble_mesh_set_msg_common(&common, node, config_client.model, example_ble_mesh_config_opcode(job));
+    if (job->step == CONFIG_STEP_COMP_DATA) {
+        get.comp_data_get.page = COMP_DATA_PAGE_0;
+        return esp_ble_mesh_config_client_get_state(&common, &get);
+    }
+    if (job->step == CONFIG_STEP_APP_KEY) {
+        set.app_key_add.net_idx = prov_key.net_idx;
+        set.app_key_add.app_idx = prov_key.app_idx;
+        memcpy(set.app_key_add.app_key, prov_key.app_key, ESP_BLE_MESH_OCTET16_LEN);
+        return esp_ble_mesh_config_client_set_state(&common, &set);
+    }
+
+    action = &job->template->actions[job->action];
+    switch (action->type) {
+    case CONFIG_SUB:
+        set.model_sub_add.element_addr = job->element_addr;
+        set.model_sub_add.sub_addr = action->addr;
+        set.model_sub_add.model_id = action->model_id;
+        set.model_sub_add.company_id = action->company_id;
+        break;
+    case CONFIG_PUB:
+        set.model_pub_set.element_addr = job->element_addr;
+        set.model_pub_set.publish_addr = action->addr;
+        set.model_pub_set.publish_app_idx = prov_key.app_idx;
+        set.model_pub_set.cred_flag = false;
+        set.model_pub_set.publish_ttl = action->ttl;
+        set.model_pub_set.publish_period = action->period;
+        set.model_pub_set.publish_retransmit = action->retransmit;
+        set.model_pub_set.model_id = action->model_id;
+        set.model_pub_set.company_id = action->company_id;
+        break;
+    default:
+        set.model_app_bind.element_addr = job->element_addr;
+        set.model_app_bind.model_app_idx = prov_key.app_idx;
+        set.model_app_bind.model_id = action->model_id;
+        set.model_app_bind.company_id = action->company_id;
+        break;
+    }
+    return esp_ble_mesh_config_client_set_state(&common, &set);
+}
+
+static bool example_ble_mesh_config_awaited(const struct config_job *job, const esp_ble_mesh_cfg_client_cb_param_t *param)
+/* The status is the one of the step the job is at */
+{
+    const struct config_action *action = NULL;
+
+    if (param->params->opcode != example_ble_mesh_config_opcode(job)) {
+        return false;
+    }
+    if (job->step != CONFIG_STEP_ACTIONS) {
+        return true;
+    }
+
+    action = &job->template->actions[job->action];
+    switch (action->type) {
+    case CONFIG_SUB:
+        return param->status_cb.model_sub_status.element_addr == job->element_addr &&
+               param->status_cb.model_sub_status.model_id == action->model_id;
+    case CONFIG_PUB:
+        return param->status_cb.model_pub_status.element_addr == job->element_addr &&
+               param->status_cb.model_pub_status.model_id == action->model_id;
+    default:
+        return param->status_cb.model_app_status.element_addr == job->element_addr &&
+               param->status_cb.model_app_status.model_id == action->model_id &&
+               param->status_cb.model_app_status.company_id == action->company_id;
+    }
+}
+
+static void example_ble_mesh_config_finish(struct config_job *job, bool configured)
+/* Frees the job and gives it to the next node that waits */
+{
+    uint32_t job_ms = (esp_timer_get_time() - job->start) / 1000;
+    uint32_t run_ms = (esp_timer_get_time() - config_run.start) / 1000;
+    uint32_t per_minute;
+
+    if (configured) {
+        node_db_set_flags(job->addr, NODE_DB_CONFIGURED);
+        config_run.configured++;
+        ESP_LOGW(TAG, "Provision and config successfully, node 0x%04x in %u ms", job->addr, job_ms);
+    } else {
+        node_db_set_flags(job->addr, NODE_DB_CONFIG_FAILED);
+        config_run.failed++;
+        ESP_LOGE(TAG, "Configuration of node 0x%04x failed at step %u after %u ms", job->addr, job->step, job_ms);
+    }
+
+    /* Nodes per minute in hundredths */
+    per_minute = run_ms ? (uint32_t)((uint64_t)config_run.configured * 6000000 / run_ms) : 0;
+    ESP_LOGI(TAG, "%u nodes configured, %u failed in %u s, %u.%02u nodes per minute", config_run.configured,
+             config_run.failed, run_ms / 1000, per_minute / 100, per_minute % 100);
+
+    job->addr = ESP_BLE_MESH_ADDR_UNASSIGNED;
+    job->resend_at = 0;
+    config_run.active--;
+    example_ble_mesh_config_schedule_later();
+}
+
+static void example_ble_mesh_config_arm(void)
+/* Starts the timer for the earliest resend, at once when free jobs wait to be handed out */
+{
+    int64_t now = esp_timer_get_time();
+    int64_t next = INT64_MAX;
+
+    for (uint8_t i = 0; i < CONFIG_PARALLEL_NODES; i++) {
+        if (config_jobs[i].addr != ESP_BLE_MESH_ADDR_UNASSIGNED && config_jobs[i].resend_at && config_jobs[i].resend_at < next) {
+            next = config_jobs[i].resend_at;
+        }
+    }
+    if (config_schedule_pending) {
+        next = now;
+    }
+
+    esp_timer_stop(config_timer);
+    if (next != INT64_MAX) {
+        esp_timer_start_once(config_timer, next > now ? next - now : 0);
+    }
+}
+
+static void example_ble_mesh_config_schedule_later(void)
+/* Free jobs are handed out from the timer, never from inside the call that freed one */
+{
+    xSemaphoreTakeRecursive(config_lock, portMAX_DELAY);
+    config_schedule_pending = true;
+    example_ble_mesh_config_arm();
+    xSemaphoreGiveRecursive(config_lock);
+}
+
+static void example_ble_mesh_config_retry(struct config_job *job)
+/* The step got no status or its message was not sent, it is sent again from the timer after the backoff */
+{
+    if (job->retries == CONFIG_STEP_RETRIES) {
+        example_ble_mesh_config_finish(job, false);
+        return;
+    }
+    job->retries++;
+    job->resend_at = esp_timer_get_time() + ((int64_t)CONFIG_RETRY_BACKOFF_MS * 1000 << (job->retries - 1));
+    ESP_LOGW(TAG, "Sending step %u of node 0x%04x again in %u ms, retry %u", job->step, job->addr,
+             CONFIG_RETRY_BACKOFF_MS << (job->retries - 1), job->retries);
+    example_ble_mesh_config_arm();
+}
+
+static void example_ble_mesh_config_step(struct config_job *job)
+/* A message that was not sent counts as a retry of the step, it ends the job only once the retries are used up */
+{
+    esp_err_t err = example_ble_mesh_config_send(job);
+
+    if (err == ESP_OK) {
+        return;
+    }
+    ESP_LOGE(TAG, "Failed to send config message 0x%04x to 0x%04x (err %d)",
+             example_ble_mesh_config_opcode(job), job->element_addr, err);
+    if (err == ESP_ERR_NOT_FOUND) {
+        /* The node is gone from the provisioner, no retry can reach it */
+        example_ble_mesh_config_finish(job, false);
         return;
     }
+    example_ble_mesh_config_retry(job);
+}
+
+static void example_ble_mesh_config_next(struct config_job *job, const esp_ble_mesh_node_t *node)
+/* Moves the job on to the next step, an action on every element goes through all elements first */
+{
+    switch (job->step) {
+    case CONFIG_STEP_APP_KEY:
+        job->action = 0;
+        job->step = job->template ? CONFIG_STEP_ACTIONS : CONFIG_STEP_DONE;
+        break;
+    case CONFIG_STEP_ACTIONS:
+        if (job->template->actions[job->action].every_element &&
+            job->element_addr + 1 < node->unicast_addr + node->element_num) {
+            job->element_addr++;
+            break;
+        }
+        job->element_addr = node->unicast_addr;
+        if (++job->action == job->template->action_count) {
+            job->step = CONFIG_STEP_DONE;
+        }
+        break;
+    default:
+        job->step++;
+        break;
+    }
+    job->retries = 0;
+    job->resend_at = 0;
+}
+
+static void example_ble_mesh_config_status(struct config_job *job, esp_ble_mesh_node_t *node, esp_ble_mesh_cfg_client_cb_param_t *param)
+/* Status of the step the job is at */
+{
+    esp_err_t err = ESP_OK;
+    uint8_t role;
+
+    switch (job->step) {
+    case CONFIG_STEP_COMP_DATA:
+        ESP_LOG_BUFFER_HEX("Composition data", param->status_cb.comp_data_status.composition_data->data, param->status_cb.comp_data_status.composition_data->len);
+        role = example_ble_mesh_parse_node_comp_data(param->status_cb.comp_data_status.composition_data->data, param->status_cb.comp_data_status.composition_data->len);
+        err = esp_ble_mesh_provisioner_store_node_comp_data(param->params->ctx.addr, param->status_cb.comp_data_status.composition_data->data, param->status_cb.comp_data_status.composition_data->len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to store node composition data");
+            example_ble_mesh_config_finish(job, false);
+            return;
+        }
+        job->template = example_ble_mesh_config_template(role);
+        if (job->template) {
+            ESP_LOGI(TAG, "Node 0x%04x is configured as %s by its Composition Data", job->addr, job->template->name);
+        } else {
+            ESP_LOGW(TAG, "No template fits node 0x%04x, only the AppKey is added", job->addr);
+        }
+        break;
+    case CONFIG_STEP_APP_KEY:
+        if (param->status_cb.appkey_status.status != 0) {
+            ESP_LOGE(TAG, "Config AppKey Add of 0x%04x failed (status 0x%02x)", job->addr, param->status_cb.appkey_status.status);
+            example_ble_mesh_config_finish(job, false);
+            return;
+        }
+        break;
+    default:
+        switch (job->template->actions[job->action].type) {
+        case CONFIG_SUB:
+            if (param->status_cb.model_sub_status.status != 0) {
+                ESP_LOGE(TAG, "Config Model Subscription Add of 0x%04x failed (status 0x%02x)",
+                         param->status_cb.model_sub_status.element_addr, param->status_cb.model_sub_status.status);
+            }
+            break;
+        case CONFIG_PUB:
+            if (param->status_cb.model_pub_status.status != 0) {
+                ESP_LOGE(TAG, "Config Model Publication Set of 0x%04x failed (status 0x%02x)",
+                         param->status_cb.model_pub_status.element_addr, param->status_cb.model_pub_status.status);
+            }
+            break;
+        default:
+            if (param->status_cb.model_app_status.status == 0) {
+                node_db_set_bound(job->addr, example_ble_mesh_bound_bit(param->status_cb.model_app_status.model_id,
+                    param->status_cb.model_app_status.company_id));
+            } else {
+                ESP_LOGE(TAG, "Config Model App Bind of model 0x%04x on 0x%04x failed (status 0x%02x)",
+                         param->status_cb.model_app_status.model_id, param->status_cb.model_app_status.element_addr,
+                         param->status_cb.model_app_status.status);
+            }
+            break;
+        }
+        break;
+    }
+
+    example_ble_mesh_config_next(job, node);
+    if (job->step == CONFIG_STEP_DONE) {
+        example_ble_mesh_config_finish(job, true);
+        return;
+    }
+    example_ble_mesh_config_step(job);
+}
+
+static void example_ble_mesh_config_schedule(void)
+/* Gives the free jobs to nodes of the database that are not configured, in the order of their address.
+ * A node of a known role starts with the AppKey Add, the Composition Data is only fetched for the others */
+{
+    struct config_job *job = NULL;
+    esp_ble_mesh_node_t *node = NULL;
+    node_db_entry_t entry;
+    uint16_t index = 0;
+
+    while ((job = example_ble_mesh_config_job(ESP_BLE_MESH_ADDR_UNASSIGNED)) != NULL && node_db_get(index++, &entry)) {
+        if (entry.flags & (NODE_DB_CONFIGURED | NODE_DB_CONFIG_FAILED) || example_ble_mesh_config_job(entry.addr)) {
+            continue;
+        }
+        node = esp_ble_mesh_provisioner_get_node_with_addr(entry.addr);
+        if (node == NULL) {
+            continue;
+        }
+        if (config_run.active++ == 0) {
+            config_run.configured = 0;
+            config_run.failed = 0;
+            config_run.start = esp_timer_get_time();
+        }
+        job->addr = entry.addr;
+        job->element_addr = entry.addr;
+        job->template = example_ble_mesh_config_template(node->dev_uuid[NODE_ROLE_UUID_OFFSET]);
+        job->step = job->template ? CONFIG_STEP_APP_KEY : CONFIG_STEP_COMP_DATA;
+        job->action = 0;
+        job->retries = 0;
+        job->resend_at = 0;
+        job->start = esp_timer_get_time();
+        ESP_LOGI(TAG, "Configuring node 0x%04x as %s, %u nodes in configuration", job->addr,
+                 job->template ? job->template->name : "unknown role", config_run.active);
+        example_ble_mesh_config_step(job);
+    }
+}
+
+static void example_ble_mesh_config_timer_cb(void *arg)
+/* Sends again the steps of which the backoff is over, then hands out the free jobs */
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTakeRecursive(config_lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < CONFIG_PARALLEL_NODES; i++) {
+        if (config_jobs[i].addr != ESP_BLE_MESH_ADDR_UNASSIGNED && config_jobs[i].resend_at && config_jobs[i].resend_at <= now) {
+            config_jobs[i].resend_at = 0;
+            example_ble_mesh_config_step(&config_jobs[i]);
+        }
+    }
+    if (config_schedule_pending) {
+        config_schedule_pending = false;
+        example_ble_mesh_config_schedule();
+    }
+    example_ble_mesh_config_arm();
+    xSemaphoreGiveRecursive(config_lock);
+}
+
+static void example_ble_mesh_config_client_event(esp_ble_mesh_cfg_client_cb_event_t event, esp_ble_mesh_cfg_client_cb_param_t *param)
+{
+    struct config_job *job = NULL;
+    esp_ble_mesh_node_t *node = NULL;
+
+    ESP_LOGI(TAG, "Config client, event %u, addr 0x%04x, opcode 0x%04x", event, param->params->ctx.addr, param->params->opcode);
 
     node = esp_ble_mesh_provisioner_get_node_with_addr(param->params->ctx.addr);
     if (!node) {
         ESP_LOGE(TAG, "Node 0x%04x not exists", param->params->ctx.addr);
         return;
     }
+    job = example_ble_mesh_config_job(node->unicast_addr);
+
+    if (param->error_code) {
+        ESP_LOGE(TAG, "Send config client message failed (err %d)", param->error_code);
+        if (job && !job->resend_at && param->params->opcode == example_ble_mesh_config_opcode(job)) {
+            example_ble_mesh_config_retry(job);
+        }
+        return;
+    }
 
     switch (event) {
     case ESP_BLE_MESH_CFG_CLIENT_GET_STATE_EVT:
-        if (param->params->opcode == ESP_BLE_MESH_MODEL_OP_COMPOSITION_DATA_GET) {
-            ESP_LOG_BUFFER_HEX("Composition data", param->status_cb.comp_data_status.composition_data->data, param->status_cb.comp_data_status.composition_data->len);
-            example_ble_mesh_parse_node_comp_data(param->status_cb.comp_data_status.composition_data->data, param->status_cb.comp_data_status.composition_data->len);
-            err = esp_ble_mesh_provisioner_store_node_comp_data(param->params->ctx.addr, param->status_cb.comp_data_status.composition_data->data, param->status_cb.comp_data_status.composition_data->len);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to store node composition data");
-                break;
-            }
-
-            example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD);
-            set.app_key_add.net_idx = prov_key.net_idx;
-            set.app_key_add.app_idx = prov_key.app_idx;
-            memcpy(set.app_key_add.app_key, prov_key.app_key, ESP_BLE_MESH_OCTET16_LEN);
-            err = esp_ble_mesh_config_client_set_state(&common, &set);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to send Config AppKey Add");
-            }
+    case ESP_BLE_MESH_CFG_CLIENT_SET_STATE_EVT:
+        node_db_seen(node->unicast_addr);
+        if (!job || !example_ble_mesh_config_awaited(job, param)) {
+            ESP_LOGW(TAG, "Config status 0x%04x of 0x%04x is not awaited", param->params->opcode, param->params->ctx.addr);
+            break;
         }
+        example_ble_mesh_config_status(job, node, param);
         break;
-    case ESP_BLE_MESH_CFG_CLIENT_SET_STATE_EVT:
-        if (param->params->opcode == ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD) {
-            example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND);
-            set.model_app_bind.element_addr = node->unicast_addr;
-            set.model_app_bind.model_app_idx = prov_key.app_idx;
-            set.model_app_bind.model_id = ESP_BLE_MESH_MODEL_ID_SENSOR_SRV;
-            set.model_app_bind.company_id = ESP_BLE_MESH_CID_NVAL;
-            err = esp_ble_mesh_config_client_set_state(&common, &set);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to send Config Model App Bind");
-                return;
-            }
-            wait_model_id = ESP_BLE_MESH_MODEL_ID_SENSOR_SRV;
-            wait_cid = ESP_BLE_MESH_CID_NVAL;
-        } else if (param->params->opcode == ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND) {
-            if (param->status_cb.model_app_status.model_id == ESP_BLE_MESH_MODEL_ID_SENSOR_SRV &&
-                param->status_cb.model_app_status.company_id == ESP_BLE_MESH_CID_NVAL) {
-                example_ble_mesh_set_msg_common(&common, node, config_client.model, ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND);
-                set.model_app_bind.element_addr = node->unicast_addr;
-                set.model_app_bind.model_app_idx = prov_key.app_idx;
-                set.model_app_bind.model_id = ESP_BLE_MESH_MODEL_ID_SENSOR_SETUP_SRV;
-                set.model_app_bind.company_id = ESP_BLE_MESH_CID_NVAL;
-                err = esp_ble_mesh_config_client_set_state(&common, &set);
-                if (err) {
-                    ESP_LOGE(TAG, "Failed to send Config Model App Bind");
-                    return;
-                }
-                wait_model_id = ESP_BLE_MESH_MODEL_ID_SENSOR_SETUP_SRV;
-                wait_cid = ESP_BLE_MESH_CID_NVAL;
-            } else if (param->status_cb.model_app_status.model_id == ESP_BLE_MESH_MODEL_ID_SENSOR_SETUP_SRV && param->status_cb.model_app_status.company_id == ESP_BLE_MESH_CID_NVAL) {
-                ESP_LOGW(TAG, "Provision and config successfully");
-            }
+    case ESP_BLE_MESH_CFG_CLIENT_TIMEOUT_EVT:
+        ESP_LOGW(TAG, "Config message 0x%04x to 0x%04x timed out", param->params->opcode, param->params->ctx.addr);
+        if (job && !job->resend_at && param->params->opcode == example_ble_mesh_config_opcode(job)) {
+            example_ble_mesh_config_retry(job);
         }
         break;
     default:
@@ -382,7 +946,44 @@ static void example_ble_mesh_config_client_cb(esp_ble_mesh_cfg_client_cb_event_t
     }
 }
 
+static void example_ble_mesh_config_client_cb(esp_ble_mesh_cfg_client_cb_event_t event, esp_ble_mesh_cfg_client_cb_param_t *param)
+{
+    xSemaphoreTakeRecursive(config_lock, portMAX_DELAY);
+    example_ble_mesh_config_client_event(event, param);
+    xSemaphoreGiveRecursive(config_lock);
+}
+
+
 
+static int32_t example_ble_mesh_sensor_value(uint16_t property_id, const uint8_t *data, uint8_t length)
+/* Reads a raw value little endian and returns it in the fine units of the property */
+{
+    const struct sensor_property_format *format = NULL;
+    uint32_t raw = 0;
+    int32_t value;
+    int i;
+
+    if (length > 4) {
+        length = 4;
+    }
+    for (i = length - 1; i >= 0; i--) {
+        raw = raw << 8 | data[i];
+    }
+    for (i = 0; i < ARRAY_SIZE(sensor_property_formats); i++) {
+        if (sensor_property_formats[i].property_id == property_id) {
+            format = &sensor_property_formats[i];
+        }
+    }
+    if (format == NULL) {
+        return raw;
+    }
+
+    value = raw;
+    if (format->is_signed && length < 4 && (raw & (1UL << (length * 8 - 1)))) {
+        value = raw | ~0UL << (length * 8);
+    }
+    return value * format->step;
+}
 
 static void print_data_to_console(esp_ble_mesh_sensor_client_cb_param_t *param, uint16_t prop_id, const void *buffer, uint16_t buff_len){
 	if (buff_len == 0) {
@@ -407,7 +1008,7 @@ static void print_data_to_console(esp_ble_mesh_sensor_client_cb_param_t *param,
 	            ptr_line = buffer;
 	        }
 
-	        uint32_t myInt1 = ptr_line[0] + (ptr_line[1] << 8);
+	        int32_t myInt1 = example_ble_mesh_sensor_value(prop_id, (const uint8_t *)ptr_line, bytes_cur_line);
 
 	        ESP_LOG_LEVEL(ESP_LOG_INFO, DATA_TAG, "0x%04x 0x%04x 0x%02x %d end", param->params->ctx.recv_dst, param->params->ctx.addr , prop_id, myInt1);
 	        buffer += bytes_cur_line;
@@ -433,6 +1034,7 @@ static void example_ble_mesh_sensor_client_cb(esp_ble_mesh_sensor_client_cb_even
         ESP_LOGE(TAG, "Node 0x%04x not exists", param->params->ctx.addr);
         return;
     }
+    node_db_seen(node->unicast_addr);
 
     switch (event) {
     case ESP_BLE_MESH_SENSOR_CLIENT_GET_STATE_EVT:
@@ -452,6 +1054,7 @@ static void example_ble_mesh_sensor_client_cb(esp_ble_mesh_sensor_client_cb_even
                  */
                 sensor_prop_id = param->status_cb.descriptor_status.descriptor->data[1] << 8 |
                                  param->status_cb.descriptor_status.descriptor->data[0];
+                node_db_add_property(node->unicast_addr, sensor_prop_id);
             }
             break;
         case ESP_BLE_MESH_MODEL_OP_SENSOR_CADENCE_GET:
@@ -476,6 +1079,20 @@ static void example_ble_mesh_sensor_client_cb(esp_ble_mesh_sensor_client_cb_even
                     param->status_cb.setting_status.sensor_setting_raw->len);
             }
             break;
+        case ESP_BLE_MESH_MODEL_OP_SENSOR_COLUMN_GET:
+            /* Raw Value X, Column Width and Raw Value Y, the width and Y are left out for a column the node does not have */
+            ESP_LOGI(TAG, "Sensor Column Status, opcode 0x%04x, Sensor Property ID 0x%04x",
+                param->params->ctx.recv_op, param->status_cb.column_status.property_id);
+            ESP_LOG_BUFFER_HEX("Sensor Column", param->status_cb.column_status.sensor_column_value->data,
+                param->status_cb.column_status.sensor_column_value->len);
+            break;
+        case ESP_BLE_MESH_MODEL_OP_SENSOR_SERIES_GET:
+            /* Raw Value X, Column Width and Raw Value Y of every column, each in the format of the property */
+            ESP_LOGI(TAG, "Sensor Series Status, opcode 0x%04x, Sensor Property ID 0x%04x",
+                param->params->ctx.recv_op, param->status_cb.series_status.property_id);
+            ESP_LOG_BUFFER_HEX("Sensor Series", param->status_cb.series_status.sensor_series_value->data,
+                param->status_cb.series_status.sensor_series_value->len);
+            break;
         case ESP_BLE_MESH_MODEL_OP_SENSOR_GET:
             ESP_LOGI(TAG, "Sensor Status, opcode 0x%04x", param->params->ctx.recv_op);
             if (param->status_cb.sensor_status.marshalled_sensor_data->len) {
@@ -529,6 +1146,17 @@ static void example_ble_mesh_sensor_client_cb(esp_ble_mesh_sensor_client_cb_even
         }
         break;
     case ESP_BLE_MESH_SENSOR_CLIENT_PUBLISH_EVT:
+        if (param->params->ctx.recv_op == ESP_BLE_MESH_MODEL_OP_SENSOR_SETTING_STATUS) {
+            /* A node publishes a changed setting */
+            ESP_LOGI(TAG, "Sensor Setting Status, opcode 0x%04x, Sensor Property ID 0x%04x, Sensor Setting Property ID 0x%04x",
+                param->params->ctx.recv_op, param->status_cb.setting_status.sensor_property_id,
+                param->status_cb.setting_status.sensor_setting_property_id);
+            if (param->status_cb.setting_status.op_en) {
+                ESP_LOG_BUFFER_HEX("Sensor Setting Raw", param->status_cb.setting_status.sensor_setting_raw->data,
+                    param->status_cb.setting_status.sensor_setting_raw->len);
+            }
+            break;
+        }
     	ESP_LOGI(TAG, "Sensor Status, opcode 0x%04x", param->params->ctx.recv_op);
     	        if (param->status_cb.sensor_status.marshalled_sensor_data->len) {
     	            ESP_LOG_BUFFER_HEX("Sensor Data", param->status_cb.sensor_status.marshalled_sensor_data->data, param->status_cb.sensor_status.marshalled_sensor_data->len);
@@ -541,6 +1169,7 @@ static void example_ble_mesh_sensor_client_cb(esp_ble_mesh_sensor_client_cb_even
     	                uint16_t prop_id = ESP_BLE_MESH_GET_SENSOR_DATA_PROPERTY_ID(data, fmt);
     	                uint8_t mpid_len = (fmt == ESP_BLE_MESH_SENSOR_DATA_FORMAT_A ? ESP_BLE_MESH_SENSOR_DATA_FORMAT_A_MPID_LEN : ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN);
     	                ESP_LOGI(TAG, "Format %s, length 0x%02x, Sensor Property ID 0x%04x", fmt == ESP_BLE_MESH_SENSOR_DATA_FORMAT_A ? "A" : "B", data_len, prop_id);
+    	                node_db_add_property(node->unicast_addr, prop_id);
     	                if (data_len != ESP_BLE_MESH_SENSOR_DATA_ZERO_LEN) {
     	                    print_data_to_console(param, prop_id, data + mpid_len, data_len + 1);
     	                    length += mpid_len + data_len + 1;
@@ -582,6 +1211,7 @@ static void example_ble_mesh_generic_client_cb(esp_ble_mesh_generic_client_cb_ev
         break;
     case ESP_BLE_MESH_GENERIC_CLIENT_PUBLISH_EVT:
         ESP_LOGI(TAG, "ESP_BLE_MESH_GENERIC_CLIENT_PUBLISH_EVT");
+        example_ble_mesh_node_seen(param->params->ctx.addr);
 
         ESP_LOG_LEVEL(ESP_LOG_INFO, CONTROL_TAG, "0x%04x 0x%04x %d%d%d%d%d%d%d%d end", param->params->ctx.recv_dst, param->params->ctx.addr , (param->status_cb.onoff_status.present_onoff & 0b10000000) >> 7, (param->status_cb.onoff_status.present_onoff & 0b01000000) >> 6, (param->status_cb.onoff_status.present_onoff & 0b00100000) >> 5, (param->status_cb.onoff_status.present_onoff & 0b00010000) >> 4, (param->status_cb.onoff_status.present_onoff & 0b00001000) >> 3, (param->status_cb.onoff_status.present_onoff & 0b00000100) >> 2, (param->status_cb.onoff_status.present_onoff & 0b00000010) >> 1, (param->status_cb.onoff_status.present_onoff & 0b00000001));
 
@@ -600,6 +1230,145 @@ static void example_ble_mesh_generic_client_cb(esp_ble_mesh_generic_client_cb_ev
 
 
 
+static void example_ble_mesh_backfill_ack(esp_ble_mesh_msg_ctx_t *recv_ctx, const struct backfill_status *status)
+/* Every Status is answered, a node that missed answers replays what it logged in the meantime */
+{
+    esp_ble_mesh_msg_ctx_t ctx = {0};
+    uint32_t next = status->next_sequence;
+    esp_err_t err;
+
+    ESP_LOGI(TAG, "Backfill status 0x%04x, boot %u, samples %u to %u", recv_ctx->addr, status->boot,
+        status->first_sequence, next);
+
+    ctx.net_idx = prov_key.net_idx;
+    ctx.app_idx = prov_key.app_idx;
+    ctx.addr = recv_ctx->addr;
+    ctx.send_ttl = MSG_SEND_TTL;
+    ctx.send_rel = MSG_SEND_REL;
+    err = esp_ble_mesh_client_model_send_msg(&vnd_models[0], &ctx, BACKFILL_OP_ACK, sizeof(next), (uint8_t *)&next,
+            MSG_TIMEOUT, false, MSG_ROLE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send Backfill Ack");
+    }
+}
+
+static void example_ble_mesh_backfill_print(esp_ble_mesh_msg_ctx_t *ctx, const uint8_t *data, uint16_t length)
+{
+    struct backfill_data_header header;
+    struct backfill_data_record record;
+    uint16_t offset = sizeof(header);
+    int32_t age;
+    int i;
+
+    memcpy(&header, data, sizeof(header));
+    ESP_LOGI(TAG, "Backfill data 0x%04x, samples %u from %u", ctx->addr, header.count, header.first_sequence);
+
+    /* Data format:
+    [Info tag (unimportant)] [? (uninportant)] BACKFILL: 0x[element addr] 0x[received from addr] 0x[property ID] [data] [sequence] [age s] end
+    The age is the time from logging to sending the sample, -1 when the node restarted in between */
+    for (i = 0; i < header.count && offset + sizeof(record) <= length; i++, offset += sizeof(record)) {
+        memcpy(&record, data + offset, sizeof(record));
+        age = record.boot == header.boot ? (int32_t)(header.uptime_s - record.time_s) : -1;
+        ESP_LOG_LEVEL(ESP_LOG_INFO, BACKFILL_TAG, "0x%04x 0x%04x 0x%02x %d %u %d end", ctx->addr + record.zone, ctx->addr,
+            record.property_id, record.value, header.first_sequence + record.offset, age);
+    }
+}
+
+static void example_ble_mesh_telemetry_print(esp_ble_mesh_msg_ctx_t *ctx, const uint8_t *data, uint16_t length)
+{
+    static telemetry_decoded_t batch;
+    int i, j;
+
+    if (!telemetry_decode(data, length, &batch)) {
+        ESP_LOGE(TAG, "Invalid telemetry batch from 0x%04x, length %u", ctx->addr, length);
+        return;
+    }
+    ESP_LOGI(TAG, "Telemetry batch 0x%04x, zone %u, %u samples over %u ms", ctx->addr, batch.zone, batch.count,
+        (batch.times[batch.count - 1] - batch.times[0]) * 100);
+
+    /* Data format, the same as for a published Sensor Status, oldest sample first:
+    [Info tag (unimportant)] [? (uninportant)] DATA: 0x[publish addr] 0x[received from addr] 0x[property ID] [data] end*/
+    for (j = 0; j < batch.count; j++) {
+        for (i = 0; i < batch.property_count; i++) {
+            ESP_LOG_LEVEL(ESP_LOG_INFO, DATA_TAG, "0x%04x 0x%04x 0x%02x %d end", ctx->recv_dst, ctx->addr + batch.zone,
+                batch.property_ids[i], batch.values[i][j]);
+        }
+    }
+}
+
+static void example_ble_mesh_backfill_recv(uint32_t opcode, esp_ble_mesh_msg_ctx_t *ctx, const uint8_t *msg, uint16_t length)
+{
+    struct backfill_status status;
+
+    example_ble_mesh_node_seen(ctx->addr);
+
+    switch (opcode) {
+    case BACKFILL_OP_STATUS:
+        if (length < sizeof(status)) {
+            return;
+        }
+        memcpy(&status, msg, sizeof(status));
+        example_ble_mesh_backfill_ack(ctx, &status);
+        break;
+    case BACKFILL_OP_DATA:
+        if (length < sizeof(struct backfill_data_header)) {
+            return;
+        }
+        example_ble_mesh_backfill_print(ctx, msg, length);
+        break;
+    case TELEMETRY_OP_BATCH:
+        example_ble_mesh_telemetry_print(ctx, msg, length);
+        break;
+    default:
+        break;
+    }
+}
+
+static void example_ble_mesh_custom_model_cb(esp_ble_mesh_model_cb_event_t event, esp_ble_mesh_model_cb_param_t *param)
+{
+    switch (event) {
+    case ESP_BLE_MESH_MODEL_OPERATION_EVT:
+        example_ble_mesh_backfill_recv(param->model_operation.opcode, param->model_operation.ctx,
+            param->model_operation.msg, param->model_operation.length);
+        break;
+    case ESP_BLE_MESH_CLIENT_MODEL_RECV_PUBLISH_MSG_EVT:
+        example_ble_mesh_backfill_recv(param->client_recv_publish_msg.opcode, param->client_recv_publish_msg.ctx,
+            param->client_recv_publish_msg.msg, param->client_recv_publish_msg.length);
+        break;
+    case ESP_BLE_MESH_MODEL_SEND_COMP_EVT:
+        if (param->model_send_comp.err_code) {
+            ESP_LOGE(TAG, "Failed to send message 0x%06x", param->model_send_comp.opcode);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+
+
+static void example_ble_mesh_node_db_check(void)
+/* Drops entries of nodes the stack no longer knows and reports the nodes whose configuration was not finished,
+ * those are configured again once the provisioner is enabled */
+{
+    node_db_entry_t entry;
+    uint16_t index = 0;
+
+    while (node_db_get(index, &entry)) {
+        if (esp_ble_mesh_provisioner_get_node_with_addr(entry.addr) == NULL) {
+            ESP_LOGW(TAG, "Node 0x%04x is no longer provisioned, removed from the node database", entry.addr);
+            node_db_remove(entry.addr);
+            continue;
+        }
+        if (!(entry.flags & NODE_DB_CONFIGURED)) {
+            ESP_LOGW(TAG, "Node 0x%04x is not configured, models bound 0x%02x", entry.addr, entry.bound);
+            node_db_clear_flags(entry.addr, NODE_DB_CONFIG_FAILED);
+        }
+        index++;
+    }
+    ESP_LOGI(TAG, "%u nodes in the network", node_db_count());
+}
+
 esp_err_t ble_mesh_init(void)
 {
 	esp_err_t err = ESP_OK;
@@ -611,10 +1380,26 @@ esp_err_t ble_mesh_init(void)
     prov_key.app_idx = APP_KEY_IDX;
     memset(prov_key.app_key, APP_KEY_OCTET, sizeof(prov_key.app_key));
 
+    const esp_timer_create_args_t config_timer_args = {
+        .callback = example_ble_mesh_config_timer_cb,
+        .name = "node_config",
+    };
+
+    config_lock = xSemaphoreCreateRecursiveMutex();
+    if (config_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    err = esp_timer_create(&config_timer_args, &config_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the node configuration timer");
+        return err;
+    }
+
     esp_ble_mesh_register_prov_callback(example_ble_mesh_provisioning_cb);
     esp_ble_mesh_register_config_client_callback(example_ble_mesh_config_client_cb);
     esp_ble_mesh_register_sensor_client_callback(example_ble_mesh_sensor_client_cb);
     esp_ble_mesh_register_generic_client_callback(example_ble_mesh_generic_client_cb);
+    esp_ble_mesh_register_custom_model_callback(example_ble_mesh_custom_model_cb);
 
 
     err = esp_ble_mesh_init(&provision, &composition);
@@ -623,6 +1408,21 @@ esp_err_t ble_mesh_init(void)
         return err;
     }
 
+    /* With BLE_MESH_SETTINGS the stack has restored the keys, the nodes and the bindings of the own models
+     * from flash by now, the nodes go on publishing without the gateway having to provision them again */
+    err = node_db_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to load the node database (err %d)", err);
+        return err;
+    }
+    example_ble_mesh_node_db_check();
+
+    err = esp_ble_mesh_client_model_init(&vnd_models[0]);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize backfill client");
+        return err;
+    }
+
     err = esp_ble_mesh_provisioner_set_dev_uuid_match(match, sizeof(match), 0x0, false);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set matching device uuid");
@@ -635,10 +1435,12 @@ esp_err_t ble_mesh_init(void)
         return err;
     }
 
-    err = esp_ble_mesh_provisioner_add_local_app_key(prov_key.app_key, prov_key.net_idx, prov_key.app_idx);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to add local AppKey");
-        return err;
+    if (esp_ble_mesh_provisioner_get_local_app_key(prov_key.net_idx, prov_key.app_idx) == NULL) {
+        err = esp_ble_mesh_provisioner_add_local_app_key(prov_key.app_key, prov_key.net_idx, prov_key.app_idx);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to add local AppKey");
+            return err;
+        }
     }
 
     ESP_LOGI(TAG, "BLE Mesh sensor client initialized");
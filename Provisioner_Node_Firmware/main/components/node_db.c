@@ -0,0 +1,419 @@
+/*
+ * node_db.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "node_db.h"
+
+#define TAG					"NODE_DB"
+#define NODE_DB_KEY_NODE	"n%04x"		// one blob per node, on its address
+#define NODE_DB_KEY_BOOT	"boot"
+#define NODE_DB_KEY_LEN		6
+
+/* The table is kept sorted on the address in RAM, a lookup is a binary search. Every node is stored under a
+ * key of its own, so a change of the configuration of a node only writes its own entry, right away. Last
+ * seen times are only written every NODE_DB_SEEN_FLUSH_MS, for the nodes that were heard since.
+ * NVS has to be initialised with nvs_flash_init first */
+
+static node_db_entry_t node_db[NODE_DB_MAX_NODES];
+static _Bool node_db_dirty[NODE_DB_MAX_NODES];	// last seen time changed since the entry was written, moves with it
+static uint16_t node_db_used = 0;
+static uint8_t node_db_boot = 0;
+static SemaphoreHandle_t node_db_lock = NULL;
+static esp_timer_handle_t node_db_flush_timer = NULL;
+
+static uint16_t node_db_search(uint16_t addr, _Bool *found)
+/* Index of the entry of addr, or the index it is to be inserted at when there is none */
+{
+	uint16_t low = 0, high = node_db_used, middle;
+
+	while(low < high)
+	{
+		middle = (low + high) / 2;
+		if(node_db[middle].addr < addr)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	*found = low < node_db_used && node_db[low].addr == addr;
+	return low;
+}
+
+static _Bool node_db_insert(uint16_t index)
+/* Makes room for a new entry at index, false when the table is full */
+{
+	if(node_db_used == NODE_DB_MAX_NODES)
+		return false;
+	memmove(&node_db[index + 1], &node_db[index], (node_db_used - index) * sizeof(node_db_entry_t));
+	memmove(&node_db_dirty[index + 1], &node_db_dirty[index], (node_db_used - index) * sizeof(_Bool));
+	node_db_used++;
+	return true;
+}
+
+static esp_err_t node_db_write(nvs_handle_t handle, uint16_t index)
+/* Writes the entry at index under the key of its node, the commit is left to the caller */
+{
+	char key[NODE_DB_KEY_LEN];
+	esp_err_t err;
+
+	snprintf(key, sizeof(key), NODE_DB_KEY_NODE, node_db[index].addr);
+	err = nvs_set_blob(handle, key, &node_db[index], sizeof(node_db_entry_t));
+	if(err == ESP_OK)
+		node_db_dirty[index] = false;
+	return err;
+}
+
+static esp_err_t node_db_store(uint16_t index)
+/* Writes the entry at index, called with the lock held */
+{
+	nvs_handle_t handle;
+	esp_err_t err;
+
+	err = nvs_open(NODE_DB_NAMESPACE, NVS_READWRITE, &handle);
+	if(err != ESP_OK)
+		return err;
+
+	err = node_db_write(handle, index);
+	if(err == ESP_OK)
+		err = nvs_commit(handle);
+	nvs_close(handle);
+
+	if(err != ESP_OK)
+		ESP_LOGE(TAG, "Failed to store node 0x%04x (err %d)", node_db[index].addr, err);
+	return err;
+}
+
+static esp_err_t node_db_erase(uint16_t addr)
+/* Erases the entry of the node from flash, called with the lock held */
+{
+	char key[NODE_DB_KEY_LEN];
+	nvs_handle_t handle;
+	esp_err_t err;
+
+	err = nvs_open(NODE_DB_NAMESPACE, NVS_READWRITE, &handle);
+	if(err != ESP_OK)
+		return err;
+
+	snprintf(key, sizeof(key), NODE_DB_KEY_NODE, addr);
+	err = nvs_erase_key(handle, key);
+	if(err == ESP_ERR_NVS_NOT_FOUND)
+		err = ESP_OK;
+	if(err == ESP_OK)
+		err = nvs_commit(handle);
+	nvs_close(handle);
+
+	if(err != ESP_OK)
+		ESP_LOGE(TAG, "Failed to erase node 0x%04x (err %d)", addr, err);
+	return err;
+}
+
+static void node_db_load(nvs_handle_t handle)
+/* Puts the entry of every node key of the namespace in the table, in the order of the addresses */
+{
+	nvs_iterator_t it = nvs_entry_find(NVS_DEFAULT_PART_NAME, NODE_DB_NAMESPACE, NVS_TYPE_BLOB);
+	nvs_entry_info_t info;
+	node_db_entry_t entry;
+	size_t length;
+	uint16_t index;
+	unsigned addr;
+	_Bool found;
+
+	while(it != NULL)
+	{
+		nvs_entry_info(it, &info);
+		it = nvs_entry_next(it);
+		if(strlen(info.key) != NODE_DB_KEY_LEN - 1 || sscanf(info.key, NODE_DB_KEY_NODE, &addr) != 1)
+			continue;
+
+		length = sizeof(entry);
+		if(nvs_get_blob(handle, info.key, &entry, &length) != ESP_OK || length != sizeof(entry) || entry.addr != addr)
+		{
+			/* Stored by a build with another entry layout */
+			ESP_LOGE(TAG, "Stored node %s does not fit (%u octets), left out", info.key, (unsigned)length);
+			continue;
+		}
+
+		index = node_db_search(entry.addr, &found);
+		if(!found && !node_db_insert(index))
+		{
+			ESP_LOGE(TAG, "No room for stored node 0x%04x, left out", entry.addr);
+			continue;
+		}
+		node_db[index] = entry;
+		node_db_dirty[index] = false;
+	}
+}
+
+static void node_db_flush_cb(void *arg)
+{
+	node_db_flush();
+}
+
+esp_err_t node_db_init(void)
+/* Loads the table and counts the boot, the timer that writes the last seen times is started */
+{
+	const esp_timer_create_args_t timer_args = {
+		.callback = node_db_flush_cb,
+		.name = "node_db",
+	};
+	int64_t start = esp_timer_get_time();
+	nvs_handle_t handle;
+	esp_err_t err;
+
+	node_db_lock = xSemaphoreCreateMutex();
+	if(node_db_lock == NULL)
+		return ESP_ERR_NO_MEM;
+
+	err = nvs_open(NODE_DB_NAMESPACE, NVS_READWRITE, &handle);
+	if(err != ESP_OK)
+		return err;
+
+	if(nvs_get_u8(handle, NODE_DB_KEY_BOOT, &node_db_boot) == ESP_OK)
+		node_db_boot++;
+	err = nvs_set_u8(handle, NODE_DB_KEY_BOOT, node_db_boot);
+	if(err == ESP_OK)
+		err = nvs_commit(handle);
+	if(err != ESP_OK)
+		ESP_LOGW(TAG, "Failed to store the boot count (err %d)", err);
+
+	node_db_load(handle);
+	nvs_close(handle);
+
+	err = esp_timer_create(&timer_args, &node_db_flush_timer);
+	if(err == ESP_OK)
+		err = esp_timer_start_periodic(node_db_flush_timer, (uint64_t)NODE_DB_SEEN_FLUSH_MS * 1000);
+	if(err != ESP_OK)
+		ESP_LOGW(TAG, "No last seen flush timer (err %d)", err);
+
+	ESP_LOGI(TAG, "%u nodes loaded in %u us, boot %u", node_db_used, (uint32_t)(esp_timer_get_time() - start), node_db_boot);
+	return ESP_OK;
+}
+
+uint16_t node_db_count(void)
+{
+	return node_db_used;
+}
+
+_Bool node_db_get(uint16_t index, node_db_entry_t *entry)
+/* Copies the entry at index, in the order of the addresses. For walking the table with node_db_count */
+{
+	_Bool exists;
+
+	xSemaphoreTake(node_db_lock, portMAX_DELAY);
+	exists = index < node_db_used;
+	if(exists)
+		*entry = node_db[index];
+	xSemaphoreGive(node_db_lock);
+	return exists;
+}
+
+_Bool node_db_find(uint16_t addr, node_db_entry_t *entry)
+{
+	_Bool found;
+	uint16_t index;
+
+	xSemaphoreTake(node_db_lock, portMAX_DELAY);
+	index = node_db_search(addr, &found);
+	if(found && entry != NULL)
+		*entry = node_db[index];
+	xSemaphoreGive(node_db_lock);
+	return found;
+}
+
+esp_err_t node_db_add(uint16_t addr)
+/* A node provisioned again at an address that is in use starts over with an empty entry */
+{
+	_Bool found;
+	uint16_t index;
+	esp_err_t err;
+
+	xSemaphoreTake(node_db_lock, portMAX_DELAY);
+	index = node_db_search(addr, &found);
+	if(!found && !node_db_insert(index))
+	{
+		xSemaphoreGive(node_db_lock);
+		return ESP_ERR_NO_MEM;
+	}
+	memset(&node_db[index], 0, sizeof(node_db_entry_t));
+	node_db[index].addr = addr;
+	node_db[index].seen_boot = node_db_boot;
+	node_db[index].seen_s = esp_timer_get_time() / 1000000;
+	err = node_db_store(index);
+	xSemaphoreGive(node_db_lock);
+	return err;
+}
+
+esp_err_t node_db_remove(uint16_t addr)
+{
+	_Bool found;
+	uint16_t index;
+	esp_err_t err;
+
+	xSemaphoreTake(node_db_lock, portMAX_DELAY);
+	index = node_db_search(addr, &found);
+	if(!found)
+	{
+		xSemaphoreGive(node_db_lock);
+		return ESP_ERR_NOT_FOUND;
+	}
+	memmove(&node_db[index], &node_db[index + 1], (node_db_used - index - 1) * sizeof(node_db_entry_t));
+	memmove(&node_db_dirty[index], &node_db_dirty[index + 1], (node_db_used - index - 1) * sizeof(_Bool));
+	node_db_used--;
+	err = node_db_erase(addr);
+	xSemaphoreGive(node_db_lock);
+	return err;
+}
+
+esp_err_t node_db_set_flags(uint16_t addr, uint8_t flags)
+/* Sets the flags given, the others are left as they are */
+{
+	_Bool found;
+	uint16_t index;
+	esp_err_t err = ESP_OK;
+
+	xSemaphoreTake(node_db_lock, portMAX_DELAY);
+	index = node_db_search(addr, &found);
+	if(!found)
+		err = ESP_ERR_NOT_FOUND;
+	else if((node_db[index].flags & flags) != flags)
+	{
+		node_db[index].flags |= flags;
+		err = node_db_store(index);
+	}
+	xSemaphoreGive(node_db_lock);
+	return err;
+}
+
+esp_err_t node_db_clear_flags(uint16_t addr, uint8_t flags)
+{
+	_Bool found;
+	uint16_t index;
+	esp_err_t err = ESP_OK;
+
+	xSemaphoreTake(node_db_lock, portMAX_DELAY);
+	index = node_db_search(addr, &found);
+	if(!found)
+		err = ESP_ERR_NOT_FOUND;
+	else if(node_db[index].flags & flags)
+	{
+		node_db[index].flags &= ~flags;
+		err = node_db_store(index);
+	}
+	xSemaphoreGive(node_db_lock);
+	return err;
+}
+
+esp_err_t node_db_set_bound(uint16_t addr, uint8_t bound)
+/* Adds NODE_DB_BOUND_ bits of models that were bound */
+{
+	_Bool found;
+	uint16_t index;
+	esp_err_t err = ESP_OK;
+
+	xSemaphoreTake(node_db_lock, portMAX_DELAY);
+	index = node_db_search(addr, &found);
+	if(!found)
+		err = ESP_ERR_NOT_FOUND;
+	else if((node_db[index].bound & bound) != bound)
+	{
+		node_db[index].bound |= bound;
+		err = node_db_store(index);
+	}
+	xSemaphoreGive(node_db_lock);
+	return err;
+}
+
+esp_err_t node_db_add_property(uint16_t addr, uint16_t property_id)
+/* Keeps a sensor property ID of the node, a property that is known already costs no write */
+{
+	node_db_entry_t *entry;
+	_Bool found;
+	uint16_t index;
+	uint8_t i;
+	esp_err_t err = ESP_OK;
+
+	xSemaphoreTake(node_db_lock, portMAX_DELAY);
+	index = node_db_search(addr, &found);
+	if(!found)
+	{
+		xSemaphoreGive(node_db_lock);
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	entry = &node_db[index];
+	for(i = 0; i < entry->property_count; i++)
+		if(entry->property_ids[i] == property_id)
+			break;
+	if(i == entry->property_count)
+	{
+		if(entry->property_count == NODE_DB_MAX_PROPERTIES)
+			err = ESP_ERR_NO_MEM;
+		else
+		{
+			entry->property_ids[entry->property_count++] = property_id;
+			err = node_db_store(index);
+		}
+	}
+	xSemaphoreGive(node_db_lock);
+	return err;
+}
+
+void node_db_seen(uint16_t addr)
+/* Notes that a message of the node came in, only in RAM until the next flush */
+{
+	_Bool found;
+	uint16_t index;
+
+	xSemaphoreTake(node_db_lock, portMAX_DELAY);
+	index = node_db_search(addr, &found);
+	if(found)
+	{
+		node_db[index].seen_boot = node_db_boot;
+		node_db[index].seen_s = esp_timer_get_time() / 1000000;
+		node_db_dirty[index] = true;
+	}
+	xSemaphoreGive(node_db_lock);
+}
+
+esp_err_t node_db_flush(void)
+/* Writes the entries of the nodes heard since the last flush, in one commit */
+{
+	nvs_handle_t handle;
+	_Bool opened = false;
+	esp_err_t err = ESP_OK;
+	uint16_t i;
+
+	xSemaphoreTake(node_db_lock, portMAX_DELAY);
+	for(i = 0; i < node_db_used && err == ESP_OK; i++)
+	{
+		if(!node_db_dirty[i])
+			continue;
+		if(!opened)
+		{
+			err = nvs_open(NODE_DB_NAMESPACE, NVS_READWRITE, &handle);
+			if(err != ESP_OK)
+				break;
+			opened = true;
+		}
+		err = node_db_write(handle, i);
+	}
+	if(opened)
+	{
+		if(err == ESP_OK)
+			err = nvs_commit(handle);
+		nvs_close(handle);
+	}
+	xSemaphoreGive(node_db_lock);
+
+	if(err != ESP_OK)
+		ESP_LOGE(TAG, "Failed to store the last seen times (err %d)", err);
+	return err;
+}
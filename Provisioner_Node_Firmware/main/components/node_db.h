@@ -0,0 +1,57 @@
+/*
+ * node_db.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_NODE_DB_H_
+#define MAIN_COMPONENTS_NODE_DB_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#define NODE_DB_NAMESPACE			"node_db"
+#define NODE_DB_MAX_NODES			CONFIG_BLE_MESH_MAX_PROV_NODES
+#define NODE_DB_MAX_PROPERTIES		4			// sensor property IDs kept per node
+#define NODE_DB_SEEN_FLUSH_MS		600000		// last seen times are written to flash this often
+
+// Flags of a node
+#define NODE_DB_CONFIGURED			(1 << 0)	// every step of the configuration by the provisioner is done
+#define NODE_DB_CONFIG_FAILED		(1 << 1)	// a step got no status after all retries, tried again after a reboot
+
+// Models of a node bound to the AppKey
+#define NODE_DB_BOUND_SENSOR_SRV		(1 << 0)
+#define NODE_DB_BOUND_SENSOR_SETUP_SRV	(1 << 1)
+#define NODE_DB_BOUND_BACKFILL_SRV		(1 << 2)
+#define NODE_DB_BOUND_ONOFF_SRV			(1 << 3)
+#define NODE_DB_BOUND_ONOFF_CLI			(1 << 4)
+#define NODE_DB_BOUND_TELEMETRY_SRV		(1 << 5)
+
+/* What the gateway knows of a provisioned node, 18 octets in RAM and in flash where it is one blob per node.
+ * The address, name, device key and composition data are kept by the stack with BLE_MESH_SETTINGS,
+ * esp_ble_mesh_provisioner_get_node_with_addr returns them */
+typedef struct{
+	uint16_t addr;									// primary element address, the table is sorted on it
+	uint8_t flags;
+	uint8_t bound;									// NODE_DB_BOUND_ bits
+	uint8_t property_count;
+	uint16_t property_ids[NODE_DB_MAX_PROPERTIES];
+	uint8_t seen_boot;								// boot of the gateway in which the node was last heard
+	uint32_t seen_s;								// uptime of the gateway then
+}__attribute__((packed)) node_db_entry_t;
+
+esp_err_t node_db_init(void);
+uint16_t node_db_count(void);
+_Bool node_db_get(uint16_t index, node_db_entry_t *entry);
+_Bool node_db_find(uint16_t addr, node_db_entry_t *entry);
+esp_err_t node_db_add(uint16_t addr);
+esp_err_t node_db_remove(uint16_t addr);
+esp_err_t node_db_set_flags(uint16_t addr, uint8_t flags);
+esp_err_t node_db_clear_flags(uint16_t addr, uint8_t flags);
+esp_err_t node_db_set_bound(uint16_t addr, uint8_t bound);
+esp_err_t node_db_add_property(uint16_t addr, uint16_t property_id);
+void node_db_seen(uint16_t addr);
+esp_err_t node_db_flush(void);
+
+#endif /* MAIN_COMPONENTS_NODE_DB_H_ */
@@ -0,0 +1,66 @@
+/*
+ * telemetry_decode.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <stdbool.h>
+#include "telemetry_decode.h"
+
+static _Bool telemetry_varint_read(const uint8_t *data, uint16_t length, uint16_t *offset, uint32_t *value)
+/* Little endian base 128, false when the message ends inside the varint */
+{
+	uint8_t shift;
+
+	*value = 0;
+	for(shift = 0; *offset < length && shift < 35; shift += 7)
+	{
+		*value |= (uint32_t)(data[*offset] & 0x7F) << shift;
+		if(!(data[(*offset)++] & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static inline int32_t telemetry_zigzag_decode(uint32_t value)
+{
+	return (int32_t)((value >> 1) ^ (0 - (value & 1)));
+}
+
+_Bool telemetry_decode(const uint8_t *data, uint16_t length, telemetry_decoded_t *batch)
+/* Undoes the delta encoding of a batch, false for a malformed one */
+{
+	uint16_t offset = 2;
+	uint32_t value;
+	int i, j;
+
+	if(length < 2 || data[1] == 0 || data[1] > TELEMETRY_MAX_SAMPLES)
+		return false;
+	batch->zone = data[0];
+	batch->count = data[1];
+
+	for(j = 0; j < batch->count; j++)
+	{
+		if(!telemetry_varint_read(data, length, &offset, &value))
+			return false;
+		batch->times[j] = j == 0 ? value : batch->times[j - 1] + value;
+	}
+
+	for(i = 0; offset < length; i++)
+	{
+		if(i == TELEMETRY_MAX_PROPERTIES || offset + 2 > length)
+			return false;
+		batch->property_ids[i] = data[offset] | data[offset + 1] << 8;
+		offset += 2;
+		for(j = 0; j < batch->count; j++)
+		{
+			if(!telemetry_varint_read(data, length, &offset, &value))
+				return false;
+			/* Deltas wrap around like they do on the node */
+			batch->values[i][j] = j == 0 ? telemetry_zigzag_decode(value) :
+					(int32_t)((uint32_t)batch->values[i][j - 1] + (uint32_t)telemetry_zigzag_decode(value));
+		}
+	}
+	batch->property_count = i;
+	return true;
+}
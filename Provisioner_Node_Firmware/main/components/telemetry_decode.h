@@ -0,0 +1,28 @@
+/*
+ * telemetry_decode.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_TELEMETRY_DECODE_H_
+#define MAIN_COMPONENTS_TELEMETRY_DECODE_H_
+
+#include <stdint.h>
+
+/* Delta encoded sample batches of the sensor node, see telemetry.h of the sensor node for the message layout */
+#define TELEMETRY_MAX_SAMPLES		32
+#define TELEMETRY_MAX_PROPERTIES	4
+
+// Samples of one batch, oldest first
+typedef struct{
+	uint8_t zone;
+	uint8_t count;
+	uint8_t property_count;
+	uint16_t property_ids[TELEMETRY_MAX_PROPERTIES];
+	uint32_t times[TELEMETRY_MAX_SAMPLES];		// uptime of the node in 100 ms
+	int32_t values[TELEMETRY_MAX_PROPERTIES][TELEMETRY_MAX_SAMPLES];
+}telemetry_decoded_t;
+
+_Bool telemetry_decode(const uint8_t *data, uint16_t length, telemetry_decoded_t *batch);
+
+#endif /* MAIN_COMPONENTS_TELEMETRY_DECODE_H_ */
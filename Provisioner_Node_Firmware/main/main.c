@@ -26,6 +26,7 @@ void app_main(void)
 	ESP_LOGI(TAG, "Initializing...");
 
 	LED_init();
+	power_init();
 
 	err = nvs_flash_init();
 	if (err == ESP_ERR_NVS_NO_FREE_PAGES) {
@@ -17,8 +17,11 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #include "driver/gpio.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
 
 #include "esp_ble_mesh_common_api.h"
 #include "esp_ble_mesh_networking_api.h"
@@ -42,6 +45,13 @@ const uint8_t smallest_delay_time_ms = 20;
 /* buzzer */
 const uint8_t times_vib = 3;
 
+/* power management, the CPU drops to the XTAL frequency when idle */
+#define POWER_MIN_FREQ_MHZ 40
+const uint32_t wakeup_log_period_ms = 60000;
+static SemaphoreHandle_t effect_wake_semaphore = NULL;
+static uint32_t effect_wakeups = 0;
+static int64_t effect_wakeups_since_us = 0;
+
 #define GPIO_INPUT_PIN_SEL  ((1ULL<<button_pins[0]) | (1ULL<<button_pins[1]))
 #define GPIO_OUTPUT_PIN_SEL (1ULL<<buzzer_and_relay_pin)
 #define ESP_INTR_FLAG_DEFAULT 0
@@ -283,6 +293,7 @@ uint8_t check_if_code_type(uint8_t code, uint8_t old_code, uint8_t node) {
   if (node == LED_NODE || node == BUTTONS_VIB_NODE) {
 	  if (msg_OP_CODE == INDICATOR_OP_CODE) {
 		display_code(code);
+		effect_wake();
 	    return code;
 	  } else {
 	    return old_code;
@@ -292,6 +303,7 @@ uint8_t check_if_code_type(uint8_t code, uint8_t old_code, uint8_t node) {
   } else if (node == RELAY_NODE) {
 	  if (msg_OP_CODE == CONTROL_OP_CODE) {
 		display_code(code);
+		effect_wake();
 	    return code;
 	  } else {
 		  ESP_LOGI(TAG, "Code not meant for this node");
@@ -397,9 +409,90 @@ void run_control_client(uint8_t * control_code, node_type node, uint8_t * curren
 }
 
 /*
- * Function:  run_indicator_client
- * -------------------------------
- *  This function will perform all tasks for an indicator or control node and is meant to be used as a delay function
+ * Function:  effect_hold_ticks
+ * ----------------------------
+ *  Number of effect steps, starting at count, that show the same output
+ *
+ *  effect_used: LED effect displayed (LED_OFF, STATIC, BLINKING, BREATHING)
+ *  count: counter used for the effect
+ *  vib_count: times the vibration motor will still vibrate, it pulses every step
+ *
+ *  returns: steps the output holds, 0 if it holds until the effect changes
+ */
+static uint16_t effect_hold_ticks(effect effect_used, uint8_t count, uint8_t vib_count) {
+
+  if (vib_count > 0 || effect_used == BREATHING) {
+    return 1;
+  }
+
+  if (effect_used == BLINKING) {
+    if (count < (count_max / 2)) {
+      return (count_max / 2) - count;
+    }
+    return count_max + 1 - count;
+  }
+
+  return 0;
+}
+
+/*
+ * Function:  effect_sleep
+ * -----------------------
+ *  Waits as many steps of smallest_delay_time_ms as the output holds, so the CPU can idle
+ *  for the whole wait instead of waking up every step. The wait ends early on effect_wake
+ *
+ *  hold_ticks: steps the output holds, 0 to wait the rest of the delay
+ *  delay_repititions: steps left of the delay, lowered by the steps waited
+ *  woken: set when effect_wake ended the wait
+ *
+ *  returns: steps waited
+ */
+static uint16_t effect_sleep(uint16_t hold_ticks, uint16_t * delay_repititions, bool * woken) {
+
+  TickType_t step_ticks = pdMS_TO_TICKS(smallest_delay_time_ms);
+  TickType_t start = xTaskGetTickCount();
+  uint16_t steps = hold_ticks;
+  int64_t now;
+
+  if (hold_ticks == 0 || hold_ticks > * delay_repititions) {
+    steps = * delay_repititions;
+  }
+
+  * woken = xSemaphoreTake(effect_wake_semaphore, steps * step_ticks) == pdTRUE;
+  if ( * woken) {
+    steps = (xTaskGetTickCount() - start) / step_ticks;
+  }
+  * delay_repititions -= steps;
+
+  /* every wakeup is counted, a node showing a steady LED should hardly add any */
+  effect_wakeups++;
+  now = esp_timer_get_time();
+  if (now - effect_wakeups_since_us >= (int64_t) wakeup_log_period_ms * 1000) {
+    ESP_LOGI(TAG, "Effect wakeups: %u in %u ms", effect_wakeups, (uint32_t) ((now - effect_wakeups_since_us) / 1000));
+    effect_wakeups = 0;
+    effect_wakeups_since_us = now;
+  }
+
+  return steps;
+}
+
+/*
+ * Function:  effect_wake
+ * ----------------------
+ *  Ends the wait of the delay functions early so a new code or effect is shown right away.
+ *  Has to be called when the code or effect used by the main loop changes
+ */
+void effect_wake(void) {
+  if (effect_wake_semaphore != NULL) {
+    xSemaphoreGive(effect_wake_semaphore);
+  }
+}
+
+/*
+ * Function:  run_client_as_delay
+ * ------------------------------
+ *  This function will perform all tasks for an indicator or control node and is meant to be used as a delay function.
+ *  It only wakes up when the output changes, so a steady LED lets the node idle for the whole delay
  *
  *  code: the code containing the information for the indicator or control node operation
  *  node:	type of node
@@ -409,15 +502,25 @@ void run_control_client(uint8_t * control_code, node_type node, uint8_t * curren
  */
 void run_client_as_delay(uint8_t * code, node_type node, uint8_t * current_count, uint8_t * vib_count, uint16_t delay_repititions) {
 
+  uint8_t shown_count;
+  uint16_t steps;
+  bool woken = false;
+
   if (node == LED_NODE || node == BUTTONS_VIB_NODE) {
-    for (int i = 0; i < delay_repititions; i++) {
+    while (delay_repititions > 0 && !woken) {
       run_indicator_client(code, node, current_count, vib_count);
-      vTaskDelay(pdMS_TO_TICKS(smallest_delay_time_ms));
+
+      /* run_indicator_client already counted the step it has shown */
+      shown_count = ( * current_count == 0) ? count_max : * current_count - 1;
+      steps = effect_sleep(effect_hold_ticks((effect) ((*code & EFFECT_MASK) >> 3), shown_count, * vib_count), &delay_repititions, &woken);
+      if (steps > 1) {
+        * current_count = ( * current_count + steps - 1) % (count_max + 1);
+      }
     }
   } else if (node == RELAY_NODE) {
-    for (int i = 0; i < delay_repititions; i++) {
+    while (delay_repititions > 0 && !woken) {
       run_control_client(code, node, current_count);
-      vTaskDelay(pdMS_TO_TICKS(smallest_delay_time_ms));
+      effect_sleep(0, &delay_repititions, &woken);
     }
   }
 }
@@ -425,7 +528,8 @@ void run_client_as_delay(uint8_t * code, node_type node, uint8_t * current_count
 /*
  * Function:  run_light_as_delay
  * -----------------------------
- *  This function is meant for other nodes that do not use indicator codes but still want to display LED effects
+ *  This function is meant for other nodes that do not use indicator codes but still want to display LED effects.
+ *  It only wakes up when the output changes and returns early on effect_wake
  *
  *  effect_used: LED effect displayed (LED_OFF, STATIC, BLINKING, BREATHING)
  *  indicator_colour: colour of the LED (RED, ORANGE, YELLOW, GREEN, CYAN, BLUE, PURPLE, WHITE)
@@ -434,15 +538,14 @@ void run_client_as_delay(uint8_t * code, node_type node, uint8_t * current_count
  */
 void run_light_as_delay(effect effect_used, colour colour_used, uint8_t * current_count, uint16_t delay_repititions) {
 
-  for (int i = 0; i < delay_repititions; i++) {
+  uint16_t steps;
+  bool woken = false;
+
+  while (delay_repititions > 0 && !woken) {
     run_lights(effect_used, colour_used, * current_count);
 
-    if ( * current_count >= count_max)
-      *current_count = 0;
-    else {
-      (*current_count) ++;
-    }
-    vTaskDelay(pdMS_TO_TICKS(smallest_delay_time_ms));
+    steps = effect_sleep(effect_hold_ticks(effect_used, * current_count, 0), &delay_repititions, &woken);
+    * current_count = ( * current_count + steps) % (count_max + 1);
   }
 }
 
@@ -464,6 +567,46 @@ void display_code(uint8_t code) {
 }
 
 
+/* ------------------------
+ *  power management
+ * ------------------------
+ */
+
+/*
+ * Function:  power_init
+ * ---------------------
+ *  Sets up dynamic frequency scaling and automatic light sleep. The CPU runs at the default
+ *  frequency while a task or the BLE controller holds a lock, at POWER_MIN_FREQ_MHZ otherwise.
+ *  Light sleep is only entered when no task is due and the controller does not scan, so a node
+ *  that scans all the time for the mesh only gets the lower frequency.
+ *  Has to be called before the delay functions are used
+ */
+void power_init(void) {
+
+  effect_wake_semaphore = xSemaphoreCreateBinary();
+
+#if CONFIG_PM_ENABLE
+  esp_err_t err;
+  esp_pm_config_esp32c3_t pm_config = {
+    .max_freq_mhz = CONFIG_ESP32C3_DEFAULT_CPU_FREQ_MHZ,
+    .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    .light_sleep_enable = true,
+#endif
+  };
+
+  err = esp_pm_configure(&pm_config);
+  if (err) {
+    ESP_LOGE(TAG, "Power management config failed (err %d)", err);
+  } else {
+    ESP_LOGI(TAG, "Power management: %d - %d MHz, light sleep %d", pm_config.min_freq_mhz, pm_config.max_freq_mhz, pm_config.light_sleep_enable);
+  }
+#else
+  ESP_LOGW(TAG, "Power management disabled, CONFIG_PM_ENABLE is not set");
+#endif
+}
+
+
 /* --------------------------------
  *  publishing code for the PC node
  * --------------------------------
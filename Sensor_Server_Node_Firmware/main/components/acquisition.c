@@ -0,0 +1,509 @@
+/*
+ * acquisition.c
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#include "esp_log.h"
+#include "acquisition.h"
+
+#define TAG "ACQUISITION"
+
+/* Round up so the delay is never shorter than the conversion time at the 10 ms FreeRTOS tick. In 64 bit,
+ * a 32 bit product overflows above 11.9 h at a 100 Hz tick, and periods come from the mesh */
+#define MS_TO_TICKS_CEIL(ms)	((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ + 999) / 1000))
+
+/* Notification bit of new settings, the bits below are the ALERT pins of the devices */
+#define ACQUISITION_NOTIFY_SETTINGS	(1UL << 31)
+
+// States of the acquisition state machine
+typedef enum{
+	ACQUISITION_TRIGGER,			// single shot: send the measurement command
+	ACQUISITION_FETCH,				// single shot: read back the result once the conversion time has passed
+	ACQUISITION_PERIODIC_START,		// periodic: put the sensor in periodic mode
+	ACQUISITION_PERIODIC_FETCH,		// periodic: fetch and filter every result of the sensor
+	ACQUISITION_ALERT_START,		// alert: put the sensor in periodic mode
+	ACQUISITION_ALERT_WAIT,			// alert: wait for the ALERT pin or the heartbeat, then fetch and re-arm the limits
+}etAcquisitionState;
+
+// One SHT35 and the state of its state machine
+typedef struct{
+	SHT35_t sensor;
+	gpio_num_t alert_gpio;
+	uint8_t index;					// device index in the samples
+	etAcquisitionState state;
+	_Bool art;						// periodic mode is started with the ART command
+	uint8_t filter_depth;
+	TickType_t sample_period_ticks;
+	TickType_t conversion_ticks;
+	TickType_t periodic_interval_ticks;
+	TickType_t next_step;			// tick count at which the next step of the state machine runs
+	_Bool wait_for_alert;			// alert mode without heartbeat, only the ALERT pin runs the next step
+	_Bool alert_recheck;			// alert mode, the ALERT pin was still high after re-arming, its level is read at the next step
+	TickType_t next_output;
+	filter_t temperature_filter;
+	filter_t humidity_filter;
+}acquisition_context_t;
+
+static acquisition_config_t acquisition_config;
+static acquisition_context_t contexts[ACQUISITION_MAX_DEVICES];
+static uint8_t context_count;
+static etAcquisitionState first_state;
+static TickType_t heartbeat_ticks;
+static uint16_t raw_temperature_delta;
+static uint16_t raw_humidity_delta;
+static TaskHandle_t acquisition_task_handle = NULL;
+
+/* Settings handed to the task by acquisition_configure, a device is only reconfigured between two steps */
+static acquisition_settings_t pending_settings[ACQUISITION_MAX_DEVICES];
+static uint32_t pending_devices;
+static portMUX_TYPE pending_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Holds the newest samples of all devices, the publisher never has to drain old readings */
+static QueueHandle_t sample_queue = NULL;
+
+static void acquisition_output(const acquisition_context_t *ctx, uint16_t raw_temperature, uint16_t raw_humidity)
+/* Converts the raw words and hands the sample to the publisher, when it falls behind the oldest sample is dropped */
+{
+	sensor_sample_t sample = {
+		.device = ctx->index,
+		.temperature = convert_raw_temperature(raw_temperature),
+		.humidity = convert_raw_humidity(raw_humidity),
+		.timestamp = xTaskGetTickCount(),
+	};
+	sensor_sample_t dropped;
+
+	if(xQueueSend(sample_queue, &sample, 0) != pdTRUE)
+	{
+		xQueueReceive(sample_queue, &dropped, 0);
+		xQueueSend(sample_queue, &sample, 0);
+	}
+}
+
+static TickType_t acquisition_single_shot_step(acquisition_context_t *ctx)
+{
+	uint8_t raw_data[6] = {0};
+	esp_err_t err;
+
+	switch(ctx->state)
+	{
+		case ACQUISITION_TRIGGER:
+			err = SHT35_start_single_shot(&ctx->sensor);
+			if(err != ESP_OK)
+			{
+				ESP_LOGE(TAG, "SHT35 %u: I2C com error 0x%x, is the I2C device connected?", ctx->index, err);
+				return ctx->sample_period_ticks;
+			}
+			ctx->state = ACQUISITION_FETCH;
+			return ctx->conversion_ticks;
+
+		case ACQUISITION_FETCH:
+		default:
+			ctx->state = ACQUISITION_TRIGGER;
+			err = SHT35_fetch_single_shot(&ctx->sensor, raw_data, sizeof(raw_data));
+			if(err != ESP_OK)
+				ESP_LOGE(TAG, "SHT35 %u: failed to fetch measurement 0x%x", ctx->index, err);
+			else
+				acquisition_output(ctx, (raw_data[0] << 8) | raw_data[1], (raw_data[3] << 8) | raw_data[4]);
+			return ctx->sample_period_ticks - ctx->conversion_ticks;
+	}
+}
+
+static esp_err_t acquisition_start_measuring(acquisition_context_t *ctx)
+/* Puts the sensor in periodic mode, with ART it measures at 4 Hz whatever its frequency */
+{
+	if(ctx->art)
+		return SHT35_ART_command(&ctx->sensor);
+	return SHT35_periodic_data_acquisition(&ctx->sensor);
+}
+
+static TickType_t acquisition_periodic_step(acquisition_context_t *ctx)
+{
+	uint8_t raw_data[6] = {0};
+	uint16_t raw_temperature, raw_humidity;
+	esp_err_t err;
+
+	switch(ctx->state)
+	{
+		case ACQUISITION_PERIODIC_START:
+			err = acquisition_start_measuring(ctx);
+			if(err != ESP_OK)
+			{
+				ESP_LOGE(TAG, "SHT35 %u: I2C com error 0x%x, is the I2C device connected?", ctx->index, err);
+				return ctx->sample_period_ticks;
+			}
+			filter_init(&ctx->temperature_filter, acquisition_config.filter, ctx->filter_depth);
+			filter_init(&ctx->humidity_filter, acquisition_config.filter, ctx->filter_depth);
+			ctx->next_output = xTaskGetTickCount() + ctx->sample_period_ticks;
+			ctx->state = ACQUISITION_PERIODIC_FETCH;
+			/* First result is ready one interval plus one conversion after the command */
+			return ctx->periodic_interval_ticks + ctx->conversion_ticks;
+
+		case ACQUISITION_PERIODIC_FETCH:
+		default:
+			err = SHT35_read_measurements_periodic_mode(&ctx->sensor, raw_data, sizeof(raw_data));
+			if(err == ESP_OK)
+			{
+				filter_push(&ctx->temperature_filter, (raw_data[0] << 8) | raw_data[1]);
+				filter_push(&ctx->humidity_filter, (raw_data[3] << 8) | raw_data[4]);
+			}
+			else
+			{
+				/* A NACK means no new result yet, the next fetch picks it up */
+				ESP_LOGD(TAG, "SHT35 %u: periodic fetch failed 0x%x", ctx->index, err);
+			}
+
+			if((int32_t)(xTaskGetTickCount() - ctx->next_output) >= 0)
+			{
+				ctx->next_output += ctx->sample_period_ticks;
+				if(filter_output(&ctx->temperature_filter, &raw_temperature) && filter_output(&ctx->humidity_filter, &raw_humidity))
+					acquisition_output(ctx, raw_temperature, raw_humidity);
+			}
+			return ctx->periodic_interval_ticks;
+	}
+}
+
+static void IRAM_ATTR acquisition_alert_isr(void *arg)
+/* Rising edge of the ALERT pin of one sensor, the measurement is read from the task.
+ * Every sensor has its own bit in the notification value */
+{
+	const acquisition_context_t *ctx = arg;
+	BaseType_t higher_priority_task_woken = pdFALSE;
+
+	xTaskNotifyFromISR(acquisition_task_handle, 1UL << ctx->index, eSetBits, &higher_priority_task_woken);
+	if(higher_priority_task_woken)
+		portYIELD_FROM_ISR();
+}
+
+static uint16_t add_clamped(uint16_t value, int32_t delta)
+{
+	int32_t result = (int32_t)value + delta;
+
+	if(result < 0)
+		return 0;
+	if(result > 0xFFFF)
+		return 0xFFFF;
+	return result;
+}
+
+static esp_err_t acquisition_arm_alert(acquisition_context_t *ctx, uint16_t raw_temperature, uint16_t raw_humidity)
+/* Places a window of +-delta around the last published value, the ALERT pin rises once either value leaves it.
+ * The clear limits sit halfway so the pin does not toggle on noise around a limit */
+{
+	esp_err_t err;
+
+	err = SHT35_break_command(&ctx->sensor);
+	if(err != ESP_OK)
+		return err;
+	vTaskDelay(1);
+
+	err = SHT35_write_alert_limit(&ctx->sensor, ALERT_HIGH_SET, add_clamped(raw_temperature, raw_temperature_delta), add_clamped(raw_humidity, raw_humidity_delta));
+	if(err == ESP_OK)
+		err = SHT35_write_alert_limit(&ctx->sensor, ALERT_HIGH_CLEAR, add_clamped(raw_temperature, raw_temperature_delta / 2), add_clamped(raw_humidity, raw_humidity_delta / 2));
+	if(err == ESP_OK)
+		err = SHT35_write_alert_limit(&ctx->sensor, ALERT_LOW_CLEAR, add_clamped(raw_temperature, -(raw_temperature_delta / 2)), add_clamped(raw_humidity, -(raw_humidity_delta / 2)));
+	if(err == ESP_OK)
+		err = SHT35_write_alert_limit(&ctx->sensor, ALERT_LOW_SET, add_clamped(raw_temperature, -raw_temperature_delta), add_clamped(raw_humidity, -raw_humidity_delta));
+	if(err == ESP_OK)
+		err = SHT35_clear_status_register(&ctx->sensor);
+	if(err == ESP_OK)
+		err = acquisition_start_measuring(ctx);
+
+	return err;
+}
+
+static _Bool acquisition_alert_level(const acquisition_context_t *ctx)
+{
+	return ctx->alert_gpio != GPIO_NUM_NC && gpio_get_level(ctx->alert_gpio) == 1;
+}
+
+static TickType_t acquisition_alert_wait_ticks(const acquisition_context_t *ctx)
+/* Results are cleared by the break command, the next one is only ready after a full interval */
+{
+	return heartbeat_ticks > ctx->periodic_interval_ticks + ctx->conversion_ticks ? heartbeat_ticks : ctx->periodic_interval_ticks + ctx->conversion_ticks;
+}
+
+static TickType_t acquisition_alert_step(acquisition_context_t *ctx, _Bool alert_raised)
+{
+	uint8_t raw_data[6] = {0};
+	uint16_t raw_temperature, raw_humidity;
+	SHT35_status_t status;
+	esp_err_t err;
+
+	switch(ctx->state)
+	{
+		case ACQUISITION_ALERT_START:
+			err = acquisition_start_measuring(ctx);
+			if(err != ESP_OK)
+			{
+				ESP_LOGE(TAG, "SHT35 %u: I2C com error 0x%x, is the I2C device connected?", ctx->index, err);
+				return ctx->sample_period_ticks;
+			}
+			ctx->state = ACQUISITION_ALERT_WAIT;
+			ctx->alert_recheck = false;
+			return ctx->periodic_interval_ticks + ctx->conversion_ticks;
+
+		case ACQUISITION_ALERT_WAIT:
+		default:
+			/* A recheck only fetches when the pin is still high, otherwise the limits hold and the wait goes on */
+			if(ctx->alert_recheck)
+			{
+				ctx->alert_recheck = false;
+				if(!alert_raised && !acquisition_alert_level(ctx))
+					return acquisition_alert_wait_ticks(ctx);
+				alert_raised = true;
+			}
+
+			if(alert_raised && SHT35_read_status(&ctx->sensor, &status) == ESP_OK)
+				ESP_LOGI(TAG, "SHT35 %u: alert, temperature %d humidity %d", ctx->index, status.t_tracking_alert, status.rh_tracking_alert);
+
+			err = SHT35_read_measurements_periodic_mode(&ctx->sensor, raw_data, sizeof(raw_data));
+			if(err != ESP_OK)
+			{
+				ESP_LOGD(TAG, "SHT35 %u: alert fetch failed 0x%x", ctx->index, err);
+				return ctx->periodic_interval_ticks;
+			}
+			raw_temperature = (raw_data[0] << 8) | raw_data[1];
+			raw_humidity = (raw_data[3] << 8) | raw_data[4];
+			acquisition_output(ctx, raw_temperature, raw_humidity);
+
+			err = acquisition_arm_alert(ctx, raw_temperature, raw_humidity);
+			if(err != ESP_OK)
+			{
+				ESP_LOGE(TAG, "SHT35 %u: failed to set alert limits 0x%x", ctx->index, err);
+				ctx->state = ACQUISITION_ALERT_START;
+				return ctx->sample_period_ticks;
+			}
+			/* The interrupt only fires on a rising edge. A pin that stayed high through the re-arm raises none, without
+			 * a heartbeat that alert would be waited for forever, so its level is read again after the next result */
+			if(acquisition_alert_level(ctx))
+			{
+				ctx->alert_recheck = true;
+				return ctx->periodic_interval_ticks + ctx->conversion_ticks;
+			}
+			return acquisition_alert_wait_ticks(ctx);
+	}
+}
+
+static void acquisition_set(acquisition_context_t *ctx, const acquisition_settings_t *settings)
+{
+	ctx->sensor.repeatability = settings->repeatability;
+	ctx->sensor.frequency = settings->frequency;
+	ctx->art = settings->art;
+	ctx->filter_depth = settings->filter_depth;
+	ctx->sample_period_ticks = MS_TO_TICKS_CEIL(settings->sample_period_ms);
+	ctx->conversion_ticks = MS_TO_TICKS_CEIL(SHT35_conversion_time_ms(settings->repeatability));
+	ctx->periodic_interval_ticks = MS_TO_TICKS_CEIL(settings->art ? ACQUISITION_ART_INTERVAL_MS : SHT35_periodic_interval_ms(settings->frequency));
+}
+
+static void acquisition_apply_pending(TickType_t now)
+/* A sensor that measures on its own is stopped first, every reconfigured sensor starts over from its first state
+ * with empty filters. The break command needs 1 ms before the next command */
+{
+	acquisition_settings_t settings;
+	acquisition_context_t *ctx;
+	_Bool pending;
+	uint8_t i;
+
+	for(i = 0; i < context_count; i++)
+	{
+		taskENTER_CRITICAL(&pending_lock);
+		pending = (pending_devices >> i) & 1;
+		pending_devices &= ~(1UL << i);
+		settings = pending_settings[i];
+		taskEXIT_CRITICAL(&pending_lock);
+		if(!pending)
+			continue;
+
+		ctx = &contexts[i];
+		if(ctx->sensor.mode == SHT35_PERIODIC && SHT35_break_command(&ctx->sensor) != ESP_OK)
+			ESP_LOGW(TAG, "SHT35 %u: break command failed", ctx->index);
+		acquisition_set(ctx, &settings);
+		ctx->state = first_state;
+		ctx->next_step = now + 1;
+		ctx->wait_for_alert = false;
+		ESP_LOGI(TAG, "SHT35 %u: period %u ms, repeatability %d, frequency %d, ART %d, filter depth %u", ctx->index,
+				settings.sample_period_ms, settings.repeatability, settings.frequency, settings.art, settings.filter_depth);
+	}
+}
+
+static void acquisition_task(void *arg)
+{
+	acquisition_context_t *ctx;
+	uint32_t alerts = 0;
+	TickType_t now, wait, ticks;
+	_Bool alert_raised;
+	uint8_t i;
+
+	while(1)
+	{
+		/* Runs one step of the state machine of every sensor that is due, every step returns the number of
+		 * ticks until the next one. The I2C bus and the CPU are released while the sensors convert */
+		now = xTaskGetTickCount();
+		if(alerts & ACQUISITION_NOTIFY_SETTINGS)
+			acquisition_apply_pending(now);
+
+		for(i = 0; i < context_count; i++)
+		{
+			ctx = &contexts[i];
+			alert_raised = (alerts >> i) & 1;
+			if(!alert_raised && (ctx->wait_for_alert || (int32_t)(now - ctx->next_step) < 0))
+				continue;
+
+			if(acquisition_config.mode == ALERT_MODE)
+			{
+				/* Alert steps wait relative to now, a raised ALERT pin cuts the wait short */
+				ticks = acquisition_alert_step(ctx, alert_raised);
+				ctx->wait_for_alert = ticks == portMAX_DELAY;
+				ctx->next_step = now + ticks;
+			}
+			else if(acquisition_config.mode == PERIODIC_MODE)
+				ctx->next_step += acquisition_periodic_step(ctx);
+			else
+				ctx->next_step += acquisition_single_shot_step(ctx);
+		}
+
+		now = xTaskGetTickCount();
+		wait = portMAX_DELAY;
+		for(i = 0; i < context_count; i++)
+		{
+			if(contexts[i].wait_for_alert)
+				continue;
+			ticks = (int32_t)(contexts[i].next_step - now) > 0 ? contexts[i].next_step - now : 0;
+			if(ticks < wait)
+				wait = ticks;
+		}
+
+		if(xTaskNotifyWait(0, UINT32_MAX, &alerts, wait) != pdTRUE)
+			alerts = 0;
+	}
+}
+
+static esp_err_t acquisition_alert_init(acquisition_context_t *ctx)
+/* The ALERT pin is a push-pull output of the SHT35, the rising edge interrupts and the task reads the level
+ * after re-arming the limits */
+{
+	gpio_config_t io_conf = {
+		.pin_bit_mask = 1ULL << ctx->alert_gpio,
+		.mode = GPIO_MODE_INPUT,
+		.pull_up_en = GPIO_PULLUP_DISABLE,
+		.pull_down_en = GPIO_PULLDOWN_DISABLE,
+		.intr_type = GPIO_INTR_POSEDGE,
+	};
+	esp_err_t err;
+
+	err = gpio_config(&io_conf);
+	if(err != ESP_OK)
+		return err;
+
+	err = gpio_install_isr_service(0);
+	if(err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+		return err;
+
+	return gpio_isr_handler_add(ctx->alert_gpio, acquisition_alert_isr, ctx);
+}
+
+esp_err_t acquisition_check_settings(const acquisition_settings_t *settings)
+/* The sample period has to be in the range of the Kconfig option and leave room for the conversion */
+{
+	if(settings->sample_period_ms < ACQUISITION_MIN_SAMPLE_PERIOD_MS || settings->sample_period_ms > ACQUISITION_MAX_SAMPLE_PERIOD_MS)
+		return ESP_ERR_INVALID_ARG;
+	if(settings->repeatability > LOW_REPEATABILITY || settings->frequency > FREQUENCY_10HZ)
+		return ESP_ERR_INVALID_ARG;
+	if(settings->filter_depth < 1 || settings->filter_depth > FILTER_MAX_DEPTH)
+		return ESP_ERR_INVALID_ARG;
+	if(MS_TO_TICKS_CEIL(settings->sample_period_ms) <= MS_TO_TICKS_CEIL(SHT35_conversion_time_ms(settings->repeatability)))
+		return ESP_ERR_INVALID_ARG;
+	return ESP_OK;
+}
+
+esp_err_t acquisition_start(const acquisition_config_t *config, const acquisition_device_t *devices,
+		const acquisition_settings_t *settings, uint8_t count)
+/* Starts the sampling task, every sample period a new (filtered) sample of every device is made available
+ * through acquisition_receive. The devices are started a sample period / count apart so their reads interleave */
+{
+	TickType_t start = xTaskGetTickCount();
+	acquisition_context_t *ctx;
+	esp_err_t err;
+	uint8_t i;
+
+	if(sample_queue != NULL)
+		return ESP_ERR_INVALID_STATE;
+	if(count == 0 || count > ACQUISITION_MAX_DEVICES)
+		return ESP_ERR_INVALID_ARG;
+
+	acquisition_config = *config;
+
+	if(config->mode == ALERT_MODE)
+		first_state = ACQUISITION_ALERT_START;
+	else if(config->mode == PERIODIC_MODE)
+		first_state = ACQUISITION_PERIODIC_START;
+	else
+		first_state = ACQUISITION_TRIGGER;
+
+	for(i = 0; i < count; i++)
+	{
+		ctx = &contexts[i];
+		ctx->sensor = devices[i].sensor;
+		ctx->alert_gpio = devices[i].alert_gpio;
+		ctx->index = i;
+		ctx->state = first_state;
+		err = acquisition_check_settings(&settings[i]);
+		if(err != ESP_OK)
+			return err;
+		acquisition_set(ctx, &settings[i]);
+		ctx->next_step = start + i * ctx->sample_period_ticks / count;
+		ctx->wait_for_alert = false;
+		ctx->alert_recheck = false;
+	}
+	context_count = count;
+
+	heartbeat_ticks = config->heartbeat_period_ms ? MS_TO_TICKS_CEIL(config->heartbeat_period_ms) : portMAX_DELAY;
+	raw_temperature_delta = convert_temperature_to_raw(config->temperature_delta - 4500);
+	raw_humidity_delta = convert_humidity_to_raw(config->humidity_delta);
+
+	sample_queue = xQueueCreate(2 * count, sizeof(sensor_sample_t));
+	if(sample_queue == NULL)
+		return ESP_ERR_NO_MEM;
+
+	if(xTaskCreate(acquisition_task, "acquisition", ACQUISITION_TASK_STACK_SIZE, NULL, ACQUISITION_TASK_PRIORITY, &acquisition_task_handle) != pdPASS)
+		return ESP_ERR_NO_MEM;
+
+	if(config->mode != ALERT_MODE)
+		return ESP_OK;
+
+	for(i = 0; i < count; i++)
+	{
+		err = acquisition_alert_init(&contexts[i]);
+		if(err != ESP_OK)
+			return err;
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t acquisition_configure(uint8_t device, const acquisition_settings_t *settings)
+/* Hands new settings of a device to the running task, they apply from its next step on */
+{
+	esp_err_t err;
+
+	if(acquisition_task_handle == NULL || device >= context_count)
+		return ESP_ERR_INVALID_STATE;
+	err = acquisition_check_settings(settings);
+	if(err != ESP_OK)
+		return err;
+
+	taskENTER_CRITICAL(&pending_lock);
+	pending_settings[device] = *settings;
+	pending_devices |= 1UL << device;
+	taskEXIT_CRITICAL(&pending_lock);
+
+	xTaskNotify(acquisition_task_handle, ACQUISITION_NOTIFY_SETTINGS, eSetBits);
+	return ESP_OK;
+}
+
+BaseType_t acquisition_receive(sensor_sample_t *sample, TickType_t ticks_to_wait)
+/* Waits up to ticks_to_wait for the next sample of any device */
+{
+	return xQueueReceive(sample_queue, sample, ticks_to_wait);
+}
@@ -0,0 +1,68 @@
+/*
+ * acquisition.h
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_ACQUISITION_H_
+#define MAIN_COMPONENTS_ACQUISITION_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/gpio.h"
+#include "commands.h"
+#include "filter.h"
+
+#define ACQUISITION_TASK_STACK_SIZE		3072
+#define ACQUISITION_TASK_PRIORITY		5
+#define ACQUISITION_MAX_DEVICES			4		// two addresses on each of two buses
+#define ACQUISITION_ART_INTERVAL_MS		250		// accelerated response time measures at 4 Hz
+#define ACQUISITION_MIN_SAMPLE_PERIOD_MS	100		// range of CONFIG_SENSOR_SAMPLE_PERIOD_MS
+#define ACQUISITION_MAX_SAMPLE_PERIOD_MS	60000
+
+// How the SHT35 is operated
+typedef enum{
+	SINGLE_SHOT_MODE,	// one single shot measurement per sample period
+	PERIODIC_MODE,		// sensor measures on its own, every result is fetched and filtered
+	ALERT_MODE,			// sensor measures on its own, a result is only fetched when the ALERT pin rises or on the heartbeat
+}etAcquisitionMode;
+
+typedef struct{
+	etAcquisitionMode mode;
+	etFilterType filter;		// periodic mode only
+	uint16_t temperature_delta;	// alert mode only, change in 0.01 C that raises the ALERT pin
+	uint16_t humidity_delta;	// alert mode only, change in 0.01 %RH that raises the ALERT pin
+	uint32_t heartbeat_period_ms;	// alert mode only, sample anyway after this long without alert, 0 disables it
+}acquisition_config_t;
+
+// One SHT35 sampled by the acquisition task
+typedef struct{
+	SHT35_t sensor;				// bus and address, the repeatability and frequency come from its settings
+	gpio_num_t alert_gpio;		// alert mode only, GPIO connected to the ALERT pin of this sensor
+}acquisition_device_t;
+
+// Sampling parameters of one SHT35, they can be changed while it is sampled
+typedef struct{
+	uint32_t sample_period_ms;		// interval at which samples are handed to the publisher
+	etRepeatability repeatability;	// repeatability of every measurement
+	etFrequency frequency;			// periodic and alert mode, measurement frequency of the sensor
+	_Bool art;						// periodic and alert mode, accelerated response time instead of the frequency
+	uint8_t filter_depth;			// periodic mode only, 1 to FILTER_MAX_DEPTH
+}acquisition_settings_t;
+
+// Sample handed from the acquisition task to the publisher
+typedef struct{
+	uint8_t device;			// index of the SHT35 in the devices passed to acquisition_start
+	int16_t temperature;	// 0.01 C
+	uint16_t humidity;		// 0.01 %RH
+	TickType_t timestamp;	// tick count at which the result was read
+}sensor_sample_t;
+
+esp_err_t acquisition_check_settings(const acquisition_settings_t *settings);
+esp_err_t acquisition_start(const acquisition_config_t *config, const acquisition_device_t *devices,
+		const acquisition_settings_t *settings, uint8_t count);
+esp_err_t acquisition_configure(uint8_t device, const acquisition_settings_t *settings);
+BaseType_t acquisition_receive(sensor_sample_t *sample, TickType_t ticks_to_wait);
+
+#endif /* MAIN_COMPONENTS_ACQUISITION_H_ */
@@ -0,0 +1,230 @@
+/*
+ * backfill.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <string.h>
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ble_mesh_networking_api.h"
+#include "backfill.h"
+#include "sample_log.h"
+
+#define TAG "BACKFILL"
+
+/* Sensor Status publications are unacknowledged, so the node cannot tell whether the gateway got them.
+ * Instead the gateway acknowledges a small Status published every status period. A Status that went
+ * unanswered marks the gateway unreachable, and once it answers again the samples logged since the
+ * last answer are replayed to it in batches at the replay interval. The gateway may also ask for any
+ * range still in the log with a Get. */
+
+static esp_ble_mesh_model_t *backfill_model;
+static backfill_config_t backfill_config;
+static TaskHandle_t backfill_task_handle = NULL;
+
+// Shared between the mesh callbacks and the backfill task
+static portMUX_TYPE backfill_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t acked;					// the samples below were logged while the gateway answered
+static uint8_t unanswered;				// Status publications since the last Ack
+static uint32_t replay_next;			// replay_next == replay_end when no replay is running
+static uint32_t replay_end;
+static esp_ble_mesh_msg_ctx_t gateway;	// destination of the replay
+
+static void backfill_publish_status(void)
+{
+	backfill_status_t status = {.boot = sample_log_boot()};
+	uint32_t first, next;
+	esp_err_t err;
+
+	sample_log_range(&first, &next);
+	status.first_sequence = first;
+	status.next_sequence = next;
+	err = esp_ble_mesh_model_publish(backfill_model, BACKFILL_OP_STATUS, sizeof(status), (uint8_t *)&status, ROLE_NODE);
+	if(err != ESP_OK)
+		return;
+
+	taskENTER_CRITICAL(&backfill_lock);
+	if(unanswered < UINT8_MAX)
+		unanswered++;
+	taskEXIT_CRITICAL(&backfill_lock);
+}
+
+static _Bool backfill_send_batch(void)
+/* Sends the next batch of the running replay, returns false when there is nothing left to send */
+{
+	static uint8_t message[sizeof(backfill_data_header_t) + BACKFILL_MAX_BATCH * sizeof(backfill_data_record_t)];
+	static sample_log_record_t records[BACKFILL_MAX_BATCH];
+	backfill_data_header_t *header = (backfill_data_header_t *)message;
+	backfill_data_record_t *data = (backfill_data_record_t *)(message + sizeof(*header));
+	esp_ble_mesh_msg_ctx_t ctx;
+	uint32_t start, sequence, end;
+	uint16_t count, i;
+	esp_err_t err;
+
+	taskENTER_CRITICAL(&backfill_lock);
+	start = replay_next;
+	end = replay_end;
+	ctx = gateway;
+	taskEXIT_CRITICAL(&backfill_lock);
+
+	if(start >= end)
+		return false;
+
+	sequence = start;
+	count = sample_log_read(&sequence, end, records, backfill_config.batch_size);
+
+	header->boot = sample_log_boot();
+	header->uptime_s = esp_timer_get_time() / 1000000;
+	header->first_sequence = count > 0 ? records[0].sequence : sequence;
+	for(i = 0; i < count; i++)
+	{
+		// A long run of torn slots does not fit the offset, the rest goes in the next batch
+		if(records[i].sequence - header->first_sequence > UINT8_MAX)
+		{
+			sequence = records[i].sequence;
+			break;
+		}
+		data[i].offset = records[i].sequence - header->first_sequence;
+		data[i].boot = records[i].boot;
+		data[i].zone = records[i].zone;
+		data[i].property_id = records[i].property_id;
+		data[i].time_s = records[i].time_s;
+		data[i].value = records[i].value;
+	}
+	header->count = i;
+
+	if(i > 0)
+	{
+		err = esp_ble_mesh_server_model_send_msg(backfill_model, &ctx, BACKFILL_OP_DATA,
+				sizeof(*header) + i * sizeof(*data), message);
+		if(err != ESP_OK)
+		{
+			// Retried at the next replay interval
+			ESP_LOGW(TAG, "Data from %u not sent (err %d)", header->first_sequence, err);
+			return true;
+		}
+	}
+
+	// A new request may have replaced the replay while the batch was read
+	taskENTER_CRITICAL(&backfill_lock);
+	if(replay_next == start)
+		replay_next = sequence;
+	taskEXIT_CRITICAL(&backfill_lock);
+
+	if(sequence >= end)
+		ESP_LOGI(TAG, "Replay to 0x%04x done at %u", ctx.addr, sequence);
+	return sequence < end;
+}
+
+static void backfill_task(void *arg)
+{
+	TickType_t status_ticks = pdMS_TO_TICKS(backfill_config.status_period_ms);
+	TickType_t replay_ticks = pdMS_TO_TICKS(backfill_config.replay_interval_ms);
+	TickType_t next_status = xTaskGetTickCount() + status_ticks;
+	TickType_t next_batch = xTaskGetTickCount();
+	TickType_t now, wait;
+	_Bool replaying = false;
+
+	while(1)
+	{
+		now = xTaskGetTickCount();
+		if((int32_t)(now - next_status) >= 0)
+		{
+			backfill_publish_status();
+			next_status = now + status_ticks;
+		}
+		if((int32_t)(now - next_batch) >= 0)
+		{
+			replaying = backfill_send_batch();
+			next_batch = now + replay_ticks;
+		}
+
+		wait = next_status - now;
+		if(replaying && next_batch - now < wait)
+			wait = next_batch - now;
+
+		// A new replay request ends the wait, its first batch still keeps to the replay interval
+		if(xTaskNotifyWait(0, UINT32_MAX, NULL, wait) == pdTRUE)
+			replaying = true;
+	}
+}
+
+static void backfill_request(const esp_ble_mesh_msg_ctx_t *ctx, uint32_t first, uint32_t end)
+/* Replays [first, end) to the sender of ctx, a running replay is extended or replaced */
+{
+	taskENTER_CRITICAL(&backfill_lock);
+	if(replay_next >= replay_end || first < replay_next || first > replay_end)
+		replay_next = first;
+	replay_end = end;
+	gateway = *ctx;
+	gateway.send_ttl = ESP_BLE_MESH_TTL_DEFAULT;
+	gateway.send_rel = false;
+	taskEXIT_CRITICAL(&backfill_lock);
+
+	ESP_LOGI(TAG, "Replay %u to %u to 0x%04x", first, end, ctx->addr);
+	xTaskNotify(backfill_task_handle, 1, eSetBits);
+}
+
+void backfill_receive(esp_ble_mesh_model_t *model, esp_ble_mesh_msg_ctx_t *ctx, uint32_t opcode, const uint8_t *data, uint16_t length)
+/* Handles the messages of the gateway, called from the mesh callback */
+{
+	uint32_t next, first;
+	uint16_t count;
+	_Bool outage;
+
+	if(model != backfill_model || backfill_task_handle == NULL)
+		return;
+
+	switch(opcode)
+	{
+	case BACKFILL_OP_ACK:
+		if(length < BACKFILL_ACK_LEN)
+			return;
+		memcpy(&next, data, sizeof(next));
+
+		taskENTER_CRITICAL(&backfill_lock);
+		first = acked;
+		outage = unanswered > 1 && next > acked;
+		acked = next;
+		unanswered = 0;
+		taskEXIT_CRITICAL(&backfill_lock);
+
+		if(outage)
+			backfill_request(ctx, first, next);
+		break;
+	case BACKFILL_OP_GET:
+		if(length < BACKFILL_GET_LEN)
+			return;
+		memcpy(&first, data, sizeof(first));
+		memcpy(&count, data + sizeof(first), sizeof(count));
+		backfill_request(ctx, first, first + count);
+		break;
+	default:
+		break;
+	}
+}
+
+esp_err_t backfill_start(esp_ble_mesh_model_t *model, const backfill_config_t *config)
+/* Starts the Status publication and the replay task, the sample log has to be initialised first.
+ * Samples logged before this boot are only sent on a Get */
+{
+	uint32_t first;
+
+	if(backfill_task_handle != NULL)
+		return ESP_ERR_INVALID_STATE;
+	if(config->batch_size == 0 || config->batch_size > BACKFILL_MAX_BATCH || config->status_period_ms == 0)
+		return ESP_ERR_INVALID_ARG;
+
+	backfill_model = model;
+	backfill_config = *config;
+	sample_log_range(&first, &acked);
+	replay_next = acked;
+	replay_end = acked;
+
+	if(xTaskCreate(backfill_task, "backfill", BACKFILL_TASK_STACK_SIZE, NULL, BACKFILL_TASK_PRIORITY, &backfill_task_handle) != pdPASS)
+		return ESP_ERR_NO_MEM;
+
+	return ESP_OK;
+}
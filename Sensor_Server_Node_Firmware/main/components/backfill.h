@@ -0,0 +1,65 @@
+/*
+ * backfill.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_BACKFILL_H_
+#define MAIN_COMPONENTS_BACKFILL_H_
+
+#include "freertos/FreeRTOS.h"
+#include "esp_ble_mesh_defs.h"
+
+#define BACKFILL_TASK_STACK_SIZE	3072
+#define BACKFILL_TASK_PRIORITY		3		// below the acquisition and the scheduler, a replay may wait
+#define BACKFILL_MAX_BATCH			24		// largest batch that fits a 384 octet segmented message
+
+#define BACKFILL_CID				0x02E5	// Espressif
+#define BACKFILL_MODEL_ID_SERVER	0x0010
+#define BACKFILL_MODEL_ID_CLIENT	0x0011
+
+/* Vendor messages of the backfill models, all fields little endian
+ * Status	node -> all			boot, first and next sequence in the sample log
+ * Ack		gateway -> node		next sequence of the Status it answers (4)
+ * Get		gateway -> node		first sequence (4), number of records (2)
+ * Data		node -> gateway		backfill_data_header_t followed by count backfill_data_record_t */
+#define BACKFILL_OP_STATUS			ESP_BLE_MESH_MODEL_OP_3(0x01, BACKFILL_CID)
+#define BACKFILL_OP_ACK				ESP_BLE_MESH_MODEL_OP_3(0x02, BACKFILL_CID)
+#define BACKFILL_OP_GET				ESP_BLE_MESH_MODEL_OP_3(0x03, BACKFILL_CID)
+#define BACKFILL_OP_DATA			ESP_BLE_MESH_MODEL_OP_3(0x04, BACKFILL_CID)
+
+#define BACKFILL_ACK_LEN			4
+#define BACKFILL_GET_LEN			6
+
+typedef struct{
+	uint8_t boot;
+	uint32_t first_sequence;
+	uint32_t next_sequence;
+}__attribute__((packed)) backfill_status_t;
+
+typedef struct{
+	uint8_t boot;				// boot count of the node when the message was sent
+	uint32_t uptime_s;			// uptime of the node when the message was sent
+	uint32_t first_sequence;	// records carry their sequence as an offset to this one
+	uint8_t count;
+}__attribute__((packed)) backfill_data_header_t;
+
+typedef struct{
+	uint8_t offset;				// sequence - first_sequence
+	uint8_t boot;				// boot count when the sample was logged
+	uint8_t zone;				// element of the sensor relative to the primary element
+	uint16_t property_id;
+	uint32_t time_s;			// uptime of the node when the sample was logged
+	int32_t value;
+}__attribute__((packed)) backfill_data_record_t;
+
+typedef struct{
+	uint32_t status_period_ms;		// interval of the Status the gateway acknowledges
+	uint8_t batch_size;				// records per Data message
+	uint32_t replay_interval_ms;	// pause between two Data messages of a replay
+}backfill_config_t;
+
+esp_err_t backfill_start(esp_ble_mesh_model_t *model, const backfill_config_t *config);
+void backfill_receive(esp_ble_mesh_model_t *model, esp_ble_mesh_msg_ctx_t *ctx, uint32_t opcode, const uint8_t *data, uint16_t length);
+
+#endif /* MAIN_COMPONENTS_BACKFILL_H_ */
@@ -0,0 +1,254 @@
+/*
+ * cadence.c
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#include <string.h>
+#include "cadence.h"
+
+/* pdMS_TO_TICKS overflows for the largest minimum interval (2^26 ms) */
+#define CADENCE_MS_TO_TICKS(ms)		((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+static int32_t cadence_decode(const uint8_t *data, uint8_t length, _Bool is_signed)
+/* Little endian raw value of 0 to 4 octets to an integer, an empty value is 0 */
+{
+	uint32_t value = 0;
+	int i;
+
+	for(i = length - 1; i >= 0; i--)
+		value = (value << 8) | data[i];
+
+	if(is_signed && length > 0 && length < 4 && (value & (1UL << (length * 8 - 1))))
+		value |= ~0UL << (length * 8);
+
+	return (int32_t)value;
+}
+
+static uint8_t cadence_value_len(const cadence_tracker_t *tracker)
+{
+	/* The length of sensor data is zero-based */
+	return tracker->state->sensor_data.length + 1;
+}
+
+static uint8_t cadence_delta_len(const cadence_tracker_t *tracker)
+{
+	/* Percentage triggers are a uint16 in 0.01 %, value triggers have the format of the property */
+	if(tracker->state->cadence->trigger_type == ESP_BLE_MESH_SENSOR_STATUS_TRIGGER_TYPE_UINT16)
+		return 2;
+	return cadence_value_len(tracker);
+}
+
+static int32_t cadence_buf_value(const cadence_tracker_t *tracker, const struct net_buf_simple *buf)
+{
+	if(buf->len == 0)
+		return 0;
+	return cadence_decode(buf->data, buf->len, tracker->is_signed);
+}
+
+static int32_t cadence_present_value(const cadence_tracker_t *tracker)
+{
+	return cadence_buf_value(tracker, tracker->state->sensor_data.raw_value);
+}
+
+void cadence_init(cadence_tracker_t *tracker, esp_ble_mesh_sensor_state_t *state, _Bool is_signed)
+/* Defaults: no fast cadence, change triggers disabled, no minimum interval */
+{
+	memset(tracker, 0, sizeof(cadence_tracker_t));
+	tracker->state = state;
+	tracker->is_signed = is_signed;
+
+	state->cadence->period_divisor = 0;
+	state->cadence->trigger_type = ESP_BLE_MESH_SENSOR_STATUS_TRIGGER_TYPE_CHAR;
+	state->cadence->min_interval = 0;
+	net_buf_simple_reset(state->cadence->trigger_delta_down);
+	net_buf_simple_reset(state->cadence->trigger_delta_up);
+	net_buf_simple_reset(state->cadence->fast_cadence_low);
+	net_buf_simple_reset(state->cadence->fast_cadence_high);
+}
+
+esp_err_t cadence_set(cadence_tracker_t *tracker, const uint8_t *data, uint16_t length)
+/* Applies the Sensor Cadence field of a Cadence Set message (Property ID already removed).
+ * Mesh Model Spec: a message with prohibited values shall be ignored, the state is left untouched then */
+{
+	esp_ble_mesh_sensor_cadence_t *cadence = tracker->state->cadence;
+	uint8_t value_len = cadence_value_len(tracker);
+	uint8_t divisor, trigger_type, delta_len, min_interval;
+
+	if(length < 1)
+		return ESP_ERR_INVALID_SIZE;
+
+	divisor = data[0] & 0x7F;
+	trigger_type = data[0] >> 7;
+	delta_len = trigger_type == ESP_BLE_MESH_SENSOR_STATUS_TRIGGER_TYPE_UINT16 ? 2 : value_len;
+
+	if(length != 1 + 2 * delta_len + 1 + 2 * value_len)
+		return ESP_ERR_INVALID_SIZE;
+	if(divisor > ESP_BLE_MESH_SENSOR_PERIOD_DIVISOR_MAX_VALUE)
+		return ESP_ERR_INVALID_ARG;
+	min_interval = data[1 + 2 * delta_len];
+	if(min_interval > ESP_BLE_MESH_SENSOR_STATUS_MIN_INTERVAL_MAX)
+		return ESP_ERR_INVALID_ARG;
+	if(cadence->trigger_delta_down->size < delta_len || cadence->fast_cadence_low->size < value_len)
+		return ESP_ERR_INVALID_SIZE;
+
+	data++;
+	cadence->period_divisor = divisor;
+	cadence->trigger_type = trigger_type;
+	net_buf_simple_reset(cadence->trigger_delta_down);
+	net_buf_simple_add_mem(cadence->trigger_delta_down, data, delta_len);
+	data += delta_len;
+	net_buf_simple_reset(cadence->trigger_delta_up);
+	net_buf_simple_add_mem(cadence->trigger_delta_up, data, delta_len);
+	data += delta_len;
+	cadence->min_interval = min_interval;
+	data++;
+	net_buf_simple_reset(cadence->fast_cadence_low);
+	net_buf_simple_add_mem(cadence->fast_cadence_low, data, value_len);
+	data += value_len;
+	net_buf_simple_reset(cadence->fast_cadence_high);
+	net_buf_simple_add_mem(cadence->fast_cadence_high, data, value_len);
+
+	return ESP_OK;
+}
+
+uint16_t cadence_get(const cadence_tracker_t *tracker, uint8_t *data)
+/* Marshals the Sensor Cadence Status (Property ID followed by the Sensor Cadence state), returns its length */
+{
+	const esp_ble_mesh_sensor_cadence_t *cadence = tracker->state->cadence;
+	uint8_t value_len = cadence_value_len(tracker);
+	uint8_t delta_len = cadence_delta_len(tracker);
+	uint16_t length = 0;
+
+	memcpy(data, &tracker->state->sensor_property_id, ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN);
+	length += ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN;
+	data[length++] = (cadence->trigger_type << 7) | cadence->period_divisor;
+
+	/* Unset buffers are sent as zero */
+	memset(data + length, 0, 2 * delta_len + 1 + 2 * value_len);
+	memcpy(data + length, cadence->trigger_delta_down->data, cadence->trigger_delta_down->len);
+	length += delta_len;
+	memcpy(data + length, cadence->trigger_delta_up->data, cadence->trigger_delta_up->len);
+	length += delta_len;
+	data[length++] = cadence->min_interval;
+	memcpy(data + length, cadence->fast_cadence_low->data, cadence->fast_cadence_low->len);
+	length += value_len;
+	memcpy(data + length, cadence->fast_cadence_high->data, cadence->fast_cadence_high->len);
+	length += value_len;
+
+	return length;
+}
+
+static _Bool cadence_in_fast_range(const cadence_tracker_t *tracker, int32_t value)
+/* Mesh Model Spec: fast cadence applies inside [low, high], or outside [high, low] when low is larger than high */
+{
+	const esp_ble_mesh_sensor_cadence_t *cadence = tracker->state->cadence;
+	int32_t low = cadence_buf_value(tracker, cadence->fast_cadence_low);
+	int32_t high = cadence_buf_value(tracker, cadence->fast_cadence_high);
+
+	if(cadence->period_divisor == 0)
+		return false;
+	if(low <= high)
+		return value >= low && value <= high;
+	return value >= low || value <= high;
+}
+
+static _Bool cadence_triggered(const cadence_tracker_t *tracker, int32_t value)
+/* Checks the status trigger deltas against the last published value, a delta of 0 disables that trigger */
+{
+	const esp_ble_mesh_sensor_cadence_t *cadence = tracker->state->cadence;
+	int32_t delta_down, delta_up;
+	int32_t change = value - tracker->published_value;
+
+	/* Deltas are magnitudes, never negative */
+	delta_down = cadence_decode(cadence->trigger_delta_down->data, cadence->trigger_delta_down->len, false);
+	delta_up = cadence_decode(cadence->trigger_delta_up->data, cadence->trigger_delta_up->len, false);
+
+	if(cadence->trigger_type == ESP_BLE_MESH_SENSOR_STATUS_TRIGGER_TYPE_UINT16)
+	{
+		/* Percentage of the last published value in 0.01 % */
+		int32_t reference = tracker->published_value < 0 ? -tracker->published_value : tracker->published_value;
+		delta_down = ((int64_t)reference * delta_down) / 10000;
+		delta_up = ((int64_t)reference * delta_up) / 10000;
+	}
+
+	if(delta_up > 0 && change >= delta_up)
+		return true;
+	if(delta_down > 0 && -change >= delta_down)
+		return true;
+	return false;
+}
+
+_Bool cadence_publish_due(const cadence_tracker_t *tracker, uint32_t base_period_ms, TickType_t now, TickType_t *ticks_to_due)
+/* Returns true when the state has to be published now, otherwise ticks_to_due is set to the time left
+ * until the (fast) cadence period expires. Triggers are only honoured after the minimum interval */
+{
+	const esp_ble_mesh_sensor_cadence_t *cadence = tracker->state->cadence;
+	int32_t value = cadence_present_value(tracker);
+	uint32_t period_ms = base_period_ms;
+	TickType_t elapsed = now - tracker->published_at;
+	TickType_t period_ticks, min_interval_ticks;
+
+	if(!tracker->published)
+		return true;
+
+	if(cadence_in_fast_range(tracker, value))
+		period_ms >>= cadence->period_divisor;
+
+	period_ticks = CADENCE_MS_TO_TICKS(period_ms);
+	min_interval_ticks = CADENCE_MS_TO_TICKS(1UL << cadence->min_interval);
+	if(period_ticks < min_interval_ticks)
+		period_ticks = min_interval_ticks;
+	if(period_ticks == 0)
+		period_ticks = 1;
+
+	if(elapsed >= period_ticks)
+		return true;
+	if(elapsed >= min_interval_ticks && cadence_triggered(tracker, value))
+		return true;
+
+	*ticks_to_due = period_ticks - elapsed;
+	return false;
+}
+
+uint8_t cadence_period_divisor(const cadence_tracker_t *tracker, uint32_t base_period_ms)
+/* Fast Cadence Period Divisor for the present value, 0 outside the fast cadence range. The divisor is
+ * lowered until the fast period is no shorter than the minimum interval */
+{
+	const esp_ble_mesh_sensor_cadence_t *cadence = tracker->state->cadence;
+	uint8_t divisor;
+
+	if(!cadence_in_fast_range(tracker, cadence_present_value(tracker)))
+		return 0;
+
+	divisor = cadence->period_divisor;
+	while(divisor > 0 && (base_period_ms >> divisor) < (1UL << cadence->min_interval))
+		divisor--;
+	return divisor;
+}
+
+_Bool cadence_trigger_due(const cadence_tracker_t *tracker, TickType_t now, TickType_t *ticks_to_due)
+/* Returns true when a status trigger delta is exceeded and the minimum interval has passed, for publications
+ * between the periodic ones. A trigger held back by the minimum interval sets ticks_to_due to the time left */
+{
+	const esp_ble_mesh_sensor_cadence_t *cadence = tracker->state->cadence;
+	TickType_t elapsed = now - tracker->published_at;
+	TickType_t min_interval_ticks = CADENCE_MS_TO_TICKS(1UL << cadence->min_interval);
+
+	/* Deltas are relative to the last publication */
+	if(!tracker->published || !cadence_triggered(tracker, cadence_present_value(tracker)))
+		return false;
+
+	if(elapsed >= min_interval_ticks)
+		return true;
+	*ticks_to_due = min_interval_ticks - elapsed;
+	return false;
+}
+
+void cadence_published(cadence_tracker_t *tracker, int32_t value, TickType_t now)
+/* Remembers the raw value and time of a publication of the state */
+{
+	tracker->published = true;
+	tracker->published_value = value;
+	tracker->published_at = now;
+}
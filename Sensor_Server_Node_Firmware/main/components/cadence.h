@@ -0,0 +1,33 @@
+/*
+ * cadence.h
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_CADENCE_H_
+#define MAIN_COMPONENTS_CADENCE_H_
+
+#include "freertos/FreeRTOS.h"
+#include "esp_ble_mesh_sensor_model_api.h"
+
+/* Largest Sensor Cadence state: divisor and trigger type, 2 deltas, min interval, fast cadence low and high */
+#define CADENCE_MAX_LEN(value_len)	(1 + 2 * ((value_len) > 2 ? (value_len) : 2) + 1 + 2 * (value_len))
+
+// Publish bookkeeping of one sensor state for its Sensor Cadence state
+typedef struct{
+	esp_ble_mesh_sensor_state_t *state;
+	_Bool is_signed;			// raw value is a signed integer
+	_Bool published;			// at least one publication was made
+	int32_t published_value;	// value in the last publication
+	TickType_t published_at;	// tick count of the last publication
+}cadence_tracker_t;
+
+void cadence_init(cadence_tracker_t *tracker, esp_ble_mesh_sensor_state_t *state, _Bool is_signed);
+esp_err_t cadence_set(cadence_tracker_t *tracker, const uint8_t *data, uint16_t length);
+uint16_t cadence_get(const cadence_tracker_t *tracker, uint8_t *data);
+_Bool cadence_publish_due(const cadence_tracker_t *tracker, uint32_t base_period_ms, TickType_t now, TickType_t *ticks_to_due);
+uint8_t cadence_period_divisor(const cadence_tracker_t *tracker, uint32_t base_period_ms);
+_Bool cadence_trigger_due(const cadence_tracker_t *tracker, TickType_t now, TickType_t *ticks_to_due);
+void cadence_published(cadence_tracker_t *tracker, int32_t value, TickType_t now);
+
+#endif /* MAIN_COMPONENTS_CADENCE_H_ */
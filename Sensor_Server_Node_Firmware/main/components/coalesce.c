@@ -0,0 +1,193 @@
+/*
+ * coalesce.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "coalesce.h"
+
+#define TAG "COALESCE"
+
+/* A dashboard or several clients polling at the same moment send a burst of identical Gets. The first Get of
+ * a key is answered right away and opens a window, the Gets that follow within it are only recorded and are
+ * answered once when it closes, from a single snapshot of the value. A lone Get never waits for the window.
+ * A requester that asks twice within a window gets one answer */
+
+// Gets of one key waiting for their window to close
+typedef struct{
+	_Bool open;
+	esp_ble_mesh_model_t *model;
+	uint32_t key;
+	uint32_t gets;				// Gets after the first one
+	uint8_t requester_count;	// the first requester, already answered, and the ones still waiting
+	esp_ble_mesh_msg_ctx_t requesters[COALESCE_MAX_REQUESTERS];
+	esp_timer_handle_t timer;
+}coalesce_window_t;
+
+static coalesce_window_t windows[COALESCE_MAX_WINDOWS];
+static coalesce_stats_t stats;
+static portMUX_TYPE coalesce_lock = portMUX_INITIALIZER_UNLOCKED;
+static coalesce_answer_t answer_cb = NULL;
+static uint64_t window_us;
+static esp_timer_handle_t stats_timer = NULL;
+
+static void coalesce_close(void *arg)
+/* Runs on the esp_timer task, the window is copied out so new Gets can open it again while it is answered */
+{
+	coalesce_window_t *window = arg;
+	esp_ble_mesh_msg_ctx_t requesters[COALESCE_MAX_REQUESTERS];
+	esp_ble_mesh_model_t *model;
+	uint32_t key, gets;
+	uint8_t count, sent;
+
+	taskENTER_CRITICAL(&coalesce_lock);
+	model = window->model;
+	key = window->key;
+	gets = window->gets;
+	count = window->requester_count;
+	memcpy(requesters, window->requesters, count * sizeof(esp_ble_mesh_msg_ctx_t));
+	window->open = false;
+	taskEXIT_CRITICAL(&coalesce_lock);
+
+	sent = count > 1 ? answer_cb(model, key, requesters + 1, count - 1) : 0;
+
+	taskENTER_CRITICAL(&coalesce_lock);
+	stats.sent += sent;
+	stats.coalesced += gets > sent ? gets - sent : 0;
+	stats.windows++;
+	taskEXIT_CRITICAL(&coalesce_lock);
+}
+
+static void coalesce_log_stats(void *arg)
+{
+	coalesce_stats_t now;
+
+	coalesce_get_stats(&now);
+	ESP_LOGI(TAG, "Gets %u sent %u coalesced %u windows %u overflows %u",
+			now.gets, now.sent, now.coalesced, now.windows, now.overflows);
+}
+
+esp_err_t coalesce_init(uint32_t window_ms, uint32_t stats_period_ms, coalesce_answer_t answer)
+/* A window of 0 ms answers every Get right away, the counters are logged every stats_period_ms when it is not 0 */
+{
+	esp_timer_create_args_t timer_args = {
+		.callback = coalesce_close,
+		.dispatch_method = ESP_TIMER_TASK,
+		.name = "coalesce",
+	};
+	esp_err_t err;
+	uint8_t i;
+
+	if(answer == NULL)
+		return ESP_ERR_INVALID_ARG;
+	if(answer_cb != NULL)
+		return ESP_ERR_INVALID_STATE;
+
+	for(i = 0; i < COALESCE_MAX_WINDOWS && window_ms > 0; i++)
+	{
+		timer_args.arg = &windows[i];
+		err = esp_timer_create(&timer_args, &windows[i].timer);
+		if(err != ESP_OK)
+			return err;
+	}
+	window_us = (uint64_t)window_ms * 1000;
+	answer_cb = answer;
+
+	if(stats_period_ms == 0)
+		return ESP_OK;
+
+	timer_args.callback = coalesce_log_stats;
+	timer_args.arg = NULL;
+	timer_args.name = "coalesce_stats";
+	err = esp_timer_create(&timer_args, &stats_timer);
+	if(err != ESP_OK)
+		return err;
+	return esp_timer_start_periodic(stats_timer, (uint64_t)stats_period_ms * 1000);
+}
+
+static _Bool coalesce_same_requester(const esp_ble_mesh_msg_ctx_t *a, const esp_ble_mesh_msg_ctx_t *b)
+{
+	return a->addr == b->addr && a->net_idx == b->net_idx && a->app_idx == b->app_idx;
+}
+
+_Bool coalesce_get(esp_ble_mesh_model_t *model, uint32_t key, const esp_ble_mesh_msg_ctx_t *ctx)
+/* Records a Get of key received by model, returns false when it is not coalesced and has to be answered right away */
+{
+	coalesce_window_t *window = NULL, *free_window = NULL;
+	_Bool opened = false, coalesced = true;
+	uint8_t i;
+
+	taskENTER_CRITICAL(&coalesce_lock);
+	stats.gets++;
+
+	for(i = 0; i < COALESCE_MAX_WINDOWS && window_us > 0; i++)
+	{
+		if(windows[i].open && windows[i].model == model && windows[i].key == key)
+			window = &windows[i];
+		else if(!windows[i].open && free_window == NULL)
+			free_window = &windows[i];
+	}
+
+	if(window == NULL && free_window != NULL)
+	{
+		window = free_window;
+		window->open = true;
+		window->model = model;
+		window->key = key;
+		window->gets = 0;
+		window->requester_count = 0;
+		opened = true;
+	}
+
+	if(window == NULL)
+		coalesced = false;
+	else if(opened)
+	{
+		window->requesters[window->requester_count++] = *ctx;
+		coalesced = false;
+	}
+	else
+	{
+		for(i = 0; i < window->requester_count; i++)
+		{
+			if(coalesce_same_requester(&window->requesters[i], ctx))
+				break;
+		}
+		if(i == window->requester_count && i == COALESCE_MAX_REQUESTERS)
+			coalesced = false;
+		else
+		{
+			if(i == window->requester_count)
+				window->requesters[window->requester_count++] = *ctx;
+			window->gets++;
+		}
+	}
+
+	if(!coalesced)
+	{
+		stats.sent++;
+		if(window_us > 0 && !opened)
+			stats.overflows++;
+	}
+	taskEXIT_CRITICAL(&coalesce_lock);
+
+	if(opened && esp_timer_start_once(window->timer, window_us) != ESP_OK)
+	{
+		/* Without its timer the window would never close, it is closed now and a Get that joined it is answered */
+		taskENTER_CRITICAL(&coalesce_lock);
+		stats.overflows++;
+		taskEXIT_CRITICAL(&coalesce_lock);
+		coalesce_close(window);
+	}
+	return coalesced;
+}
+
+void coalesce_get_stats(coalesce_stats_t *now)
+{
+	taskENTER_CRITICAL(&coalesce_lock);
+	*now = stats;
+	taskEXIT_CRITICAL(&coalesce_lock);
+}
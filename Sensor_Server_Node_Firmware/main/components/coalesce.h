@@ -0,0 +1,34 @@
+/*
+ * coalesce.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_COALESCE_H_
+#define MAIN_COMPONENTS_COALESCE_H_
+
+#include "freertos/FreeRTOS.h"
+#include "esp_ble_mesh_defs.h"
+
+#define COALESCE_MAX_WINDOWS		8		// Gets of different keys waiting at the same time
+#define COALESCE_MAX_REQUESTERS		8		// distinct requesters answered by one window
+
+// Answers the Gets of one window that followed its first Get, requesters holds the context of the first Get of
+// every distinct requester that was not answered yet. Returns the number of messages sent
+typedef uint8_t (*coalesce_answer_t)(esp_ble_mesh_model_t *model, uint32_t key,
+		const esp_ble_mesh_msg_ctx_t *requesters, uint8_t count);
+
+// Counters since boot, every Get is either sent an answer of its own or coalesced into another one
+typedef struct{
+	uint32_t gets;			// Gets received
+	uint32_t sent;			// messages sent in answer
+	uint32_t coalesced;		// Gets answered by a message sent for another Get
+	uint32_t windows;		// windows closed
+	uint32_t overflows;		// Gets answered right away because no window or requester slot was free
+}coalesce_stats_t;
+
+esp_err_t coalesce_init(uint32_t window_ms, uint32_t stats_period_ms, coalesce_answer_t answer);
+_Bool coalesce_get(esp_ble_mesh_model_t *model, uint32_t key, const esp_ble_mesh_msg_ctx_t *ctx);
+void coalesce_get_stats(coalesce_stats_t *stats);
+
+#endif /* MAIN_COMPONENTS_COALESCE_H_ */
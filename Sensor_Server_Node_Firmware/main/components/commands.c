@@ -6,16 +6,18 @@
  */
 
 #include "commands.h"
+#include "i2c_bus.h"
 
-esp_err_t i2c_master_init(void)
-/* Initialization function of the I2C protocol on the master side (ESP32) */
+esp_err_t i2c_master_init(i2c_port_t port, int sda_io_num, int scl_io_num)
+/* Initialization function of the I2C protocol on the master side (ESP32), called once for every bus */
 {
-	int i2c_master_port = I2C_MASTER_NUM;
+	int i2c_master_port = port;
+	esp_err_t err;
 
 	i2c_config_t conf = {
 		.mode = I2C_MODE_MASTER,
-		.sda_io_num = I2C_MASTER_SDA_IO,
-		.scl_io_num = I2C_MASTER_SCL_IO,
+		.sda_io_num = sda_io_num,
+		.scl_io_num = scl_io_num,
 		.sda_pullup_en = GPIO_PULLUP_ENABLE,
 		.scl_pullup_en = GPIO_PULLUP_ENABLE,
 		.master.clk_speed = I2C_MASTER_FREQ_HZ,
@@ -23,10 +25,15 @@ esp_err_t i2c_master_init(void)
 
 	i2c_param_config(i2c_master_port, &conf);
 
-	return i2c_driver_install(i2c_master_port, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
+	err = i2c_driver_install(i2c_master_port, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
+	if(err != ESP_OK)
+		return err;
+
+	/* From here on the port is only accessed through its bus-owner task */
+	return i2c_bus_start(i2c_master_port);
 }
 
-esp_err_t SHT35_single_measurement(int16_t *temp_ptr, uint16_t *hum_ptr)
+esp_err_t SHT35_single_measurement(const SHT35_t *dev, int16_t *temp_ptr, uint16_t *hum_ptr)
 /* Function to do a single measurement using single shot mode,
  * the raw data is processed to integers ready for wireless transfer */
 {
@@ -34,7 +41,7 @@ esp_err_t SHT35_single_measurement(int16_t *temp_ptr, uint16_t *hum_ptr)
 	size_t raw_data_len=sizeof(raw_data);
 	uint8_t *raw_data_ptr = raw_data;
 
-	esp_err_t err = SHT35_single_shot_data_acquisition(raw_data_ptr, raw_data_len, false, HIGH_REPEATABILITY);
+	esp_err_t err = SHT35_single_shot_data_acquisition(dev, raw_data_ptr, raw_data_len, false);
 
 	if(err != ESP_OK)
 		return err;
@@ -44,44 +51,61 @@ esp_err_t SHT35_single_measurement(int16_t *temp_ptr, uint16_t *hum_ptr)
 	return err;
 }
 
-static int8_t SHT35_calculate_crc(uint8_t data[], uint8_t number_of_bytes)
+/* CRC-8 lookup table for the polynomial 0x31 (x^8 + x^5 + x^4 + 1), entry i is the bitwise CRC of the single byte i
+ * starting from 0. Generated offline from the bit-by-bit routine, kept const so it lives in flash */
+static const uint8_t SHT35_crc_table[256] = {
+	0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
+	0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4, 0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
+	0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11, 0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
+	0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
+	0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA, 0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
+	0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9, 0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
+	0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C, 0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
+	0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F, 0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
+	0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED, 0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
+	0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE, 0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
+	0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B, 0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
+	0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
+	0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0, 0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
+	0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93, 0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
+	0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
+	0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15, 0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC
+};
+
+static uint8_t SHT35_calculate_crc(const uint8_t data[], uint8_t number_of_bytes)
+/* Calculates the 8-bit checksum (initialization 0xFF) one byte per table lookup */
 {
-	uint8_t bit;		// bit mask
 	uint8_t crc = 0xFF;	// calculated checksum
 	uint8_t byte_ctr;	// byte counter
 
-	// calculates 8-Bit checksum with given polynomial
 	for(byte_ctr = 0; byte_ctr < number_of_bytes; byte_ctr++)
-	{
-		crc ^= (data[byte_ctr]);
-		for(bit = 8; bit > 0; --bit)
-		{
-			if(crc & 0x80)
-				crc = (crc << 1) ^ POLYNOMIAL;
-			else
-				crc = (crc << 1);
-		}
-	}
+		crc = SHT35_crc_table[crc ^ data[byte_ctr]];
 
 	return crc;
 }
 
-static esp_err_t SHT35_check_crc(uint8_t data[], uint8_t number_of_bytes, uint8_t checksum)
+static esp_err_t SHT35_check_crc(const uint8_t data[], uint8_t number_of_bytes, uint8_t checksum)
 {
-	uint8_t crc;     // calculated checksum
-
-	// calculates 8-Bit checksum
-	crc = SHT35_calculate_crc(data, number_of_bytes);
-
 	// verify checksum
-	if(crc != checksum)
+	if(SHT35_calculate_crc(data, number_of_bytes) != checksum)
 		return ESP_ERR_INVALID_CRC;
 	else
 		return ESP_OK;
 }
 
+esp_err_t SHT35_check_frame(const uint8_t frame[6])
+/* Checks both words of a 6-byte measurement frame (temperature, crc, humidity, crc) in one call */
+{
+	uint8_t crc_temp = SHT35_crc_table[SHT35_crc_table[0xFF ^ frame[0]] ^ frame[1]];
+	uint8_t crc_hum = SHT35_crc_table[SHT35_crc_table[0xFF ^ frame[3]] ^ frame[4]];
+
+	if((crc_temp != frame[2]) | (crc_hum != frame[5]))
+		return ESP_ERR_INVALID_CRC;
+
+	return ESP_OK;
+}
 
-esp_err_t SHT35_read_out_status_register(uint8_t *data, size_t read_size)
+esp_err_t SHT35_read_out_status_register(const SHT35_t *dev, uint8_t *data, size_t read_size)
 /* Function that reads out the status register and puts the data in 2 bytes + a crc byte,
  * read_size should be 3 bytes */
 {
@@ -93,7 +117,7 @@ esp_err_t SHT35_read_out_status_register(uint8_t *data, size_t read_size)
 	if(read_size > 3)
 		return ESP_ERR_INVALID_ARG;
 
-	err = i2c_master_write_read_device(I2C_MASTER_NUM, SHT35_SENSOR_ADDR, buffer_ptr, write_size, data, read_size, I2C_MASTER_TIMEOUT_MS / portTICK_RATE_MS);
+	err = i2c_bus_transfer(dev->port, dev->address, buffer_ptr, write_size, data, read_size);
 
 	if(err != ESP_OK)
 		return err;
@@ -103,7 +127,7 @@ esp_err_t SHT35_read_out_status_register(uint8_t *data, size_t read_size)
 	return err;
 }
 
-esp_err_t SHT35_read_and_print_status_register(void)
+esp_err_t SHT35_read_and_print_status_register(const SHT35_t *dev)
 /* Function that reads out the status register and prints it using the functions
  * SHT35_read_out_status_register and print_status_register */
 {
@@ -111,7 +135,7 @@ esp_err_t SHT35_read_and_print_status_register(void)
 	size_t reg_len=sizeof(reg_data);
 	uint8_t *reg_ptr = reg_data;
 
-	esp_err_t err = SHT35_read_out_status_register(reg_ptr, reg_len);
+	esp_err_t err = SHT35_read_out_status_register(dev, reg_ptr, reg_len);
 	if(err != ESP_OK)
 		return err;
 
@@ -120,69 +144,202 @@ esp_err_t SHT35_read_and_print_status_register(void)
 	return err;
 }
 
-esp_err_t SHT35_single_shot_data_acquisition(uint8_t *data, size_t read_size, _Bool clock_stretching, etRepeatability repeatability)
-/* Function that acquires a single data point using single shot mode, read_size should be 6 bytes */
+esp_err_t SHT35_read_status(const SHT35_t *dev, SHT35_status_t *status)
+/* Reads out the status register and decodes it, used to find out which alert raised the ALERT pin */
 {
-	esp_err_t err = ESP_OK;
+	uint8_t reg_data[3] = {0};
 
-	uint8_t write_buffer[2] = {0};
+	esp_err_t err = SHT35_read_out_status_register(dev, reg_data, sizeof(reg_data));
+	if(err != ESP_OK)
+		return err;
+
+	return decode_status_register(reg_data, sizeof(reg_data), status);
+}
+
+esp_err_t SHT35_write_alert_limit(const SHT35_t *dev, etAlertLimit limit, uint16_t raw_temperature, uint16_t raw_humidity)
+/* Writes one of the four alert limits. The sensor only keeps the 7 MSBs of the humidity and the 9 MSBs of the
+ * temperature, the high limits are rounded up and the low limits down so the window never gets smaller */
+{
+	uint8_t write_buffer[5] = {0x61, 0x00};
 	uint8_t *buffer_ptr = write_buffer;
-	size_t write_size = 2;
+	size_t size = 5;
+	uint16_t limit_word;
 
-	if(read_size != 6)
-		err = ESP_ERR_INVALID_ARG;
+	switch(limit)
+	{
+		case ALERT_HIGH_SET:
+			write_buffer[1] = 0x1D;
+			break;
+		case ALERT_HIGH_CLEAR:
+			write_buffer[1] = 0x16;
+			break;
+		case ALERT_LOW_CLEAR:
+			write_buffer[1] = 0x0B;
+			break;
+		case ALERT_LOW_SET:
+			write_buffer[1] = 0x00;
+			break;
+		default:
+			return ESP_ERR_INVALID_ARG;
+	}
+
+	if(limit == ALERT_HIGH_SET || limit == ALERT_HIGH_CLEAR)
+	{
+		raw_humidity = (raw_humidity > 0xFE00) ? 0xFFFF : raw_humidity + 0x1FF;
+		raw_temperature = (raw_temperature > 0xFF80) ? 0xFFFF : raw_temperature + 0x7F;
+	}
 
+	limit_word = (raw_humidity & 0xFE00) | (raw_temperature >> 7);
+	write_buffer[2] = limit_word >> 8;
+	write_buffer[3] = limit_word & 0xFF;
+	write_buffer[4] = SHT35_calculate_crc(write_buffer + 2, 2);
+
+	return i2c_bus_transfer(dev->port, dev->address, buffer_ptr, size, NULL, 0);
+}
+
+static esp_err_t SHT35_single_shot_command(uint8_t command[2], _Bool clock_stretching, etRepeatability repeatability)
+/* Fills in the 16-bit single shot measurement command for the given clock stretching and repeatability */
+{
 	if(clock_stretching)
 	{
-		write_buffer[0] = 0x2C;
+		command[0] = 0x2C;
 		switch(repeatability)
 		{
 			case HIGH_REPEATABILITY:
-				write_buffer[1] = 0x06;
+				command[1] = 0x06;
 				break;
 			case MEDIUM_REPEATABILITY:
-				write_buffer[1] = 0x0D;
+				command[1] = 0x0D;
 				break;
 			case LOW_REPEATABILITY:
-				write_buffer[1] = 0x10;
+				command[1] = 0x10;
 				break;
 			default:
-				err = ESP_ERR_INVALID_ARG;
+				return ESP_ERR_INVALID_ARG;
 		}
 	}
 	else
 	{
-		write_buffer[0] = 0x24;
+		command[0] = 0x24;
 		switch(repeatability)
 		{
 			case HIGH_REPEATABILITY:
-				write_buffer[1] = 0x00;
+				command[1] = 0x00;
 				break;
 			case MEDIUM_REPEATABILITY:
-				write_buffer[1] = 0x0B;
+				command[1] = 0x0B;
 				break;
 			case LOW_REPEATABILITY:
-				write_buffer[1] = 0x16;
+				command[1] = 0x16;
 				break;
 			default:
-				err = ESP_ERR_INVALID_ARG;
+				return ESP_ERR_INVALID_ARG;
 		}
 	}
 
+	return ESP_OK;
+}
+
+esp_err_t SHT35_single_shot_data_acquisition(const SHT35_t *dev, uint8_t *data, size_t read_size, _Bool clock_stretching)
+/* Function that acquires a single data point using single shot mode, read_size should be 6 bytes */
+{
+	esp_err_t err = ESP_OK;
+
+	uint8_t write_buffer[2] = {0};
+	uint8_t *buffer_ptr = write_buffer;
+	size_t write_size = 2;
+
+	if(read_size != 6)
+		return ESP_ERR_INVALID_ARG;
+
+	if(dev->mode != SHT35_SINGLE_SHOT)
+		return ESP_ERR_INVALID_STATE;
+
+	err = SHT35_single_shot_command(write_buffer, clock_stretching, dev->repeatability);
 	if(err != ESP_OK)
 		return err;
 
-	err = i2c_master_write_read_device(I2C_MASTER_NUM, SHT35_SENSOR_ADDR, buffer_ptr, write_size, data, read_size, I2C_MASTER_TIMEOUT_MS / portTICK_RATE_MS);
+	err = i2c_bus_transfer(dev->port, dev->address, buffer_ptr, write_size, data, read_size);
 
 	if(err == ESP_OK)
-		err = SHT35_check_crc(data, 2, *(data+2));
+		err = SHT35_check_frame(data);
+
+	return err;
+}
+
+esp_err_t SHT35_start_single_shot(const SHT35_t *dev)
+/* Only sends the single shot command without clock stretching, the bus is released while the sensor converts.
+ * The result can be fetched with SHT35_fetch_single_shot after SHT35_conversion_time_ms */
+{
+	uint8_t write_buffer[2] = {0};
+	uint8_t *buffer_ptr = write_buffer;
+	size_t size = 2;
+
+	esp_err_t err;
+
+	/* The sensor ignores single shot commands while it measures periodically */
+	if(dev->mode != SHT35_SINGLE_SHOT)
+		return ESP_ERR_INVALID_STATE;
+
+	err = SHT35_single_shot_command(write_buffer, false, dev->repeatability);
+	if(err != ESP_OK)
+		return err;
+
+	return i2c_bus_transfer(dev->port, dev->address, buffer_ptr, size, NULL, 0);
+}
+
+esp_err_t SHT35_fetch_single_shot(const SHT35_t *dev, uint8_t *data, size_t read_size)
+/* Reads the result of SHT35_start_single_shot, read_size should be 6 bytes.
+ * The sensor NACKs the read (ESP_FAIL) when the conversion is not finished yet */
+{
+	esp_err_t err;
+
+	if(read_size != 6)
+		return ESP_ERR_INVALID_ARG;
+
+	err = i2c_bus_transfer(dev->port, dev->address, NULL, 0, data, read_size);
+
 	if(err == ESP_OK)
-		err = SHT35_check_crc(data+3, 2, *(data+5));
+		err = SHT35_check_frame(data);
 
 	return err;
 }
 
-esp_err_t SHT35_read_measurements_periodic_mode(uint8_t *data, size_t read_size)
+uint32_t SHT35_conversion_time_ms(etRepeatability repeatability)
+/* Maximum measurement duration from the datasheet (15.5, 6.5 and 4.5 ms), rounded up */
+{
+	switch(repeatability)
+	{
+		case MEDIUM_REPEATABILITY:
+			return 7;
+		case LOW_REPEATABILITY:
+			return 5;
+		case HIGH_REPEATABILITY:
+		default:
+			return 16;
+	}
+}
+
+uint32_t SHT35_periodic_interval_ms(etFrequency frequency)
+/* Time between two measurements of the sensor in periodic mode */
+{
+	switch(frequency)
+	{
+		case FREQUENCY_HZ5:
+			return 2000;
+		case FREQUENCY_2HZ:
+			return 500;
+		case FREQUENCY_4HZ:
+			return 250;
+		case FREQUENCY_10HZ:
+			return 100;
+		case FREQUENCY_1HZ:
+		default:
+			return 1000;
+	}
+}
+
+esp_err_t SHT35_read_measurements_periodic_mode(const SHT35_t *dev, uint8_t *data, size_t read_size)
 /* After enabling periodic mode the measurements can be read using this mode, read_size should be 6 bytes */
 {
 	esp_err_t err;
@@ -193,17 +350,15 @@ esp_err_t SHT35_read_measurements_periodic_mode(uint8_t *data, size_t read_size)
 	if(read_size != 6)
 		return ESP_ERR_INVALID_ARG;
 
-	err = i2c_master_write_read_device(I2C_MASTER_NUM, SHT35_SENSOR_ADDR, buffer_ptr, write_size, data, read_size, I2C_MASTER_TIMEOUT_MS / portTICK_RATE_MS);
+	err = i2c_bus_transfer(dev->port, dev->address, buffer_ptr, write_size, data, read_size);
 
 	if(err == ESP_OK)
-		err = SHT35_check_crc(data, 2, *(data+2));
-	if(err == ESP_OK)
-		err = SHT35_check_crc(data+3, 2, *(data+5));
+		err = SHT35_check_frame(data);
 
 	return err;
 }
 
-esp_err_t SHT35_heater(_Bool heater_enabled) // GEBRUIK DIT NIET
+esp_err_t SHT35_heater(const SHT35_t *dev, _Bool heater_enabled) // GEBRUIK DIT NIET
 {
 	uint8_t write_buffer[2] = {0};
 	uint8_t *buffer_ptr = write_buffer;
@@ -215,11 +370,12 @@ esp_err_t SHT35_heater(_Bool heater_enabled) // GEBRUIK DIT NIET
 	else
 		write_buffer[1] = 0x66;
 
-	return i2c_master_write_to_device(I2C_MASTER_NUM, SHT35_SENSOR_ADDR, buffer_ptr, size, I2C_MASTER_TIMEOUT_MS / portTICK_RATE_MS);
+	return i2c_bus_transfer(dev->port, dev->address, buffer_ptr, size, NULL, 0);
 }
 
-esp_err_t SHT35_periodic_data_acquisition(etFrequency frequency, etRepeatability repeatability)
-/* Function that enables periodic data acquisition, the sensor starts measuring frequently */
+esp_err_t SHT35_periodic_data_acquisition(SHT35_t *dev)
+/* Function that enables periodic data acquisition, the sensor starts measuring frequently
+ * at the frequency and repeatability of the handle */
 {
 	esp_err_t err = ESP_OK;
 
@@ -227,11 +383,11 @@ esp_err_t SHT35_periodic_data_acquisition(etFrequency frequency, etRepeatability
 	uint8_t *buffer_ptr = write_buffer;
 	size_t size = 2;
 
-	switch(frequency)
+	switch(dev->frequency)
 	{
 		case FREQUENCY_HZ5:
 			write_buffer[0] = 0x20;
-			switch(repeatability)
+			switch(dev->repeatability)
 			{
 				case HIGH_REPEATABILITY:
 					write_buffer[1] = 0x32;
@@ -249,7 +405,7 @@ esp_err_t SHT35_periodic_data_acquisition(etFrequency frequency, etRepeatability
 
 		case FREQUENCY_1HZ:
 			write_buffer[0] = 0x21;
-			switch(repeatability)
+			switch(dev->repeatability)
 			{
 				case HIGH_REPEATABILITY:
 					write_buffer[1] = 0x30;
@@ -267,7 +423,7 @@ esp_err_t SHT35_periodic_data_acquisition(etFrequency frequency, etRepeatability
 
 		case FREQUENCY_2HZ:
 			write_buffer[0] = 0x22;
-			switch(repeatability)
+			switch(dev->repeatability)
 			{
 				case HIGH_REPEATABILITY:
 					write_buffer[1] = 0x36;
@@ -285,7 +441,7 @@ esp_err_t SHT35_periodic_data_acquisition(etFrequency frequency, etRepeatability
 
 		case FREQUENCY_4HZ:
 			write_buffer[0] = 0x23;
-			switch(repeatability)
+			switch(dev->repeatability)
 			{
 				case HIGH_REPEATABILITY:
 					write_buffer[1] = 0x34;
@@ -303,7 +459,7 @@ esp_err_t SHT35_periodic_data_acquisition(etFrequency frequency, etRepeatability
 
 		case FREQUENCY_10HZ:
 			write_buffer[0] = 0x27;
-			switch(repeatability)
+			switch(dev->repeatability)
 			{
 				case HIGH_REPEATABILITY:
 					write_buffer[1] = 0x37;
@@ -326,7 +482,9 @@ esp_err_t SHT35_periodic_data_acquisition(etFrequency frequency, etRepeatability
 	if(err != ESP_OK)
 		return err;
 
-	err = i2c_master_write_to_device(I2C_MASTER_NUM, SHT35_SENSOR_ADDR, buffer_ptr, size, I2C_MASTER_TIMEOUT_MS / portTICK_RATE_MS);
+	err = i2c_bus_transfer(dev->port, dev->address, buffer_ptr, size, NULL, 0);
+	if(err == ESP_OK)
+		dev->mode = SHT35_PERIODIC;
 
 	return err;
 }
@@ -334,42 +492,57 @@ esp_err_t SHT35_periodic_data_acquisition(etFrequency frequency, etRepeatability
 
 /* Simple single 16-bit commands */
 
-esp_err_t SHT35_soft_reset(void) // WERKT NIET MEER !!!!
+esp_err_t SHT35_soft_reset(SHT35_t *dev) // WERKT NIET MEER !!!!
 {
 	uint8_t write_buffer[2] = {0x30, 0xA2};
 	uint8_t *buffer_ptr = write_buffer;
 	size_t size = 2;
+	esp_err_t err;
 
-	return i2c_master_write_to_device(I2C_MASTER_NUM, SHT35_SENSOR_ADDR, buffer_ptr, size, I2C_MASTER_TIMEOUT_MS / portTICK_RATE_MS);
+	err = i2c_bus_transfer(dev->port, dev->address, buffer_ptr, size, NULL, 0);
+	if(err == ESP_OK)
+		dev->mode = SHT35_SINGLE_SHOT;
+
+	return err;
 }
 
-esp_err_t SHT35_break_command(void)
+esp_err_t SHT35_break_command(SHT35_t *dev)
 /* Stop periodic data acquisition mode */
 {
 	uint8_t write_buffer[2] = {0x30, 0x93};
 	uint8_t *buffer_ptr = write_buffer;
 	size_t size = 2;
+	esp_err_t err;
 
-	return i2c_master_write_to_device(I2C_MASTER_NUM, SHT35_SENSOR_ADDR, buffer_ptr, size, I2C_MASTER_TIMEOUT_MS / portTICK_RATE_MS);
+	err = i2c_bus_transfer(dev->port, dev->address, buffer_ptr, size, NULL, 0);
+	if(err == ESP_OK)
+		dev->mode = SHT35_SINGLE_SHOT;
+
+	return err;
 }
 
-esp_err_t SHT35_ART_command(void)
-/* Enable accelerated response time measurements */
+esp_err_t SHT35_ART_command(SHT35_t *dev)
+/* Enable accelerated response time measurements, the sensor measures periodically at 4 Hz */
 {
 	uint8_t write_buffer[2] = {0x2B, 0x32};
 	uint8_t *buffer_ptr = write_buffer;
 	size_t size = 2;
+	esp_err_t err;
 
-	return i2c_master_write_to_device(I2C_MASTER_NUM, SHT35_SENSOR_ADDR, buffer_ptr, size, I2C_MASTER_TIMEOUT_MS / portTICK_RATE_MS);
+	err = i2c_bus_transfer(dev->port, dev->address, buffer_ptr, size, NULL, 0);
+	if(err == ESP_OK)
+		dev->mode = SHT35_PERIODIC;
+
+	return err;
 }
 
-esp_err_t SHT35_clear_status_register(void)
+esp_err_t SHT35_clear_status_register(const SHT35_t *dev)
 /* Clear the status register */
 {
 	uint8_t write_buffer[2] = {0x30, 0x41};
 	uint8_t *buffer_ptr = write_buffer;
 	size_t size = 2;
 
-	return i2c_master_write_to_device(I2C_MASTER_NUM, SHT35_SENSOR_ADDR, buffer_ptr, size, I2C_MASTER_TIMEOUT_MS / portTICK_RATE_MS);
+	return i2c_bus_transfer(dev->port, dev->address, buffer_ptr, size, NULL, 0);
 }
 
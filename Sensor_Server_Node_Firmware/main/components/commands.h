@@ -20,9 +20,8 @@
 #define I2C_MASTER_RX_BUF_DISABLE	0                          /*!< I2C master doesn't need buffer */
 #define I2C_MASTER_TIMEOUT_MS		1000
 
-#define SHT35_SENSOR_ADDR			0x45
-
-#define POLYNOMIAL					0x31
+#define SHT35_SENSOR_ADDR			0x45					   /*!< ADDR pin high */
+#define SHT35_SENSOR_ADDR_ALT		0x44					   /*!< ADDR pin low */
 
 // Measurement repeatability
 typedef enum{
@@ -40,19 +39,47 @@ typedef enum{
 	FREQUENCY_10HZ,	// 10.0 measurements per seconds
 }etFrequency;
 
-esp_err_t i2c_master_init(void);
-esp_err_t SHT35_single_measurement(int16_t *temp_ptr, uint16_t *hum_ptr);
-static int8_t SHT35_calculate_crc(uint8_t data[], uint8_t number_of_bytes);
-static esp_err_t SHT35_check_crc(uint8_t data[], uint8_t number_of_bytes, uint8_t checksum);
-esp_err_t SHT35_read_out_status_register(uint8_t *data, size_t read_size);
-esp_err_t SHT35_read_and_print_status_register(void);
-esp_err_t SHT35_single_shot_data_acquisition(uint8_t *data, size_t read_size, _Bool clock_stretching, etRepeatability repeatability);
-esp_err_t SHT35_read_measurements_periodic_mode(uint8_t *data, size_t read_size);
-esp_err_t SHT35_heater(_Bool heater_enabled);
-esp_err_t SHT35_periodic_data_acquisition(etFrequency frequency, etRepeatability repeatability);
-esp_err_t SHT35_soft_reset(void);
-esp_err_t SHT35_break_command(void);
-esp_err_t SHT35_ART_command(void);
-esp_err_t SHT35_clear_status_register(void);
+// Alert limits, the ALERT pin rises above HIGH_SET or below LOW_SET and falls back past the CLEAR limits
+typedef enum{
+	ALERT_HIGH_SET,
+	ALERT_HIGH_CLEAR,
+	ALERT_LOW_CLEAR,
+	ALERT_LOW_SET,
+}etAlertLimit;
+
+// Measurement mode the sensor is in, tracked by the driver
+typedef enum{
+	SHT35_SINGLE_SHOT,	// idle, measures on command
+	SHT35_PERIODIC,		// measures on its own until the break command
+}etSHT35Mode;
+
+// One SHT35, up to two sensors (ADDR pin low and high) share a bus
+typedef struct{
+	i2c_port_t port;				// bus the sensor is on, started with i2c_master_init
+	uint8_t address;				// SHT35_SENSOR_ADDR or SHT35_SENSOR_ADDR_ALT
+	etRepeatability repeatability;	// repeatability of every measurement command
+	etFrequency frequency;			// measurement frequency in periodic mode
+	etSHT35Mode mode;				// set by the driver, single shot after power up
+}SHT35_t;
+
+esp_err_t i2c_master_init(i2c_port_t port, int sda_io_num, int scl_io_num);
+esp_err_t SHT35_single_measurement(const SHT35_t *dev, int16_t *temp_ptr, uint16_t *hum_ptr);
+esp_err_t SHT35_check_frame(const uint8_t frame[6]);
+esp_err_t SHT35_read_out_status_register(const SHT35_t *dev, uint8_t *data, size_t read_size);
+esp_err_t SHT35_read_and_print_status_register(const SHT35_t *dev);
+esp_err_t SHT35_read_status(const SHT35_t *dev, SHT35_status_t *status);
+esp_err_t SHT35_write_alert_limit(const SHT35_t *dev, etAlertLimit limit, uint16_t raw_temperature, uint16_t raw_humidity);
+esp_err_t SHT35_single_shot_data_acquisition(const SHT35_t *dev, uint8_t *data, size_t read_size, _Bool clock_stretching);
+esp_err_t SHT35_start_single_shot(const SHT35_t *dev);
+esp_err_t SHT35_fetch_single_shot(const SHT35_t *dev, uint8_t *data, size_t read_size);
+uint32_t SHT35_conversion_time_ms(etRepeatability repeatability);
+uint32_t SHT35_periodic_interval_ms(etFrequency frequency);
+esp_err_t SHT35_read_measurements_periodic_mode(const SHT35_t *dev, uint8_t *data, size_t read_size);
+esp_err_t SHT35_heater(const SHT35_t *dev, _Bool heater_enabled);
+esp_err_t SHT35_periodic_data_acquisition(SHT35_t *dev);
+esp_err_t SHT35_soft_reset(SHT35_t *dev);
+esp_err_t SHT35_break_command(SHT35_t *dev);
+esp_err_t SHT35_ART_command(SHT35_t *dev);
+esp_err_t SHT35_clear_status_register(const SHT35_t *dev);
 
 #endif /* MAIN_COMMANDS_H_ */
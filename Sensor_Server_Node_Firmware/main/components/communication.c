@@ -7,8 +7,41 @@
 
 #include "communication.h"
 
+static inline uint32_t divide_by_65535(uint32_t x)
+/* Exact floor(x / 65535) using a multiply-shift, valid for every x the conversions below produce */
+{
+	return (x + (x >> 16) + 1) >> 16;
+}
+
+int16_t convert_raw_temperature(uint16_t raw)
+/* Convert a raw SHT35 temperature word to 0.01 C, rounded to nearest: -4500 + 17500 * raw / 65535.
+ * 17500 * 65535 + 32767 still fits in 32 bits, so no 64-bit or floating point math is needed */
+{
+	return (int16_t)((int32_t)divide_by_65535(17500u * raw + 32767u) - 4500);
+}
+
+uint16_t convert_raw_humidity(uint16_t raw)
+/* Convert a raw SHT35 humidity word to 0.01 %RH, rounded to nearest: 10000 * raw / 65535 */
+{
+	return (uint16_t)divide_by_65535(10000u * raw + 32767u);
+}
+
 esp_err_t process_raw_temp_hum_values(uint8_t *data, size_t data_size, int16_t *temp_ptr, uint16_t *hum_ptr)
-/* Process the raw data from the sensor and put them into integers ready to transfer using the wireless protocol */
+/* Process the raw data from the sensor and put them into integers ready to transfer using the wireless protocol,
+ * integer only since the ESP32-C3 has no FPU */
+{
+	if(data_size < 5 || data_size > 6)
+		return ESP_ERR_INVALID_ARG;
+
+	*temp_ptr = convert_raw_temperature((*data << 8) | *(data+1));
+	*hum_ptr = convert_raw_humidity((*(data+3) << 8) | *(data+4));
+
+	return ESP_OK;
+}
+
+esp_err_t process_raw_temp_hum_values_float(uint8_t *data, size_t data_size, int16_t *temp_ptr, uint16_t *hum_ptr)
+/* Floating point reference of process_raw_temp_hum_values, only kept for comparison.
+ * Single precision rounding makes it 0.01 off for 16 of the 65536 raw inputs */
 {
 	if(data_size < 5 || data_size > 6)
 		return ESP_ERR_INVALID_ARG;
@@ -32,58 +65,89 @@ void print_sensor_values(int16_t *temp_ptr, uint16_t *hum_ptr)
 	printf("Humidity:    %.2f\n", *hum_ptr / 100.0);
 }
 
-esp_err_t print_status_register(uint8_t *data, size_t data_size)
-/* Prints the status register to the terminal in a convenient format */
+uint16_t convert_temperature_to_raw(int16_t temperature)
+/* Inverse of convert_raw_temperature, 0.01 C to the raw SHT35 word, clamped to the sensor range */
+{
+	if(temperature <= -4500)
+		return 0;
+	if(temperature >= 13000)
+		return 0xFFFF;
+
+	return ((uint32_t)(temperature + 4500) * 65535u + 8750u) / 17500u;
+}
+
+uint16_t convert_humidity_to_raw(uint16_t humidity)
+/* Inverse of convert_raw_humidity, 0.01 %RH to the raw SHT35 word, clamped to the sensor range */
+{
+	if(humidity >= 10000)
+		return 0xFFFF;
+
+	return ((uint32_t)humidity * 65535u + 5000u) / 10000u;
+}
+
+esp_err_t decode_status_register(uint8_t *data, size_t data_size, SHT35_status_t *status)
+/* Decodes the 2 data bytes of the status register into separate flags */
 {
 	if(data_size < 2 || data_size > 3)
 		return ESP_ERR_INVALID_ARG;
 
-	_Bool alert_pending = *data & 0b10000000;
-	_Bool heater_status = *data & 0b00100000;
-	_Bool rh_tracking_alert = *data & 0b00001000;
-	_Bool t_tracking_alert = *data & 0b00000100;
-	_Bool system_reset_detected = *(data+1) & 0b00010000;
-	_Bool command_status = *(data+1) & 0b00000010;
-	_Bool write_data_checksum_status = *(data+1) & 0b00000001;
+	status->alert_pending = *data & 0b10000000;
+	status->heater_status = *data & 0b00100000;
+	status->rh_tracking_alert = *data & 0b00001000;
+	status->t_tracking_alert = *data & 0b00000100;
+	status->system_reset_detected = *(data+1) & 0b00010000;
+	status->command_status = *(data+1) & 0b00000010;
+	status->write_data_checksum_status = *(data+1) & 0b00000001;
+
+	return ESP_OK;
+}
+
+esp_err_t print_status_register(uint8_t *data, size_t data_size)
+/* Prints the status register to the terminal in a convenient format */
+{
+	SHT35_status_t status;
+
+	if(decode_status_register(data, data_size, &status) != ESP_OK)
+		return ESP_ERR_INVALID_ARG;
 
 	printf("Alert pending status\t\t- ");
-	if(alert_pending)
+	if(status.alert_pending)
 		printf("'1': at least one pending alert\n");
 	else
 		printf("'0': no pending alerts\n");
 
 	printf("Heater status\t\t\t- ");
-	if(heater_status)
+	if(status.heater_status)
 		printf("'1': Heater ON\n");
 	else
 		printf("'0': Heater OFF\n");
 
 	printf("RH tracking alert\t\t- ");
-	if(rh_tracking_alert)
+	if(status.rh_tracking_alert)
 		printf("'1': alert\n");
 	else
 		printf("'0': no alert\n");
 
 	printf("T tracking alert\t\t- ");
-	if(t_tracking_alert)
+	if(status.t_tracking_alert)
 		printf("'1': alert\n");
 	else
 		printf("'0': no alert\n");
 
 	printf("System reset detected\t\t- ");
-	if(system_reset_detected)
+	if(status.system_reset_detected)
 		printf("'1': reset detected (hard reset, soft reset command or supply fail)\n");
 	else
 		printf("'0': no reset detected since last 'clear status register' command\n");
 
 	printf("Command status\t\t\t- ");
-	if(command_status)
+	if(status.command_status)
 		printf("'1': last command not processed. It was either invalid, failed the integrated command checksum\n");
 	else
 		printf("'0': last command executed successfully\n");
 
 	printf("Write data checksum status\t- ");
-	if(write_data_checksum_status)
+	if(status.write_data_checksum_status)
 		printf("'1': checksum of last write transfer failed\n");
 	else
 		printf("'0': checksum of last write transfer was correct\n");
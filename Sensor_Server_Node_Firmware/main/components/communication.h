@@ -11,8 +11,25 @@
 #include "esp_err.h"
 #include <math.h>
 
+// Flags of the SHT35 status register
+typedef struct{
+	_Bool alert_pending;				// at least one pending alert
+	_Bool heater_status;				// heater on
+	_Bool rh_tracking_alert;			// humidity outside the alert limits
+	_Bool t_tracking_alert;				// temperature outside the alert limits
+	_Bool system_reset_detected;		// reset since the last clear status register command
+	_Bool command_status;				// last command not processed
+	_Bool write_data_checksum_status;	// checksum of the last write transfer failed
+}SHT35_status_t;
+
+int16_t convert_raw_temperature(uint16_t raw);
+uint16_t convert_raw_humidity(uint16_t raw);
 esp_err_t process_raw_temp_hum_values(uint8_t *data, size_t data_size, int16_t *temp_ptr, uint16_t *hum_ptr);
+esp_err_t process_raw_temp_hum_values_float(uint8_t *data, size_t data_size, int16_t *temp_ptr, uint16_t *hum_ptr);
+uint16_t convert_temperature_to_raw(int16_t temperature);
+uint16_t convert_humidity_to_raw(uint16_t humidity);
 void print_sensor_values(int16_t *temp_ptr, uint16_t *hum_ptr);
+esp_err_t decode_status_register(uint8_t *data, size_t data_size, SHT35_status_t *status);
 esp_err_t print_status_register(uint8_t *data, size_t data_size);
 
 #endif /* MAIN_COMMUNICATION_H_ */
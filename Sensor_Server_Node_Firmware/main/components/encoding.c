@@ -0,0 +1,63 @@
+/*
+ * encoding.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "encoding.h"
+
+static int32_t encoding_divide(int32_t value, int32_t step)
+/* value / step rounded to the nearest step, halves away from zero */
+{
+	if(value < 0)
+		return -((-value + step / 2) / step);
+	return (value + step / 2) / step;
+}
+
+static int32_t encoding_clamp(int32_t value, int32_t min, int32_t max)
+{
+	if(value < min)
+		return min;
+	if(value > max)
+		return max;
+	return value;
+}
+
+_Bool encoding_supported(const encoding_format_t *format, encoding_t encoding)
+{
+	switch(encoding)
+	{
+	case ENCODING_FINE:
+		return true;
+	case ENCODING_COARSE:
+		return format->coarse_step > 0;
+	default:
+		return false;
+	}
+}
+
+uint8_t encoding_length(const encoding_format_t *format, encoding_t encoding)
+{
+	switch(encoding)
+	{
+	case ENCODING_COARSE:
+		return 1;
+	default:
+		return format->length;
+	}
+}
+
+int32_t encoding_apply(const encoding_format_t *format, encoding_t encoding, int32_t value)
+/* Converts a fine raw value to the encoding, values out of range are clamped to the nearest one that fits */
+{
+	switch(encoding)
+	{
+	case ENCODING_COARSE:
+		value = encoding_divide(value, format->coarse_step);
+		if(format->is_signed)
+			return encoding_clamp(value, INT8_MIN, INT8_MAX);
+		return encoding_clamp(value, 0, UINT8_MAX);
+	default:
+		return value;
+	}
+}
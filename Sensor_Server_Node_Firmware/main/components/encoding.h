@@ -0,0 +1,29 @@
+/*
+ * encoding.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_ENCODING_H_
+#define MAIN_COMPONENTS_ENCODING_H_
+
+#include "freertos/FreeRTOS.h"
+
+// Raw value formats a sensor can be sent in, values are kept in the fine format and converted when sent
+typedef enum{
+	ENCODING_FINE,				// raw value of the property as registered
+	ENCODING_COARSE,			// one octet in steps of coarse_step, e.g. Temperature 8 in 0.5 C
+	ENCODING_COUNT,
+}encoding_t;
+
+typedef struct{
+	uint8_t length;				// raw value length of the fine format
+	_Bool is_signed;			// the fine and coarse raw values are signed
+	int32_t coarse_step;		// fine units per coarse step, 0 when there is no coarse format
+}encoding_format_t;
+
+_Bool encoding_supported(const encoding_format_t *format, encoding_t encoding);
+uint8_t encoding_length(const encoding_format_t *format, encoding_t encoding);
+int32_t encoding_apply(const encoding_format_t *format, encoding_t encoding, int32_t value);
+
+#endif /* MAIN_COMPONENTS_ENCODING_H_ */
@@ -0,0 +1,120 @@
+/*
+ * filter.c
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#include <string.h>
+#include "filter.h"
+
+void filter_init(filter_t *filter, etFilterType type, uint8_t depth)
+/* Resets the filter, depth is clamped to 1..FILTER_MAX_DEPTH */
+{
+	memset(filter, 0, sizeof(filter_t));
+
+	if(depth < 1)
+		depth = 1;
+	if(depth > FILTER_MAX_DEPTH)
+		depth = FILTER_MAX_DEPTH;
+
+	filter->type = type;
+	filter->depth = depth;
+}
+
+static void filter_push_cic(filter_t *filter, uint16_t sample)
+/* Integrators run at the input rate, the combs only once every depth samples.
+ * The registers may wrap, the modulo 2^32 arithmetic still gives the right difference
+ * as long as the output (16 bits + FILTER_CIC_ORDER * log2(depth) bits) fits in 32 bits */
+{
+	uint32_t value = sample;
+	int i;
+
+	for(i = 0; i < FILTER_CIC_ORDER; i++)
+	{
+		filter->integrator[i] += value;
+		value = filter->integrator[i];
+	}
+
+	if(++filter->decimation_count < filter->depth)
+		return;
+	filter->decimation_count = 0;
+
+	for(i = 0; i < FILTER_CIC_ORDER; i++)
+	{
+		uint32_t delayed = filter->comb_delay[i];
+		filter->comb_delay[i] = value;
+		value -= delayed;
+	}
+
+	uint32_t gain = 1;
+	for(i = 0; i < FILTER_CIC_ORDER; i++)
+		gain *= filter->depth;
+
+	filter->cic_output = (value + gain / 2) / gain;
+	if(filter->cic_outputs < FILTER_CIC_ORDER)
+		filter->cic_outputs++;
+}
+
+void filter_push(filter_t *filter, uint16_t sample)
+/* Adds a new sample to the filter */
+{
+	if(filter->count == filter->depth)
+		filter->sum -= filter->window[filter->index];
+	else
+		filter->count++;
+
+	filter->window[filter->index] = sample;
+	filter->sum += sample;
+	filter->index = (filter->index + 1) % filter->depth;
+
+	if(filter->type == FILTER_CIC)
+		filter_push_cic(filter, sample);
+}
+
+static uint16_t filter_median(const filter_t *filter)
+/* Insertion sort of a copy of the window, the window is at most FILTER_MAX_DEPTH long */
+{
+	uint16_t sorted[FILTER_MAX_DEPTH];
+	uint8_t i, j;
+
+	for(i = 0; i < filter->count; i++)
+	{
+		uint16_t value = filter->window[i];
+		for(j = i; j > 0 && sorted[j-1] > value; j--)
+			sorted[j] = sorted[j-1];
+		sorted[j] = value;
+	}
+
+	if(filter->count % 2)
+		return sorted[filter->count / 2];
+
+	return ((uint32_t)sorted[filter->count / 2 - 1] + sorted[filter->count / 2] + 1) / 2;
+}
+
+_Bool filter_output(const filter_t *filter, uint16_t *output)
+/* Gives the current filtered value, returns false when no sample was pushed yet.
+ * Until the CIC has settled the moving average of the samples so far is given instead */
+{
+	if(filter->count == 0)
+		return false;
+
+	switch(filter->type)
+	{
+		case FILTER_MEDIAN:
+			*output = filter_median(filter);
+			break;
+		case FILTER_CIC:
+			if(filter->cic_outputs >= FILTER_CIC_ORDER)
+			{
+				*output = filter->cic_output;
+				break;
+			}
+			// fall through
+		case FILTER_MOVING_AVERAGE:
+		default:
+			*output = (filter->sum + filter->count / 2) / filter->count;
+			break;
+	}
+
+	return true;
+}
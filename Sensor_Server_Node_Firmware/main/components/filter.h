@@ -0,0 +1,41 @@
+/*
+ * filter.h
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_FILTER_H_
+#define MAIN_COMPONENTS_FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FILTER_MAX_DEPTH	32
+#define FILTER_CIC_ORDER	2
+
+// Decimation filter applied to the raw sensor words
+typedef enum{
+	FILTER_MOVING_AVERAGE,	// mean of the last depth samples
+	FILTER_MEDIAN,			// median of the last depth samples, rejects single outliers
+	FILTER_CIC,				// cascaded integrator-comb decimating by depth
+}etFilterType;
+
+typedef struct{
+	etFilterType type;
+	uint8_t depth;			// window length, decimation ratio for the CIC
+	uint8_t count;			// number of valid samples in the window
+	uint8_t index;			// next write position in the window
+	uint16_t window[FILTER_MAX_DEPTH];
+	uint32_t sum;			// running sum of the window
+	uint32_t integrator[FILTER_CIC_ORDER];
+	uint32_t comb_delay[FILTER_CIC_ORDER];
+	uint8_t decimation_count;
+	uint8_t cic_outputs;	// decimated outputs since init, the CIC has settled after FILTER_CIC_ORDER
+	uint16_t cic_output;
+}filter_t;
+
+void filter_init(filter_t *filter, etFilterType type, uint8_t depth);
+void filter_push(filter_t *filter, uint16_t sample);
+_Bool filter_output(const filter_t *filter, uint16_t *output);
+
+#endif /* MAIN_COMPONENTS_FILTER_H_ */
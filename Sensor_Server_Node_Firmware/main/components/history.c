@@ -0,0 +1,278 @@
+/*
+ * history.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <string.h>
+#include "esp_timer.h"
+#include "history.h"
+
+/* The history of a sensor is a ring of time buckets and a histogram, both updated in place as a reading
+ * arrives so a Sensor Series Get only encodes what is already there. The buckets of a sensor are one
+ * contiguous array and a bucket that falls out of the window is taken off the window sum and cleared when
+ * the ring moves past it, no reading is ever kept on its own. */
+
+// Readings come from the main loop, the Sensor Series and Column Gets from the mesh callbacks
+static portMUX_TYPE history_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t history_epoch(const history_t *history)
+{
+	return (uint32_t)(esp_timer_get_time() / 1000000) / history->config.bucket_s;
+}
+
+static void history_advance(history_t *history, uint32_t epoch)
+/* Moves the head to the bucket of epoch, the buckets passed over had no readings */
+{
+	history_bucket_t *bucket;
+	uint32_t steps;
+
+	if(epoch <= history->head_epoch)
+		return;
+
+	steps = epoch - history->head_epoch;
+	if(steps > HISTORY_BUCKETS)
+		steps = HISTORY_BUCKETS;
+	while(steps-- > 0)
+	{
+		history->head = (history->head + 1) % HISTORY_BUCKETS;
+		bucket = &history->buckets[history->head];
+		history->window_sum -= bucket->sum;
+		history->window_count -= bucket->count;
+		memset(bucket, 0, sizeof(*bucket));
+	}
+	history->head_epoch = epoch;
+}
+
+static int32_t history_decode(const uint8_t *data, uint8_t length, _Bool is_signed)
+/* Little endian raw value of 1 to 4 octets to an integer */
+{
+	uint32_t value = 0;
+	int i;
+
+	for(i = length - 1; i >= 0; i--)
+		value = (value << 8) | data[i];
+
+	if(is_signed && length < 4 && (value & (1UL << (length * 8 - 1))))
+		value |= ~0UL << (length * 8);
+
+	return (int32_t)value;
+}
+
+static void history_encode(int32_t value, uint8_t length, uint8_t *data)
+{
+	uint8_t i;
+
+	for(i = 0; i < length; i++)
+		data[i] = (uint32_t)value >> (8 * i);
+}
+
+static _Bool history_fits(const history_t *history, int32_t value, _Bool is_signed)
+/* Whether value can be encoded in the raw value length */
+{
+	uint8_t bits = history->config.value_len * 8;
+
+	if(bits >= 32)
+		return is_signed || value >= 0;
+	if(is_signed)
+		return value >= -(1L << (bits - 1)) && value < (1L << (bits - 1));
+	return value >= 0 && value < (1L << bits);
+}
+
+static uint8_t history_column_count(const history_t *history)
+{
+	return history->config.series == HISTORY_SERIES_TIME ? HISTORY_BUCKETS : HISTORY_BINS;
+}
+
+static int32_t history_column_x(const history_t *history, uint8_t column)
+{
+	if(history->config.series == HISTORY_SERIES_TIME)
+		return column * history->config.bucket_s;
+	return history->config.bin_low + column * history->config.bin_width;
+}
+
+static int32_t history_column_width(const history_t *history)
+{
+	if(history->config.series == HISTORY_SERIES_TIME)
+		return history->config.bucket_s;
+	return history->config.bin_width;
+}
+
+static _Bool history_column_y(const history_t *history, uint8_t column, int32_t *y)
+/* Mean of a time bucket or count of a bin, a time bucket without readings has no column */
+{
+	const history_bucket_t *bucket;
+
+	if(history->config.series == HISTORY_SERIES_TIME)
+	{
+		bucket = &history->buckets[(history->head + HISTORY_BUCKETS - column) % HISTORY_BUCKETS];
+		if(bucket->count == 0)
+			return false;
+		*y = bucket->sum / bucket->count;
+		return true;
+	}
+
+	*y = history->bins[column];
+	if(!history_fits(history, *y, false))
+		*y = (1L << (history->config.value_len * 8)) - 1;
+	return true;
+}
+
+static _Bool history_x_signed(const history_t *history)
+{
+	return history->config.series == HISTORY_SERIES_VALUE && history->config.is_signed;
+}
+
+static uint16_t history_write_column(const history_t *history, uint8_t column, _Bool with_x, uint8_t *data)
+/* Writes X (when asked), the Column Width and Y of a column and returns the length, 0 if it has no column */
+{
+	uint8_t length = history->config.value_len;
+	uint16_t written = 0;
+	int32_t y;
+
+	if(!history_column_y(history, column, &y))
+		return 0;
+	if(with_x)
+	{
+		history_encode(history_column_x(history, column), length, data);
+		written += length;
+	}
+	history_encode(history_column_width(history), length, data + written);
+	written += length;
+	history_encode(y, length, data + written);
+	return written + length;
+}
+
+void history_init(history_t *history, const history_config_t *config)
+{
+	memset(history, 0, sizeof(history_t));
+	history->config = *config;
+	if(history->config.bucket_s == 0)
+		history->config.bucket_s = 1;
+	if(history->config.bin_width <= 0)
+		history->config.bin_width = 1;
+	history->head_epoch = history_epoch(history);
+}
+
+void history_add(history_t *history, int32_t value)
+/* Counts a reading in the bucket of the present period and in its histogram bin */
+{
+	uint32_t epoch = history_epoch(history);
+	history_bucket_t *bucket;
+	int32_t bin;
+	uint8_t i;
+
+	bin = (value - history->config.bin_low) / history->config.bin_width;
+	if(value < history->config.bin_low)
+		bin = 0;
+	else if(bin >= HISTORY_BINS)
+		bin = HISTORY_BINS - 1;
+
+	taskENTER_CRITICAL(&history_lock);
+	history_advance(history, epoch);
+	bucket = &history->buckets[history->head];
+	if(bucket->count == 0 || value < bucket->min)
+		bucket->min = value;
+	if(bucket->count == 0 || value > bucket->max)
+		bucket->max = value;
+	bucket->sum += value;
+	bucket->count++;
+	history->window_sum += value;
+	history->window_count++;
+
+	// A full bin halves all of them, older readings weigh less from then on
+	if(history->bins[bin] == UINT16_MAX)
+	{
+		for(i = 0; i < HISTORY_BINS; i++)
+			history->bins[i] /= 2;
+	}
+	history->bins[bin]++;
+	taskEXIT_CRITICAL(&history_lock);
+}
+
+_Bool history_window(history_t *history, int32_t *min, int32_t *max, int32_t *mean)
+/* Minimum, maximum and mean over all buckets, false when the window has no readings */
+{
+	uint32_t epoch = history_epoch(history);
+	const history_bucket_t *bucket;
+	_Bool found = false;
+	uint8_t i;
+
+	taskENTER_CRITICAL(&history_lock);
+	history_advance(history, epoch);
+	for(i = 0; i < HISTORY_BUCKETS; i++)
+	{
+		bucket = &history->buckets[i];
+		if(bucket->count == 0)
+			continue;
+		if(!found || bucket->min < *min)
+			*min = bucket->min;
+		if(!found || bucket->max > *max)
+			*max = bucket->max;
+		found = true;
+	}
+	if(found)
+		*mean = history->window_sum / history->window_count;
+	taskEXIT_CRITICAL(&history_lock);
+
+	return found;
+}
+
+uint16_t history_series(history_t *history, const uint8_t *range, uint8_t range_len, uint8_t *data, uint16_t max)
+/* Writes the Raw Value X, Column Width and Raw Value Y of every column from X1 up to X2 into data and returns
+ * the length. range holds X1 and X2, without them every column is written. Time buckets are written newest
+ * first, the columns that do not fit in max are left out */
+{
+	uint8_t length = history->config.value_len;
+	uint32_t epoch = history_epoch(history);
+	int32_t x, x1 = INT32_MIN, x2 = INT32_MAX;
+	uint16_t written = 0;
+	uint8_t column;
+
+	if(range_len >= 2 * length)
+	{
+		x1 = history_decode(range, length, history_x_signed(history));
+		x2 = history_decode(range + length, length, history_x_signed(history));
+	}
+
+	taskENTER_CRITICAL(&history_lock);
+	history_advance(history, epoch);
+	for(column = 0; column < history_column_count(history) && written + 3 * length <= max; column++)
+	{
+		x = history_column_x(history, column);
+		if(x < x1 || x > x2 || !history_fits(history, x, history_x_signed(history)))
+			continue;
+		written += history_write_column(history, column, true, data + written);
+	}
+	taskEXIT_CRITICAL(&history_lock);
+
+	return written;
+}
+
+uint16_t history_column(history_t *history, const uint8_t *x, uint8_t x_len, uint8_t *data)
+/* Writes the Column Width and Raw Value Y of the column that starts at X into data and returns the length,
+ * 0 when there is no such column */
+{
+	uint32_t epoch = history_epoch(history);
+	int32_t value, offset;
+	uint16_t written;
+	int32_t column;
+
+	if(x_len != history->config.value_len)
+		return 0;
+
+	value = history_decode(x, x_len, history_x_signed(history));
+	offset = history->config.series == HISTORY_SERIES_TIME ? value : value - history->config.bin_low;
+	if(offset < 0 || offset % history_column_width(history) != 0)
+		return 0;
+	column = offset / history_column_width(history);
+	if(column >= history_column_count(history))
+		return 0;
+
+	taskENTER_CRITICAL(&history_lock);
+	history_advance(history, epoch);
+	written = history_write_column(history, column, false, data);
+	taskEXIT_CRITICAL(&history_lock);
+
+	return written;
+}
@@ -0,0 +1,55 @@
+/*
+ * history.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_HISTORY_H_
+#define MAIN_COMPONENTS_HISTORY_H_
+
+#include "freertos/FreeRTOS.h"
+
+#define HISTORY_BUCKETS		60		// time buckets per sensor, an hour of one minute buckets
+#define HISTORY_BINS		16		// value bins of the histogram of a sensor
+
+// Columns of a Sensor Series, see history_series
+typedef enum{
+	HISTORY_SERIES_TIME,			// X is the age of a bucket in seconds, Y its mean
+	HISTORY_SERIES_VALUE,			// X is the lower bound of a bin, Y the number of samples in it
+}history_series_t;
+
+typedef struct{
+	history_series_t series;
+	uint16_t bucket_s;				// length of a time bucket
+	int32_t bin_low;				// lower bound of the first histogram bin, raw value
+	int32_t bin_width;				// raw value, the outer bins also count the values beyond them
+	uint8_t value_len;				// raw value length of X, the Column Width and Y
+	_Bool is_signed;
+}history_config_t;
+
+// Readings of one time bucket
+typedef struct{
+	int64_t sum;
+	int32_t min;
+	int32_t max;
+	uint32_t count;					// 0 for a bucket without readings
+}history_bucket_t;
+
+// Recent readings of one sensor, every aggregate is updated as a reading is added
+typedef struct{
+	history_config_t config;
+	history_bucket_t buckets[HISTORY_BUCKETS];
+	uint32_t head_epoch;			// uptime / bucket_s of buckets[head]
+	uint8_t head;					// bucket of the current period
+	int64_t window_sum;				// sum and count over all buckets
+	uint32_t window_count;
+	uint16_t bins[HISTORY_BINS];
+}history_t;
+
+void history_init(history_t *history, const history_config_t *config);
+void history_add(history_t *history, int32_t value);
+_Bool history_window(history_t *history, int32_t *min, int32_t *max, int32_t *mean);
+uint16_t history_series(history_t *history, const uint8_t *range, uint8_t range_len, uint8_t *data, uint16_t max);
+uint16_t history_column(history_t *history, const uint8_t *x, uint8_t x_len, uint8_t *data);
+
+#endif /* MAIN_COMPONENTS_HISTORY_H_ */
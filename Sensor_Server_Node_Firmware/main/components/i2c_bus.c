@@ -0,0 +1,149 @@
+/*
+ * i2c_bus.c
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "i2c_bus.h"
+#include "commands.h"
+
+/* A transaction lives on the stack of the requesting task, which blocks until the bus-owner task
+ * has executed it. Only a pointer travels through the queue */
+typedef struct{
+	uint8_t address;
+	const uint8_t *write_data;
+	size_t write_size;
+	uint8_t *read_data;
+	size_t read_size;
+	int64_t queued_us;
+	esp_err_t result;
+	SemaphoreHandle_t done;
+}i2c_transaction_t;
+
+typedef struct{
+	QueueHandle_t queue;
+	i2c_bus_stats_t stats;
+	portMUX_TYPE lock;
+}i2c_bus_t;
+
+static i2c_bus_t buses[I2C_NUM_MAX];
+
+static void i2c_bus_task(void *arg)
+/* Owns the I2C port, executes the queued transactions one at a time in request order */
+{
+	i2c_port_t port = (i2c_port_t)(intptr_t)arg;
+	i2c_bus_t *bus = &buses[port];
+	i2c_transaction_t *transaction;
+	TickType_t timeout = pdMS_TO_TICKS(I2C_MASTER_TIMEOUT_MS);
+	int64_t start, end;
+
+	while(1)
+	{
+		xQueueReceive(bus->queue, &transaction, portMAX_DELAY);
+
+		start = esp_timer_get_time();
+		if(transaction->write_size > 0 && transaction->read_size > 0)
+			transaction->result = i2c_master_write_read_device(port, transaction->address, transaction->write_data, transaction->write_size,
+					transaction->read_data, transaction->read_size, timeout);
+		else if(transaction->write_size > 0)
+			transaction->result = i2c_master_write_to_device(port, transaction->address, transaction->write_data, transaction->write_size, timeout);
+		else
+			transaction->result = i2c_master_read_from_device(port, transaction->address, transaction->read_data, transaction->read_size, timeout);
+		end = esp_timer_get_time();
+
+		taskENTER_CRITICAL(&bus->lock);
+		bus->stats.transactions++;
+		if(transaction->result != ESP_OK)
+			bus->stats.errors++;
+		if(start - transaction->queued_us > bus->stats.max_wait_us)
+			bus->stats.max_wait_us = start - transaction->queued_us;
+		bus->stats.busy_us += end - start;
+		taskEXIT_CRITICAL(&bus->lock);
+
+		xSemaphoreGive(transaction->done);
+	}
+}
+
+esp_err_t i2c_bus_start(i2c_port_t port)
+/* Starts the bus-owner task of an installed I2C master port, all access to the port has to go through i2c_bus_transfer afterwards */
+{
+	i2c_bus_t *bus;
+
+	if(port < 0 || port >= I2C_NUM_MAX)
+		return ESP_ERR_INVALID_ARG;
+	bus = &buses[port];
+	if(bus->queue != NULL)
+		return ESP_ERR_INVALID_STATE;
+
+	bus->queue = xQueueCreate(I2C_BUS_QUEUE_LENGTH, sizeof(i2c_transaction_t *));
+	if(bus->queue == NULL)
+		return ESP_ERR_NO_MEM;
+	bus->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+	bus->stats.started_us = esp_timer_get_time();
+
+	if(xTaskCreate(i2c_bus_task, "i2c_bus", I2C_BUS_TASK_STACK_SIZE, (void *)(intptr_t)port, I2C_BUS_TASK_PRIORITY, NULL) != pdPASS)
+		return ESP_ERR_NO_MEM;
+
+	return ESP_OK;
+}
+
+esp_err_t i2c_bus_transfer(i2c_port_t port, uint8_t address, const uint8_t *write_data, size_t write_size, uint8_t *read_data, size_t read_size)
+/* Queues a write, read or write-then-read (repeated start) transaction and blocks until it is done.
+ * Waiting tasks do not hold the bus, drivers on the same port are served in request order */
+{
+	StaticSemaphore_t done_buffer;
+	i2c_transaction_t transaction = {
+		.address = address,
+		.write_data = write_data,
+		.write_size = write_size,
+		.read_data = read_data,
+		.read_size = read_size,
+		.result = ESP_FAIL,
+	};
+	i2c_transaction_t *transaction_ptr = &transaction;
+	i2c_bus_t *bus;
+	UBaseType_t queued;
+
+	if(port < 0 || port >= I2C_NUM_MAX)
+		return ESP_ERR_INVALID_ARG;
+	bus = &buses[port];
+	if(bus->queue == NULL)
+		return ESP_ERR_INVALID_STATE;
+	if(write_size == 0 && read_size == 0)
+		return ESP_ERR_INVALID_ARG;
+
+	transaction.done = xSemaphoreCreateBinaryStatic(&done_buffer);
+	transaction.queued_us = esp_timer_get_time();
+	xQueueSend(bus->queue, &transaction_ptr, portMAX_DELAY);
+
+	queued = uxQueueMessagesWaiting(bus->queue);
+	taskENTER_CRITICAL(&bus->lock);
+	if(queued > bus->stats.max_queued)
+		bus->stats.max_queued = queued;
+	taskEXIT_CRITICAL(&bus->lock);
+
+	/* The bus-owner task always completes a transaction within the driver timeout,
+	 * the transaction must stay valid on this stack until then */
+	xSemaphoreTake(transaction.done, portMAX_DELAY);
+	vSemaphoreDelete(transaction.done);
+
+	return transaction.result;
+}
+
+esp_err_t i2c_bus_get_stats(i2c_port_t port, i2c_bus_stats_t *stats)
+{
+	if(port < 0 || port >= I2C_NUM_MAX)
+		return ESP_ERR_INVALID_ARG;
+	if(buses[port].queue == NULL)
+		return ESP_ERR_INVALID_STATE;
+
+	taskENTER_CRITICAL(&buses[port].lock);
+	*stats = buses[port].stats;
+	taskEXIT_CRITICAL(&buses[port].lock);
+
+	return ESP_OK;
+}
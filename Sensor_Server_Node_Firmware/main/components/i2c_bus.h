@@ -0,0 +1,31 @@
+/*
+ * i2c_bus.h
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_I2C_BUS_H_
+#define MAIN_COMPONENTS_I2C_BUS_H_
+
+#include "freertos/FreeRTOS.h"
+#include "driver/i2c.h"
+
+#define I2C_BUS_TASK_STACK_SIZE		2048
+#define I2C_BUS_TASK_PRIORITY		6		// above the drivers so queued transactions are never starved
+#define I2C_BUS_QUEUE_LENGTH		8
+
+// Counters of one bus, kept by its bus-owner task
+typedef struct{
+	uint32_t transactions;		// completed transactions
+	uint32_t errors;			// transactions that did not return ESP_OK
+	uint32_t max_queued;		// most transactions waiting at once
+	uint32_t max_wait_us;		// longest time a transaction waited for the bus
+	uint64_t busy_us;			// total time the bus was in use
+	uint64_t started_us;		// time the bus-owner task was started
+}i2c_bus_stats_t;
+
+esp_err_t i2c_bus_start(i2c_port_t port);
+esp_err_t i2c_bus_transfer(i2c_port_t port, uint8_t address, const uint8_t *write_data, size_t write_size, uint8_t *read_data, size_t read_size);
+esp_err_t i2c_bus_get_stats(i2c_port_t port, i2c_bus_stats_t *stats);
+
+#endif /* MAIN_COMPONENTS_I2C_BUS_H_ */
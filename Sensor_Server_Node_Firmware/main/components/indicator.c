@@ -0,0 +1,97 @@
+/*
+ * indicator.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "LED.h"
+#include "indicator.h"
+
+/* Every LED_setcolor waits for the RMT refresh of the WS2812, up to 100 ms. Callers only post an event,
+ * this task renders it and times the flashes, so the mesh and publish paths never wait on the LED */
+
+// How an event is shown, a duration of 0 is a steady state
+typedef struct{
+	uint8_t red;
+	uint8_t green;
+	uint8_t blue;
+	uint16_t duration_ms;
+}indicator_pattern_t;
+
+static const indicator_pattern_t patterns[INDICATOR_EVENT_COUNT] = {
+	[INDICATOR_BOOT]			= {   0, 255, 255,   0 },
+	[INDICATOR_PROVISIONING]	= { 255, 255,   0,   0 },
+	[INDICATOR_IDLE]			= {   0,   0,   0,   0 },
+	[INDICATOR_PUBLISHED]		= {   0, 255,   0,  50 },
+	[INDICATOR_ERROR]			= { 255,   0,   0, 200 },
+};
+
+static QueueHandle_t event_queue = NULL;
+static volatile uint32_t dropped_events;
+
+static void indicator_task(void *arg)
+{
+	const indicator_pattern_t *steady = &patterns[INDICATOR_IDLE];
+	const indicator_pattern_t *shown = NULL;
+	TickType_t wait_ticks = portMAX_DELAY;
+	indicator_event_t event;
+
+	LED_init();
+	vTaskDelay(pdMS_TO_TICKS(10));
+
+	while(1)
+	{
+		if(xQueueReceive(event_queue, &event, wait_ticks) != pdTRUE)
+		{
+			/* End of a flash, a burst of flashes keeps the LED on until the last one ends */
+			LED_setcolor(steady->red, steady->green, steady->blue);
+			shown = steady;
+			wait_ticks = portMAX_DELAY;
+			continue;
+		}
+
+		if(event >= INDICATOR_EVENT_COUNT)
+			continue;
+		if(patterns[event].duration_ms == 0)
+			steady = &patterns[event];
+		else
+			wait_ticks = pdMS_TO_TICKS(patterns[event].duration_ms);
+		/* The first publication ends the boot state of a node that never raised a provisioning event */
+		if(event == INDICATOR_PUBLISHED && steady == &patterns[INDICATOR_BOOT])
+			steady = &patterns[INDICATOR_IDLE];
+
+		if(shown != &patterns[event])
+			LED_setcolor(patterns[event].red, patterns[event].green, patterns[event].blue);
+		shown = &patterns[event];
+	}
+}
+
+esp_err_t indicator_start(void)
+/* The LED is initialised by the task itself */
+{
+	if(event_queue != NULL)
+		return ESP_ERR_INVALID_STATE;
+
+	event_queue = xQueueCreate(INDICATOR_QUEUE_LENGTH, sizeof(indicator_event_t));
+	if(event_queue == NULL)
+		return ESP_ERR_NO_MEM;
+
+	if(xTaskCreate(indicator_task, "indicator", INDICATOR_TASK_STACK_SIZE, NULL, INDICATOR_TASK_PRIORITY, NULL) != pdPASS)
+		return ESP_ERR_NO_MEM;
+
+	return ESP_OK;
+}
+
+void indicator_post(indicator_event_t event)
+/* Never blocks, an event that finds the queue full is dropped */
+{
+	if(event_queue == NULL || xQueueSend(event_queue, &event, 0) != pdTRUE)
+		dropped_events++;
+}
+
+uint32_t indicator_dropped(void)
+{
+	return dropped_events;
+}
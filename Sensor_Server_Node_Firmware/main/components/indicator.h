@@ -0,0 +1,31 @@
+/*
+ * indicator.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_INDICATOR_H_
+#define MAIN_COMPONENTS_INDICATOR_H_
+
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#define INDICATOR_TASK_STACK_SIZE	2048
+#define INDICATOR_TASK_PRIORITY		1		// below everything else, a late flash does not matter
+#define INDICATOR_QUEUE_LENGTH		8
+
+// Events shown on the status LED, a flash returns to the last steady state
+typedef enum{
+	INDICATOR_BOOT,				// steady cyan until provisioned or the first publication
+	INDICATOR_PROVISIONING,		// steady yellow while a provisioning link is open
+	INDICATOR_IDLE,				// steady off
+	INDICATOR_PUBLISHED,		// green flash
+	INDICATOR_ERROR,			// red flash
+	INDICATOR_EVENT_COUNT,
+}indicator_event_t;
+
+esp_err_t indicator_start(void);
+void indicator_post(indicator_event_t event);
+uint32_t indicator_dropped(void);
+
+#endif /* MAIN_COMPONENTS_INDICATOR_H_ */
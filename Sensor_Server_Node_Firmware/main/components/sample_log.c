@@ -0,0 +1,337 @@
+/*
+ * sample_log.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <string.h>
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "sample_log.h"
+
+#define TAG "SAMPLE_LOG"
+
+/* The partition is an append-only ring of sectors. A sector is erased right before it is written again, so
+ * every sector sees one erase per trip around the ring and the wear is spread evenly over the partition.
+ * A write or an erase blocks for milliseconds, so callers only queue a record and this task writes it */
+
+// Start of every sector, the sequence of its first record places every record of the sector
+typedef struct{
+	uint32_t magic;
+	uint32_t first_sequence;	// always a multiple of RECORDS_PER_SECTOR
+	uint32_t reserved[2];
+}sample_log_header_t;
+
+#define RECORDS_PER_SECTOR	((uint16_t)((SPI_FLASH_SEC_SIZE - sizeof(sample_log_header_t)) / sizeof(sample_log_record_t)))
+
+_Static_assert(sizeof(sample_log_record_t) == 16, "Sample log record is not packed");
+_Static_assert(sizeof(sample_log_header_t) == sizeof(sample_log_record_t), "Sample log header does not fill a slot");
+
+static const esp_partition_t *partition = NULL;
+static SemaphoreHandle_t lock;
+static uint16_t sector_count;
+static uint16_t head;				// sector being written
+static uint32_t head_first;			// sequence of the first record of the head sector
+static uint16_t head_slot;			// next free slot of the head sector
+static uint32_t first_sequence;		// oldest record still in the ring
+static uint8_t boot;
+static QueueHandle_t record_queue = NULL;
+static volatile uint32_t dropped_records;
+
+static inline size_t sample_log_offset(uint16_t sector, uint16_t slot)
+{
+	return (size_t)sector * SPI_FLASH_SEC_SIZE + sizeof(sample_log_header_t) + slot * sizeof(sample_log_record_t);
+}
+
+static _Bool sample_log_erased(const sample_log_record_t *record)
+{
+	const uint8_t *bytes = (const uint8_t *)record;
+	uint8_t i;
+
+	for(i = 0; i < sizeof(*record); i++)
+	{
+		if(bytes[i] != 0xFF)
+			return false;
+	}
+	return true;
+}
+
+static esp_err_t sample_log_open_sector(uint16_t sector, uint32_t first)
+/* Erases the sector and writes its header, once the ring is full this drops the oldest sector */
+{
+	sample_log_header_t header = {
+		.magic = SAMPLE_LOG_MAGIC,
+		.first_sequence = first,
+		.reserved = {UINT32_MAX, UINT32_MAX},
+	};
+	esp_err_t err;
+
+	err = esp_partition_erase_range(partition, (size_t)sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE);
+	if(err != ESP_OK)
+		return err;
+	return esp_partition_write(partition, (size_t)sector * SPI_FLASH_SEC_SIZE, &header, sizeof(header));
+}
+
+static esp_err_t sample_log_scan(void)
+/* Finds the newest sector and its first free slot. A record torn by a reset is overwritten with zeros,
+ * its sequence number is skipped */
+{
+	sample_log_header_t header;
+	sample_log_record_t record, last = {0};
+	_Bool found = false, have_last = false;
+	uint16_t i, sector;
+	esp_err_t err;
+
+	partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, SAMPLE_LOG_PARTITION_SUBTYPE, SAMPLE_LOG_PARTITION_LABEL);
+	if(partition == NULL)
+		return ESP_ERR_NOT_FOUND;
+	sector_count = partition->size / SPI_FLASH_SEC_SIZE;
+	if(sector_count < 2)
+	{
+		partition = NULL;
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	lock = xSemaphoreCreateMutex();
+	if(lock == NULL)
+	{
+		partition = NULL;
+		return ESP_ERR_NO_MEM;
+	}
+
+	for(i = 0; i < sector_count; i++)
+	{
+		err = esp_partition_read(partition, (size_t)i * SPI_FLASH_SEC_SIZE, &header, sizeof(header));
+		if(err != ESP_OK)
+			return err;
+		if(header.magic == SAMPLE_LOG_MAGIC && (!found || header.first_sequence > head_first))
+		{
+			head = i;
+			head_first = header.first_sequence;
+			found = true;
+		}
+	}
+
+	if(!found)
+	{
+		ESP_LOGI(TAG, "Empty log, %u sectors of %u records", sector_count, RECORDS_PER_SECTOR);
+		head = 0;
+		head_first = 0;
+		head_slot = 0;
+		first_sequence = 0;
+		boot = 0;
+		return sample_log_open_sector(0, 0);
+	}
+
+	for(head_slot = 0; head_slot < RECORDS_PER_SECTOR; head_slot++)
+	{
+		err = esp_partition_read(partition, sample_log_offset(head, head_slot), &record, sizeof(record));
+		if(err != ESP_OK)
+			return err;
+		if(record.sequence == head_first + head_slot)
+		{
+			last = record;
+			have_last = true;
+			continue;
+		}
+		if(sample_log_erased(&record))
+			break;
+
+		memset(&record, 0, sizeof(record));
+		esp_partition_write(partition, sample_log_offset(head, head_slot), &record, sizeof(record));
+	}
+
+	// A new head sector has no records yet, the last one of the previous boot ends the sector before it
+	if(!have_last && head_first >= RECORDS_PER_SECTOR)
+	{
+		sector = (head + sector_count - 1) % sector_count;
+		if(esp_partition_read(partition, sample_log_offset(sector, RECORDS_PER_SECTOR - 1), &record, sizeof(record)) == ESP_OK
+				&& record.sequence == head_first - 1)
+		{
+			last = record;
+			have_last = true;
+		}
+	}
+	boot = have_last ? last.boot + 1 : 0;
+
+	// The oldest sector is the furthest one back that still continues the sequence of the head
+	first_sequence = head_first;
+	for(i = sector_count - 1; i > 0; i--)
+	{
+		if((uint32_t)i * RECORDS_PER_SECTOR > head_first)
+			continue;
+
+		sector = (head + sector_count - i) % sector_count;
+		if(esp_partition_read(partition, (size_t)sector * SPI_FLASH_SEC_SIZE, &header, sizeof(header)) == ESP_OK
+				&& header.magic == SAMPLE_LOG_MAGIC && header.first_sequence == head_first - i * RECORDS_PER_SECTOR)
+		{
+			first_sequence = header.first_sequence;
+			break;
+		}
+	}
+
+	ESP_LOGI(TAG, "Records %u to %u, boot %u", first_sequence, head_first + head_slot, boot);
+	return ESP_OK;
+}
+
+static esp_err_t sample_log_write(sample_log_record_t *record)
+/* Writes the record into the next slot, the sequence number is used up even when the write fails */
+{
+	uint16_t next_head;
+	uint32_t dropped;
+	esp_err_t err = ESP_OK;
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if(head_slot == RECORDS_PER_SECTOR)
+	{
+		next_head = (head + 1) % sector_count;
+		err = sample_log_open_sector(next_head, head_first + RECORDS_PER_SECTOR);
+		if(err == ESP_OK)
+		{
+			head = next_head;
+			head_first += RECORDS_PER_SECTOR;
+			head_slot = 0;
+
+			// The erased sector held the records just below the ones still left in the other sectors
+			if(head_first >= (uint32_t)(sector_count - 1) * RECORDS_PER_SECTOR)
+			{
+				dropped = head_first - (sector_count - 1) * RECORDS_PER_SECTOR;
+				if(first_sequence < dropped)
+					first_sequence = dropped;
+			}
+		}
+	}
+	if(err == ESP_OK)
+	{
+		record->sequence = head_first + head_slot;
+		err = esp_partition_write(partition, sample_log_offset(head, head_slot), record, sizeof(*record));
+		head_slot++;
+	}
+	xSemaphoreGive(lock);
+	return err;
+}
+
+static void sample_log_task(void *arg)
+{
+	sample_log_record_t record;
+	esp_err_t err;
+
+	while(1)
+	{
+		if(xQueueReceive(record_queue, &record, portMAX_DELAY) != pdTRUE)
+			continue;
+		err = sample_log_write(&record);
+		if(err != ESP_OK)
+			ESP_LOGE(TAG, "Append failed (err %d)", err);
+	}
+}
+
+esp_err_t sample_log_init(void)
+/* Finds the end of the log and starts the task that writes the queued records */
+{
+	esp_err_t err;
+
+	if(record_queue != NULL)
+		return ESP_ERR_INVALID_STATE;
+
+	err = sample_log_scan();
+	if(err != ESP_OK)
+		return err;
+
+	record_queue = xQueueCreate(SAMPLE_LOG_QUEUE_LENGTH, sizeof(sample_log_record_t));
+	if(record_queue == NULL)
+		return ESP_ERR_NO_MEM;
+
+	if(xTaskCreate(sample_log_task, "sample_log", SAMPLE_LOG_TASK_STACK_SIZE, NULL, SAMPLE_LOG_TASK_PRIORITY, NULL) != pdPASS)
+	{
+		vQueueDelete(record_queue);
+		record_queue = NULL;
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t sample_log_append(uint8_t zone, uint16_t property_id, int32_t value)
+/* Queues one sample stamped with the uptime for the task to write. Never blocks, a sample that finds
+ * the queue full is dropped and never gets a sequence number */
+{
+	sample_log_record_t record = {
+		.time_s = esp_timer_get_time() / 1000000,
+		.value = value,
+		.property_id = property_id,
+		.zone = zone,
+		.boot = boot,
+	};
+
+	if(record_queue == NULL)
+		return ESP_ERR_INVALID_STATE;
+	if(xQueueSend(record_queue, &record, 0) != pdTRUE)
+	{
+		dropped_records++;
+		return ESP_ERR_NO_MEM;
+	}
+	return ESP_OK;
+}
+
+uint16_t sample_log_read(uint32_t *sequence, uint32_t end, sample_log_record_t *records, uint16_t max)
+/* Copies up to max records from *sequence up to end into records and returns the number copied.
+ * *sequence is moved past the last slot looked at, records dropped from the ring or torn are skipped */
+{
+	sample_log_record_t record;
+	uint32_t next;
+	uint16_t count = 0, back, sector;
+
+	if(partition == NULL)
+		return 0;
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if(*sequence < first_sequence)
+		*sequence = first_sequence;
+	next = head_first + head_slot;
+	if(end > next)
+		end = next;
+
+	for(; *sequence < end && count < max; (*sequence)++)
+	{
+		back = (head_first - (*sequence - *sequence % RECORDS_PER_SECTOR)) / RECORDS_PER_SECTOR;
+		sector = (head + sector_count - back) % sector_count;
+		if(esp_partition_read(partition, sample_log_offset(sector, *sequence % RECORDS_PER_SECTOR), &record, sizeof(record)) != ESP_OK)
+			continue;
+		if(record.sequence == *sequence)
+			records[count++] = record;
+	}
+	xSemaphoreGive(lock);
+
+	return count;
+}
+
+void sample_log_range(uint32_t *first, uint32_t *next)
+/* Sequence of the oldest record in the log and the one the next record gets */
+{
+	if(partition == NULL)
+	{
+		*first = 0;
+		*next = 0;
+		return;
+	}
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+	*first = first_sequence;
+	*next = head_first + head_slot;
+	xSemaphoreGive(lock);
+}
+
+uint8_t sample_log_boot(void)
+{
+	return boot;
+}
+
+uint32_t sample_log_dropped(void)
+{
+	return dropped_records;
+}
@@ -0,0 +1,38 @@
+/*
+ * sample_log.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_SAMPLE_LOG_H_
+#define MAIN_COMPONENTS_SAMPLE_LOG_H_
+
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#define SAMPLE_LOG_PARTITION_LABEL		"samplelog"
+#define SAMPLE_LOG_PARTITION_SUBTYPE	0x40	// first custom data subtype, see partitions.csv
+#define SAMPLE_LOG_MAGIC				0x53474F4C	// "LOGS"
+
+#define SAMPLE_LOG_TASK_STACK_SIZE		3072
+#define SAMPLE_LOG_TASK_PRIORITY		2		// below the backfill, a record may wait for its flash write
+#define SAMPLE_LOG_QUEUE_LENGTH			32		// a publication of every zone, several times over
+
+// One logged sample, a sector holds a header and a whole number of records
+typedef struct{
+	uint32_t sequence;		// increments by one per record across reboots, 0xFFFFFFFF is an erased slot
+	uint32_t time_s;		// node uptime when the sample was logged
+	int32_t value;			// raw value as published
+	uint16_t property_id;
+	uint8_t zone;			// element of the sensor relative to the primary element
+	uint8_t boot;			// boot count (wraps), the uptime restarts at every boot
+}sample_log_record_t;
+
+esp_err_t sample_log_init(void);
+esp_err_t sample_log_append(uint8_t zone, uint16_t property_id, int32_t value);
+uint16_t sample_log_read(uint32_t *sequence, uint32_t end, sample_log_record_t *records, uint16_t max);
+void sample_log_range(uint32_t *first, uint32_t *next);
+uint8_t sample_log_boot(void);
+uint32_t sample_log_dropped(void);
+
+#endif /* MAIN_COMPONENTS_SAMPLE_LOG_H_ */
@@ -0,0 +1,221 @@
+/*
+ * scheduler.c
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "scheduler.h"
+#include "i2c_bus.h"
+
+#define TAG "SCHEDULER"
+
+#define US_TO_TICKS_CEIL(us)	((TickType_t)(((us) * configTICK_RATE_HZ + 999999) / 1000000))
+
+static const sensor_driver_t *drivers;
+static uint8_t driver_count;
+static int64_t next_due_us[SCHEDULER_MAX_SENSORS];
+static scheduler_stats_t stats[SCHEDULER_MAX_SENSORS];
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t stats_period_us;
+static int64_t next_stats_us;
+static i2c_bus_stats_t last_bus_stats[I2C_NUM_MAX];
+
+/* Readings of all sensors for the publisher, deep enough for one round of every sensor */
+static QueueHandle_t reading_queue = NULL;
+
+static void scheduler_read(uint8_t index, int64_t due_us)
+/* Reads one sensor and hands the value to the publisher, due_us is 0 for reads triggered by a new SHT35 sample */
+{
+	sensor_reading_t reading = {.index = index};
+	int64_t start, end;
+	_Bool dropped = false;
+	esp_err_t err;
+
+	start = esp_timer_get_time();
+	err = drivers[index].read(drivers[index].channel, &reading.value);
+	end = esp_timer_get_time();
+
+	if(err == ESP_OK)
+	{
+		reading.timestamp = xTaskGetTickCount();
+		dropped = xQueueSend(reading_queue, &reading, 0) != pdTRUE;
+	}
+
+	taskENTER_CRITICAL(&stats_lock);
+	stats[index].reads++;
+	if(err != ESP_OK)
+		stats[index].errors++;
+	if(dropped)
+		stats[index].dropped++;
+	if(due_us != 0)
+	{
+		stats[index].last_jitter_us = start - due_us;
+		if(stats[index].last_jitter_us > stats[index].max_jitter_us)
+			stats[index].max_jitter_us = stats[index].last_jitter_us;
+	}
+	if(end - start > stats[index].max_duration_us)
+		stats[index].max_duration_us = end - start;
+	taskEXIT_CRITICAL(&stats_lock);
+}
+
+static int64_t scheduler_read_due(void)
+/* Runs every timed read that is due, returns the time of the next one (INT64_MAX when there is none) */
+{
+	int64_t next = INT64_MAX;
+	int64_t period_us, now, skipped;
+	uint8_t i;
+
+	for(i = 0; i < driver_count; i++)
+	{
+		if(drivers[i].read_period_ms == 0)
+			continue;
+
+		period_us = (int64_t)drivers[i].read_period_ms * 1000;
+		if(esp_timer_get_time() >= next_due_us[i])
+		{
+			scheduler_read(i, next_due_us[i]);
+			next_due_us[i] += period_us;
+
+			/* A read that starts more than a period late skips the missed periods instead of catching up in a burst */
+			now = esp_timer_get_time();
+			if(next_due_us[i] <= now)
+			{
+				skipped = (now - next_due_us[i]) / period_us + 1;
+				next_due_us[i] += skipped * period_us;
+				taskENTER_CRITICAL(&stats_lock);
+				stats[i].overruns += skipped;
+				taskEXIT_CRITICAL(&stats_lock);
+			}
+		}
+		if(next_due_us[i] < next)
+			next = next_due_us[i];
+	}
+	return next;
+}
+
+static void scheduler_log_stats(void)
+/* Per sensor timing and the utilisation of every I2C bus since the previous log */
+{
+	scheduler_stats_t sensor_stats;
+	i2c_bus_stats_t bus_stats;
+	uint32_t utilisation;
+	int64_t elapsed;
+	uint8_t i;
+
+	for(i = 0; i < driver_count; i++)
+	{
+		scheduler_get_stats(i, &sensor_stats);
+		ESP_LOGI(TAG, "%s: reads %u errors %u dropped %u overruns %u jitter %u us (max %u us) duration max %u us",
+				drivers[i].name, sensor_stats.reads, sensor_stats.errors, sensor_stats.dropped, sensor_stats.overruns,
+				sensor_stats.last_jitter_us, sensor_stats.max_jitter_us, sensor_stats.max_duration_us);
+	}
+
+	for(i = 0; i < I2C_NUM_MAX; i++)
+	{
+		if(i2c_bus_get_stats(i, &bus_stats) != ESP_OK)
+			continue;
+
+		if(last_bus_stats[i].started_us == 0)
+			last_bus_stats[i].started_us = bus_stats.started_us;
+		elapsed = esp_timer_get_time() - last_bus_stats[i].started_us;
+		utilisation = elapsed > 0 ? (bus_stats.busy_us - last_bus_stats[i].busy_us) * 1000 / elapsed : 0;
+		ESP_LOGI(TAG, "I2C%u: utilisation %u.%u %% transactions %u errors %u queued max %u wait max %u us",
+				i, utilisation / 10, utilisation % 10, bus_stats.transactions, bus_stats.errors,
+				bus_stats.max_queued, bus_stats.max_wait_us);
+
+		last_bus_stats[i] = bus_stats;
+		last_bus_stats[i].started_us = esp_timer_get_time();
+	}
+}
+
+static void scheduler_task(void *arg)
+{
+	sensor_sample_t sample;
+	TickType_t wait_ticks = 0;
+	int64_t next, now;
+	uint8_t i;
+
+	while(1)
+	{
+		/* New SHT35 samples wake the scheduler as well as the timed reads, a sample only triggers the
+		 * reads of the sensors on its own channel */
+		if(acquisition_receive(&sample, wait_ticks) == pdTRUE)
+		{
+			sensors_update_sample(&sample);
+			for(i = 0; i < driver_count; i++)
+			{
+				if(drivers[i].read_period_ms == 0 && drivers[i].channel == sample.device)
+					scheduler_read(i, 0);
+			}
+		}
+
+		next = scheduler_read_due();
+
+		now = esp_timer_get_time();
+		if(stats_period_us > 0)
+		{
+			if(now >= next_stats_us)
+			{
+				scheduler_log_stats();
+				next_stats_us += stats_period_us;
+			}
+			if(next_stats_us < next)
+				next = next_stats_us;
+		}
+
+		if(next == INT64_MAX)
+			wait_ticks = portMAX_DELAY;
+		else
+			wait_ticks = next > now ? US_TO_TICKS_CEIL(next - now) : 0;
+	}
+}
+
+esp_err_t scheduler_start(const sensor_driver_t *sensor_drivers, uint8_t count, uint32_t stats_period_ms)
+/* Starts reading every sensor at its own period, the acquisition has to be started first.
+ * Timing counters are logged every stats_period_ms, 0 disables the log */
+{
+	int64_t now = esp_timer_get_time();
+	uint8_t i;
+
+	if(reading_queue != NULL)
+		return ESP_ERR_INVALID_STATE;
+	if(count > SCHEDULER_MAX_SENSORS)
+		return ESP_ERR_INVALID_ARG;
+
+	drivers = sensor_drivers;
+	driver_count = count;
+	for(i = 0; i < count; i++)
+		next_due_us[i] = now;
+	stats_period_us = (int64_t)stats_period_ms * 1000;
+	next_stats_us = now + stats_period_us;
+
+	reading_queue = xQueueCreate(2 * count, sizeof(sensor_reading_t));
+	if(reading_queue == NULL)
+		return ESP_ERR_NO_MEM;
+
+	if(xTaskCreate(scheduler_task, "scheduler", SCHEDULER_TASK_STACK_SIZE, NULL, SCHEDULER_TASK_PRIORITY, NULL) != pdPASS)
+		return ESP_ERR_NO_MEM;
+
+	return ESP_OK;
+}
+
+BaseType_t scheduler_receive(sensor_reading_t *reading, TickType_t ticks_to_wait)
+/* Waits up to ticks_to_wait for the next sensor reading */
+{
+	return xQueueReceive(reading_queue, reading, ticks_to_wait);
+}
+
+esp_err_t scheduler_get_stats(uint8_t index, scheduler_stats_t *sensor_stats)
+{
+	if(index >= driver_count)
+		return ESP_ERR_INVALID_ARG;
+
+	taskENTER_CRITICAL(&stats_lock);
+	*sensor_stats = stats[index];
+	taskEXIT_CRITICAL(&stats_lock);
+
+	return ESP_OK;
+}
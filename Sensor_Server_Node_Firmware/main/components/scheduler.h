@@ -0,0 +1,40 @@
+/*
+ * scheduler.h
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_SCHEDULER_H_
+#define MAIN_COMPONENTS_SCHEDULER_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "sensors.h"
+
+#define SCHEDULER_TASK_STACK_SIZE	3072
+#define SCHEDULER_TASK_PRIORITY		5
+#define SCHEDULER_MAX_SENSORS		16
+
+// Value of one sensor handed from the scheduler to the publisher
+typedef struct{
+	uint8_t index;			// index of the sensor in the driver table
+	int32_t value;
+	TickType_t timestamp;	// tick count at which the value was read
+}sensor_reading_t;
+
+// Timing counters of one sensor driver
+typedef struct{
+	uint32_t reads;				// completed reads
+	uint32_t errors;			// reads that did not return ESP_OK
+	uint32_t dropped;			// readings lost because the publisher queue was full
+	uint32_t overruns;			// periods skipped because a read started more than a period late
+	uint32_t last_jitter_us;	// delay of the last read after its due time
+	uint32_t max_jitter_us;		// largest delay of a read after its due time
+	uint32_t max_duration_us;	// longest time a read took
+}scheduler_stats_t;
+
+esp_err_t scheduler_start(const sensor_driver_t *sensor_drivers, uint8_t count, uint32_t stats_period_ms);
+BaseType_t scheduler_receive(sensor_reading_t *reading, TickType_t ticks_to_wait);
+esp_err_t scheduler_get_stats(uint8_t index, scheduler_stats_t *sensor_stats);
+
+#endif /* MAIN_COMPONENTS_SCHEDULER_H_ */
@@ -0,0 +1,116 @@
+/*
+ * sensor_registry.h
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_SENSOR_REGISTRY_H_
+#define MAIN_COMPONENTS_SENSOR_REGISTRY_H_
+
+#include "sdkconfig.h"
+#include "esp_ble_mesh_sensor_model_api.h"
+#include "sensors.h"
+
+/* Every sensor property of the node. The sensor states, their raw value and cadence buffers,
+ * the descriptors and the layout of the marshalled Sensor Status are all generated from this list.
+ *
+ * SENSOR(name, zone, property ID, data format, raw value length, signed, read function, channel, read period ms,
+ *        histogram low, histogram bin width, coarse property ID, coarse step)
+ *
+ * Every zone is an element with its own Sensor Server, so the same property ID can be reported
+ * once per zone. The entries of a zone must follow each other, zone 0 is the primary element.
+ * A read period of 0 reads the property on every new sample of SHT35 channel.
+ * The 16 histogram bins of the sensor history start at histogram low, both in raw value units.
+ * The last two give the one octet counterpart of the property (see encoding.h), the coarse value is sent under
+ * its own property ID so a client decodes it from the ID alone. Properties without a counterpart have 0 for both.
+ * The encoding is chosen per sensor through a Sensor Setting.
+ * Extra arguments of SENSOR_REGISTRY are appended to every SENSOR entry. */
+#define SENSOR_REGISTRY(SENSOR, ...) \
+	SENSOR_REGISTRY_SHT35(SENSOR, 0, ##__VA_ARGS__) \
+	SENSOR_REGISTRY_INPUT_VOLTAGE(SENSOR, ##__VA_ARGS__) \
+	SENSOR_REGISTRY_ZONE_1(SENSOR, ##__VA_ARGS__) \
+	SENSOR_REGISTRY_ZONE_2(SENSOR, ##__VA_ARGS__) \
+	SENSOR_REGISTRY_ZONE_3(SENSOR, ##__VA_ARGS__)
+
+/* Temperature and humidity of the SHT35 of a zone, the SHT35 channel is the zone */
+#define SENSOR_REGISTRY_SHT35(SENSOR, zone, ...) \
+	/* Precise Present Ambient Temperature, 0.01 C */ \
+	SENSOR(temperature_##zone, zone, 0x0075, ESP_BLE_MESH_SENSOR_DATA_FORMAT_A, 2, true, sensors_read_temperature, zone, 0, \
+			-2000, 500, 0x004F, 50, ##__VA_ARGS__) /* -20 to 60 C in 5 C bins, 0x004F Temperature 8 */ \
+	/* Present Indoor Relative Humidity, 0.01 % */ \
+	SENSOR(humidity_##zone, zone, 0x00A7, ESP_BLE_MESH_SENSOR_DATA_FORMAT_A, 2, false, sensors_read_humidity, zone, 0, \
+			0, 625, 0, 0, ##__VA_ARGS__) /* 0 to 100 % in 6.25 % bins */
+
+#if CONFIG_SENSOR_INPUT_VOLTAGE
+/* Present Input Voltage, 1/64 V */
+#define SENSOR_REGISTRY_INPUT_VOLTAGE(SENSOR, ...) \
+	SENSOR(input_voltage, 0, 0x0059, ESP_BLE_MESH_SENSOR_DATA_FORMAT_A, 2, false, sensors_read_input_voltage, 0, \
+			CONFIG_SENSOR_INPUT_VOLTAGE_PERIOD_MS, 0, 96, 0, 0, ##__VA_ARGS__) /* 0 to 24 V in 1.5 V bins */
+#else
+#define SENSOR_REGISTRY_INPUT_VOLTAGE(SENSOR, ...)
+#endif
+
+/* Present Ambient Noise (1 dB) has no driver on this board, with one it is added as
+ * SENSOR(noise, 0, 0x0079, ESP_BLE_MESH_SENSOR_DATA_FORMAT_A, 1, false, sensors_read_noise, 0, 1000, 0, 8, 0, 0) */
+
+/* Every SHT35 of the node, one per zone. The first two share the bus of I2C_MASTER_NUM,
+ * the next two are on a second bus on targets that have one.
+ *
+ * SHT35(zone, I2C port, address, ALERT pin GPIO)
+ *
+ * SHT35_REGISTRY_ZONES only lists the zones after the primary one. */
+#define SHT35_REGISTRY(SHT35) \
+	SHT35(0, I2C_MASTER_NUM, SHT35_SENSOR_ADDR, SHT35_ALERT_GPIO_0) \
+	SHT35_REGISTRY_ZONES(SHT35)
+
+#define SHT35_REGISTRY_ZONES(SHT35) \
+	SHT35_REGISTRY_ZONE_1(SHT35) \
+	SHT35_REGISTRY_ZONE_2(SHT35) \
+	SHT35_REGISTRY_ZONE_3(SHT35)
+
+#if CONFIG_SENSOR_ACQUISITION_ALERT
+#define SHT35_ALERT_GPIO_0	CONFIG_SHT35_ALERT_GPIO
+#else
+#define SHT35_ALERT_GPIO_0	GPIO_NUM_NC
+#endif
+
+#if CONFIG_SHT35_SENSOR_COUNT > 1
+#define SENSOR_REGISTRY_ZONE_1(SENSOR, ...)	SENSOR_REGISTRY_SHT35(SENSOR, 1, ##__VA_ARGS__)
+#define SHT35_REGISTRY_ZONE_1(SHT35)	SHT35(1, I2C_MASTER_NUM, SHT35_SENSOR_ADDR_ALT, SHT35_ALERT_GPIO_1)
+#if CONFIG_SENSOR_ACQUISITION_ALERT
+#define SHT35_ALERT_GPIO_1	CONFIG_SHT35_ALERT_GPIO_1
+#else
+#define SHT35_ALERT_GPIO_1	GPIO_NUM_NC
+#endif
+#else
+#define SENSOR_REGISTRY_ZONE_1(SENSOR, ...)
+#define SHT35_REGISTRY_ZONE_1(SHT35)
+#endif
+
+#if CONFIG_SHT35_SENSOR_COUNT > 2
+#define SENSOR_REGISTRY_ZONE_2(SENSOR, ...)	SENSOR_REGISTRY_SHT35(SENSOR, 2, ##__VA_ARGS__)
+#define SHT35_REGISTRY_ZONE_2(SHT35)	SHT35(2, I2C_NUM_1, SHT35_SENSOR_ADDR, SHT35_ALERT_GPIO_2)
+#if CONFIG_SENSOR_ACQUISITION_ALERT
+#define SHT35_ALERT_GPIO_2	CONFIG_SHT35_ALERT_GPIO_2
+#else
+#define SHT35_ALERT_GPIO_2	GPIO_NUM_NC
+#endif
+#else
+#define SENSOR_REGISTRY_ZONE_2(SENSOR, ...)
+#define SHT35_REGISTRY_ZONE_2(SHT35)
+#endif
+
+#if CONFIG_SHT35_SENSOR_COUNT > 3
+#define SENSOR_REGISTRY_ZONE_3(SENSOR, ...)	SENSOR_REGISTRY_SHT35(SENSOR, 3, ##__VA_ARGS__)
+#define SHT35_REGISTRY_ZONE_3(SHT35)	SHT35(3, I2C_NUM_1, SHT35_SENSOR_ADDR_ALT, SHT35_ALERT_GPIO_3)
+#if CONFIG_SENSOR_ACQUISITION_ALERT
+#define SHT35_ALERT_GPIO_3	CONFIG_SHT35_ALERT_GPIO_3
+#else
+#define SHT35_ALERT_GPIO_3	GPIO_NUM_NC
+#endif
+#else
+#define SENSOR_REGISTRY_ZONE_3(SENSOR, ...)
+#define SHT35_REGISTRY_ZONE_3(SHT35)
+#endif
+
+#endif /* MAIN_COMPONENTS_SENSOR_REGISTRY_H_ */
@@ -0,0 +1,81 @@
+/*
+ * sensors.c
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#include "sdkconfig.h"
+#include "sensors.h"
+
+#if CONFIG_SENSOR_INPUT_VOLTAGE
+#include "driver/adc.h"
+#include "esp_adc_cal.h"
+
+static esp_adc_cal_characteristics_t adc_characteristics;
+#endif
+
+static sensor_sample_t latest_samples[ACQUISITION_MAX_DEVICES];
+static _Bool has_sample[ACQUISITION_MAX_DEVICES];
+
+esp_err_t sensors_init(void)
+/* Prepares the drivers of the sensors that are not read by the acquisition task */
+{
+#if CONFIG_SENSOR_INPUT_VOLTAGE
+	esp_err_t err;
+
+	err = adc1_config_width(ADC_WIDTH_BIT_12);
+	if(err)
+		return err;
+	err = adc1_config_channel_atten(CONFIG_SENSOR_INPUT_VOLTAGE_ADC_CHANNEL, ADC_ATTEN_DB_11);
+	if(err)
+		return err;
+	esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &adc_characteristics);
+#endif
+	return ESP_OK;
+}
+
+void sensors_update_sample(const sensor_sample_t *sample)
+/* Latest result of one SHT35, the temperature and humidity reads of its channel return its values */
+{
+	if(sample->device >= ACQUISITION_MAX_DEVICES)
+		return;
+	latest_samples[sample->device] = *sample;
+	has_sample[sample->device] = true;
+}
+
+esp_err_t sensors_read_temperature(uint8_t channel, int32_t *value)
+{
+	if(channel >= ACQUISITION_MAX_DEVICES || !has_sample[channel])
+		return ESP_ERR_INVALID_STATE;
+	*value = latest_samples[channel].temperature;
+	return ESP_OK;
+}
+
+esp_err_t sensors_read_humidity(uint8_t channel, int32_t *value)
+{
+	if(channel >= ACQUISITION_MAX_DEVICES || !has_sample[channel])
+		return ESP_ERR_INVALID_STATE;
+	*value = latest_samples[channel].humidity;
+	return ESP_OK;
+}
+
+esp_err_t sensors_read_input_voltage(uint8_t channel, int32_t *value)
+/* Voltage characteristic in 1/64 V, measured behind a resistor divider */
+{
+#if CONFIG_SENSOR_INPUT_VOLTAGE
+	uint32_t millivolt;
+	esp_err_t err;
+
+	(void)channel;
+	err = esp_adc_cal_get_voltage((adc_channel_t)CONFIG_SENSOR_INPUT_VOLTAGE_ADC_CHANNEL, &adc_characteristics, &millivolt);
+	if(err)
+		return err;
+	millivolt = millivolt * CONFIG_SENSOR_INPUT_VOLTAGE_DIVIDER_X100 / 100;
+	*value = (millivolt * 64 + 500) / 1000;
+	return ESP_OK;
+#else
+	(void)channel;
+	(void)value;
+	return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
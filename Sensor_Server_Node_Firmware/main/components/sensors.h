@@ -0,0 +1,33 @@
+/*
+ * sensors.h
+ *
+ *  Created on: 16 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_SENSORS_H_
+#define MAIN_COMPONENTS_SENSORS_H_
+
+#include "esp_err.h"
+#include "acquisition.h"
+
+// Reads the present value of a sensor property in the unit of its characteristic,
+// channel selects the device when there are several (the SHT35 index for temperature and humidity)
+typedef esp_err_t (*sensor_read_t)(uint8_t channel, int32_t *value);
+
+// Static description of one sensor property, generated from SENSOR_REGISTRY
+typedef struct{
+	const char *name;
+	sensor_read_t read;
+	uint8_t channel;			// passed to read
+	uint32_t read_period_ms;	// 0: read on every new sample of SHT35 channel
+	_Bool is_signed;			// raw value is a signed integer
+}sensor_driver_t;
+
+esp_err_t sensors_init(void);
+void sensors_update_sample(const sensor_sample_t *sample);
+
+esp_err_t sensors_read_temperature(uint8_t channel, int32_t *value);
+esp_err_t sensors_read_humidity(uint8_t channel, int32_t *value);
+esp_err_t sensors_read_input_voltage(uint8_t channel, int32_t *value);
+
+#endif /* MAIN_COMPONENTS_SENSORS_H_ */
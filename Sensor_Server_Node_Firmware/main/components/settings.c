@@ -0,0 +1,50 @@
+/*
+ * settings.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "nvs.h"
+#include "settings.h"
+
+/* Sensor Settings changed over the mesh are kept in NVS so they survive a reboot, every key holds one blob.
+ * NVS has to be initialised with nvs_flash_init first */
+
+esp_err_t settings_load(const char *key, void *data, size_t length)
+/* Fills data with the stored blob, ESP_ERR_NVS_NOT_FOUND when there is none and ESP_ERR_INVALID_SIZE when
+ * it was stored with another length. data is left as it was on an error */
+{
+	nvs_handle_t handle;
+	size_t stored_length = 0;
+	esp_err_t err;
+
+	err = nvs_open(SETTINGS_NAMESPACE, NVS_READONLY, &handle);
+	if(err != ESP_OK)
+		return err;
+
+	err = nvs_get_blob(handle, key, NULL, &stored_length);
+	if(err == ESP_OK && stored_length != length)
+		err = ESP_ERR_INVALID_SIZE;
+	if(err == ESP_OK)
+		err = nvs_get_blob(handle, key, data, &length);
+
+	nvs_close(handle);
+	return err;
+}
+
+esp_err_t settings_store(const char *key, const void *data, size_t length)
+{
+	nvs_handle_t handle;
+	esp_err_t err;
+
+	err = nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &handle);
+	if(err != ESP_OK)
+		return err;
+
+	err = nvs_set_blob(handle, key, data, length);
+	if(err == ESP_OK)
+		err = nvs_commit(handle);
+
+	nvs_close(handle);
+	return err;
+}
@@ -0,0 +1,18 @@
+/*
+ * settings.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_SETTINGS_H_
+#define MAIN_COMPONENTS_SETTINGS_H_
+
+#include <stddef.h>
+#include "esp_err.h"
+
+#define SETTINGS_NAMESPACE		"sensor"
+
+esp_err_t settings_load(const char *key, void *data, size_t length);
+esp_err_t settings_store(const char *key, const void *data, size_t length);
+
+#endif /* MAIN_COMPONENTS_SETTINGS_H_ */
@@ -0,0 +1,129 @@
+/*
+ * telemetry.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <string.h>
+#include "esp_timer.h"
+#include "telemetry.h"
+
+/* A Sensor Status of two properties fits one unsegmented network PDU, but every sample costs a PDU and
+ * its relays. A batch sends a number of samples in one segmented message instead: 8 samples of temperature
+ * and humidity take some 35 octets, 4 segments where 8 Sensor Status messages would be needed. Samples
+ * of a sensor change little from one to the next, so the deltas mostly fit a single octet. */
+
+#define TELEMETRY_VARINT_MAX_LEN	5
+
+static inline uint32_t telemetry_zigzag(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t telemetry_delta(int32_t value, int32_t previous)
+/* Wraps instead of overflowing, the decoder wraps back */
+{
+	return (int32_t)((uint32_t)value - (uint32_t)previous);
+}
+
+static uint8_t telemetry_varint_len(uint32_t value)
+{
+	uint8_t length = 1;
+
+	while(value >= 0x80)
+	{
+		value >>= 7;
+		length++;
+	}
+	return length;
+}
+
+static uint16_t telemetry_varint_write(uint32_t value, uint8_t *data)
+{
+	uint16_t length = 0;
+
+	while(value >= 0x80)
+	{
+		data[length++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	data[length++] = value;
+	return length;
+}
+
+static uint16_t telemetry_sample_len(const telemetry_batch_t *batch, uint8_t sample)
+/* Octets sample adds to the batch: its time and the value of every property */
+{
+	uint16_t length;
+	uint8_t i;
+
+	if(sample == 0)
+	{
+		length = telemetry_varint_len(batch->times[0]);
+		for(i = 0; i < batch->property_count; i++)
+			length += telemetry_varint_len(telemetry_zigzag(batch->values[i][0]));
+		return length;
+	}
+
+	length = telemetry_varint_len(batch->times[sample] - batch->times[sample - 1]);
+	for(i = 0; i < batch->property_count; i++)
+		length += telemetry_varint_len(telemetry_zigzag(
+				telemetry_delta(batch->values[i][sample], batch->values[i][sample - 1])));
+	return length;
+}
+
+esp_err_t telemetry_init(telemetry_batch_t *batch, uint8_t zone, const uint16_t *property_ids, uint8_t property_count, uint8_t size)
+{
+	if(property_count == 0 || property_count > TELEMETRY_MAX_PROPERTIES || size == 0 || size > TELEMETRY_MAX_SAMPLES)
+		return ESP_ERR_INVALID_ARG;
+
+	memset(batch, 0, sizeof(telemetry_batch_t));
+	batch->zone = zone;
+	batch->property_count = property_count;
+	batch->size = size;
+	memcpy(batch->property_ids, property_ids, property_count * sizeof(property_ids[0]));
+	return ESP_OK;
+}
+
+_Bool telemetry_add(telemetry_batch_t *batch, const int32_t *values)
+/* Adds one value of every property, in the order of the property IDs. Returns true when the batch has
+ * to be sent: it holds size samples or one more might not fit in a message */
+{
+	uint8_t i;
+
+	if(batch->count == 0)
+		batch->length = 2 + batch->property_count * 2;
+
+	batch->times[batch->count] = esp_timer_get_time() / 100000;
+	for(i = 0; i < batch->property_count; i++)
+		batch->values[i][batch->count] = values[i];
+	batch->length += telemetry_sample_len(batch, batch->count);
+	batch->count++;
+
+	return batch->count >= batch->size
+			|| batch->length + (1 + batch->property_count) * TELEMETRY_VARINT_MAX_LEN > TELEMETRY_MAX_LEN;
+}
+
+uint16_t telemetry_encode(telemetry_batch_t *batch, uint8_t *data)
+/* Writes the batch message into data, which holds TELEMETRY_MAX_LEN octets, and empties the batch */
+{
+	uint16_t length = 0;
+	uint8_t i, j;
+
+	data[length++] = batch->zone;
+	data[length++] = batch->count;
+	for(j = 0; j < batch->count; j++)
+		length += telemetry_varint_write(j == 0 ? batch->times[0] : batch->times[j] - batch->times[j - 1], data + length);
+
+	for(i = 0; i < batch->property_count; i++)
+	{
+		data[length++] = batch->property_ids[i];
+		data[length++] = batch->property_ids[i] >> 8;
+		for(j = 0; j < batch->count; j++)
+			length += telemetry_varint_write(telemetry_zigzag(j == 0 ? batch->values[i][0] :
+					telemetry_delta(batch->values[i][j], batch->values[i][j - 1])), data + length);
+	}
+
+	batch->count = 0;
+	return length;
+}
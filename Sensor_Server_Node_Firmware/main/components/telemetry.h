@@ -0,0 +1,43 @@
+/*
+ * telemetry.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MAIN_COMPONENTS_TELEMETRY_H_
+#define MAIN_COMPONENTS_TELEMETRY_H_
+
+#include "freertos/FreeRTOS.h"
+#include "esp_ble_mesh_defs.h"
+#include "backfill.h"
+
+#define TELEMETRY_MAX_SAMPLES		32
+#define TELEMETRY_MAX_PROPERTIES	4		// sensors of one zone
+#define TELEMETRY_MAX_LEN			377		// 384 octet segmented message less the opcode and the TransMIC
+
+#define TELEMETRY_MODEL_ID_SERVER	0x0012	// vendor model of BACKFILL_CID, only publishes
+
+/* Batch of samples of one zone, published by the telemetry server model. Varints are little endian base 128,
+ * signed values are zigzag encoded first
+ * zone (1), number of samples n (1)
+ * uptime of the first sample in 100 ms (varint), n - 1 intervals to the sample before in 100 ms (varint)
+ * per property: property ID (2), first value (signed varint), n - 1 deltas to the value before (signed varint) */
+#define TELEMETRY_OP_BATCH			ESP_BLE_MESH_MODEL_OP_3(0x05, BACKFILL_CID)
+
+// Samples of the sensors of one zone waiting to be sent
+typedef struct{
+	uint8_t zone;
+	uint8_t property_count;
+	uint8_t size;							// samples per batch
+	uint8_t count;							// samples collected
+	uint16_t length;						// encoded length of the samples collected
+	uint16_t property_ids[TELEMETRY_MAX_PROPERTIES];
+	uint32_t times[TELEMETRY_MAX_SAMPLES];	// uptime in 100 ms
+	int32_t values[TELEMETRY_MAX_PROPERTIES][TELEMETRY_MAX_SAMPLES];
+}telemetry_batch_t;
+
+esp_err_t telemetry_init(telemetry_batch_t *batch, uint8_t zone, const uint16_t *property_ids, uint8_t property_count, uint8_t size);
+_Bool telemetry_add(telemetry_batch_t *batch, const int32_t *values);
+uint16_t telemetry_encode(telemetry_batch_t *batch, uint8_t *data);
+
+#endif /* MAIN_COMPONENTS_TELEMETRY_H_ */
@@ -8,9 +8,13 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
 #include "nvs_flash.h"
 
 #include "esp_ble_mesh_defs.h"
@@ -19,38 +23,97 @@
 #include "esp_ble_mesh_provisioning_api.h"
 #include "esp_ble_mesh_config_model_api.h"
 #include "esp_ble_mesh_sensor_model_api.h"
+#if defined(CONFIG_BLE_MESH_LOW_POWER)
+#include "esp_ble_mesh_low_power_api.h"
+#endif
 
 #include "ble_mesh_example_init.h"
 
-#include "components/LED.h"
+#include "components/indicator.h"
 #include "driver/i2c.h"
 #include "components/commands.h"
 #include "components/communication.h"
+#include "components/acquisition.h"
+#include "components/cadence.h"
+#include "components/sensors.h"
+#include "components/scheduler.h"
+#include "components/sensor_registry.h"
+#include "components/sample_log.h"
+#include "components/backfill.h"
+#include "components/history.h"
+#include "components/telemetry.h"
+#include "components/encoding.h"
+#include "components/settings.h"
+#include "components/coalesce.h"
 
 #define TAG "MAIN"
 #define DATA_TAG "DATA"
 
 #define CID_ESP     0x02E5
 
-/* Sensor Property ID */
-#define SENSOR_PROPERTY_ID_0        0x0075  /* Precise Ambient Temperature */
-#define SENSOR_PROPERTY_ID_1        0x00A7  /* Present Indoor Relative Humidity, */
-#define SENSOR_PROPERTY_ID_2		0x0079	/* Present Ambient Noise */
-#define SENSOR_PROPERTY_ID_3		0x0059  /* Present Input Voltage */
+#define POWER_MIN_FREQ_MHZ  40
 
-/* The characteristic of the two device properties is "Temperature 8", which is
- * used to represent a measure of temperature with a unit of 0.5 degree Celsius.
- * Minimum value: -64.0, maximum value: 63.5.
- * A value of 0xFF represents 'value is not known'.
- */
+#if defined(CONFIG_SHT35_REPEATABILITY_LOW)
+#define SENSOR_REPEATABILITY        LOW_REPEATABILITY
+#elif defined(CONFIG_SHT35_REPEATABILITY_MEDIUM)
+#define SENSOR_REPEATABILITY        MEDIUM_REPEATABILITY
+#else
+#define SENSOR_REPEATABILITY        HIGH_REPEATABILITY
+#endif
+
+#if defined(CONFIG_SENSOR_ACQUISITION_PERIODIC)
+#define SENSOR_ACQUISITION_MODE     PERIODIC_MODE
+#define SENSOR_FILTER_DEPTH         CONFIG_SENSOR_FILTER_DEPTH
+#elif defined(CONFIG_SENSOR_ACQUISITION_ALERT)
+#define SENSOR_ACQUISITION_MODE     ALERT_MODE
+#define SENSOR_FILTER_DEPTH         1
+#else
+#define SENSOR_ACQUISITION_MODE     SINGLE_SHOT_MODE
+#define SENSOR_FILTER_DEPTH         1
+#endif
+
+#if defined(CONFIG_SENSOR_ACQUISITION_ALERT)
+#define SENSOR_TEMPERATURE_DELTA    CONFIG_SENSOR_ALERT_TEMPERATURE_DELTA
+#define SENSOR_HUMIDITY_DELTA       CONFIG_SENSOR_ALERT_HUMIDITY_DELTA
+#define SENSOR_HEARTBEAT_PERIOD_MS  (CONFIG_SENSOR_HEARTBEAT_PERIOD_S * 1000)
+#else
+#define SENSOR_TEMPERATURE_DELTA    0
+#define SENSOR_HUMIDITY_DELTA       0
+#define SENSOR_HEARTBEAT_PERIOD_MS  0
+#endif
+
+#if defined(CONFIG_SHT35_PERIODIC_HZ5)
+#define SENSOR_PERIODIC_FREQUENCY   FREQUENCY_HZ5
+#elif defined(CONFIG_SHT35_PERIODIC_1HZ)
+#define SENSOR_PERIODIC_FREQUENCY   FREQUENCY_1HZ
+#elif defined(CONFIG_SHT35_PERIODIC_2HZ)
+#define SENSOR_PERIODIC_FREQUENCY   FREQUENCY_2HZ
+#elif defined(CONFIG_SHT35_PERIODIC_4HZ)
+#define SENSOR_PERIODIC_FREQUENCY   FREQUENCY_4HZ
+#else
+#define SENSOR_PERIODIC_FREQUENCY   FREQUENCY_10HZ
+#endif
 
+#if defined(CONFIG_SENSOR_FILTER_MEDIAN)
+#define SENSOR_FILTER               FILTER_MEDIAN
+#elif defined(CONFIG_SENSOR_FILTER_CIC)
+#define SENSOR_FILTER               FILTER_CIC
+#else
+#define SENSOR_FILTER               FILTER_MOVING_AVERAGE
+#endif
 
-static int16_t indoor_temp = 0;			/* 16 bit signed scalar (Resolution: 0.01 C) */
-static uint16_t indoor_humidity = 0;    /* 16 bit unsigned scalar (Resolution: 0.01 %) */
-//static uint8_t indoor_noise_level = 0;  /* 8 bit unsigned scalar (Resolution: 1 dB) */
-//static uint16_t input_voltage = 0;		/* 16 bit unsigned scalar (Resolution: 1/64 V) */
+#if defined(CONFIG_SENSOR_SERIES_VALUE)
+#define SENSOR_SERIES               HISTORY_SERIES_VALUE
+#else
+#define SENSOR_SERIES               HISTORY_SERIES_TIME
+#endif
 
 static int8_t HAS_APPKEY = false;   /* Flag is true when device is provisioned and has AppKey*/
+static _Bool mesh_state_restored = false;    /* Provisioned before the reset, the state came from flash */
+
+#if defined(CONFIG_BLE_MESH_LOW_POWER)
+static uint16_t lpn_friend_addr = ESP_BLE_MESH_ADDR_UNASSIGNED;    /* Friend polled by this Low Power Node */
+#endif
 
 #define SENSOR_POSITIVE_TOLERANCE   ESP_BLE_MESH_SENSOR_UNSPECIFIED_POS_TOLERANCE
 #define SENSOR_NEGATIVE_TOLERANCE   ESP_BLE_MESH_SENSOR_UNSPECIFIED_NEG_TOLERANCE
@@ -58,10 +121,19 @@ static int8_t HAS_APPKEY = false;   /* Flag is true when device is provisioned a
 #define SENSOR_MEASURE_PERIOD       ESP_BLE_MESH_SENSOR_NOT_APPL_MEASURE_PERIOD
 #define SENSOR_UPDATE_INTERVAL      ESP_BLE_MESH_SENSOR_NOT_APPL_UPDATE_INTERVAL
 
+/* Role of the node in its device UUID, after the match prefix and the Bluetooth address.
+ * The provisioner configures the node from the template of the role */
+#define NODE_ROLE_UUID_OFFSET   (2 + BD_ADDR_LEN)
+#define NODE_ROLE               0x01    /* sensor */
+
 static uint8_t dev_uuid[ESP_BLE_MESH_OCTET16_LEN] = { 0x32, 0x10 };
 
 static esp_ble_mesh_cfg_srv_t config_server = {
+#if defined(CONFIG_BLE_MESH_RELAY)
     .relay = ESP_BLE_MESH_RELAY_ENABLED,
+#else
+    .relay = ESP_BLE_MESH_RELAY_NOT_SUPPORTED,
+#endif
     .beacon = ESP_BLE_MESH_BEACON_ENABLED,
 #if defined(CONFIG_BLE_MESH_FRIEND)
     .friend_state = ESP_BLE_MESH_FRIEND_ENABLED,
@@ -79,75 +151,293 @@ static esp_ble_mesh_cfg_srv_t config_server = {
     .relay_retransmit = ESP_BLE_MESH_TRANSMIT(2, 20),
 };
 
-NET_BUF_SIMPLE_DEFINE_STATIC(sensor_data_0, 2);
-NET_BUF_SIMPLE_DEFINE_STATIC(sensor_data_1, 2); // Changed
+/* Index of every sensor in the tables generated from SENSOR_REGISTRY */
+#define SENSOR_ENUM(name, ...)      SENSOR_##name,
+enum {
+    SENSOR_REGISTRY(SENSOR_ENUM)
+    SENSOR_COUNT
+};
+
+/* Mesh Model Spec:
+ * Format A is limited to 1 to 16 octets of data and Property IDs below 0x0800.
+ */
+#define SENSOR_CHECK_FORMAT(name, zone, id, fmt, len, ...) \
+    _Static_assert((fmt) == ESP_BLE_MESH_SENSOR_DATA_FORMAT_B || ((len) <= 16 && (id) < 0x0800), \
+        "Sensor " #name " does not fit Format A");
+SENSOR_REGISTRY(SENSOR_CHECK_FORMAT)
+
+/* Raw value and Sensor Cadence state buffers of each sensor. Percentage trigger deltas are
+ * 2 octets, value trigger deltas and the fast cadence range have the format of the raw value. */
+#define SENSOR_DELTA_LEN(len)       ((len) > 2 ? (len) : 2)
+#define SENSOR_BUFFERS(name, zone, id, fmt, len, ...) \
+    NET_BUF_SIMPLE_DEFINE_STATIC(sensor_data_##name, len); \
+    NET_BUF_SIMPLE_DEFINE_STATIC(sensor_delta_down_##name, SENSOR_DELTA_LEN(len)); \
+    NET_BUF_SIMPLE_DEFINE_STATIC(sensor_delta_up_##name, SENSOR_DELTA_LEN(len)); \
+    NET_BUF_SIMPLE_DEFINE_STATIC(sensor_fast_low_##name, len); \
+    NET_BUF_SIMPLE_DEFINE_STATIC(sensor_fast_high_##name, len); \
+    static esp_ble_mesh_sensor_cadence_t sensor_cadence_##name = { \
+        .trigger_delta_down = &sensor_delta_down_##name, \
+        .trigger_delta_up = &sensor_delta_up_##name, \
+        .fast_cadence_low = &sensor_fast_low_##name, \
+        .fast_cadence_high = &sensor_fast_high_##name, \
+    };
+SENSOR_REGISTRY(SENSOR_BUFFERS)
+
+/* Mesh Model Spec:
+ * Sensor Property ID is a 2-octet value referencing a device property
+ * that describes the meaning and format of data reported by a sensor.
+ * 0x0000 is prohibited.
+ */
+#define SENSOR_STATE(name, zone, id, fmt, len, ...) \
+    [SENSOR_##name] = { \
+        .sensor_property_id = id, \
+        .cadence = &sensor_cadence_##name, \
+        .descriptor.positive_tolerance = SENSOR_POSITIVE_TOLERANCE, \
+        .descriptor.negative_tolerance = SENSOR_NEGATIVE_TOLERANCE, \
+        .descriptor.sampling_function = SENSOR_SAMPLE_FUNCTION, \
+        .descriptor.measure_period = SENSOR_MEASURE_PERIOD, \
+        .descriptor.update_interval = SENSOR_UPDATE_INTERVAL, \
+        .sensor_data.format = fmt, \
+        .sensor_data.length = (len) - 1, /* 0 represents the length is 1 */ \
+        .sensor_data.raw_value = &sensor_data_##name, \
+    },
+
+/* Every SHT35 is a zone, zone k is element k with its own Sensor Server and Sensor Setup Server */
+#define SENSOR_ZONE_ENUM(zone, ...) SENSOR_ZONE_##zone,
+enum {
+    SHT35_REGISTRY(SENSOR_ZONE_ENUM)
+    SENSOR_ZONE_COUNT
+};
+
+/* Number of sensors of a zone and the index of its first sensor, the sensors of the
+ * zones follow each other in ascending zone order */
+#define SENSOR_IN_ZONE(name, zone, id, fmt, len, is_signed, read, channel, read_period_ms, bin_low, bin_width, \
+        coarse_id, coarse_step, z) + ((zone) == (z))
+#define SENSOR_BEFORE_ZONE(name, zone, id, fmt, len, is_signed, read, channel, read_period_ms, bin_low, bin_width, \
+        coarse_id, coarse_step, z) + ((zone) < (z))
+#define SENSOR_ZONE_SIZE(z)         (0 SENSOR_REGISTRY(SENSOR_IN_ZONE, z))
+#define SENSOR_ZONE_FIRST(z)        (0 SENSOR_REGISTRY(SENSOR_BEFORE_ZONE, z))
 
-static esp_ble_mesh_sensor_state_t sensor_states[2] = {
+static esp_ble_mesh_sensor_state_t sensor_states[SENSOR_COUNT] = {
     /* Mesh Model Spec:
      * Multiple instances of the Sensor states may be present within the same model,
      * provided that each instance has a unique value of the Sensor Property ID to
      * allow the instances to be differentiated. Such sensors are known as multisensors.
-     * In this example, two instances of the Sensor states within the same model are
-     * provided.
+     * The instances are generated from SENSOR_REGISTRY, the Sensor Server of every zone
+     * holds the slice of its own sensors so a property ID may repeat across zones.
      */
-    [0] = {
-        /* Mesh Model Spec:
-         * Sensor Property ID is a 2-octet value referencing a device property
-         * that describes the meaning and format of data reported by a sensor.
-         * 0x0000 is prohibited.
-         */
-        .sensor_property_id = SENSOR_PROPERTY_ID_0,
-        /* Mesh Model Spec:
-         * Sensor Descriptor state represents the attributes describing the sensor
-         * data. This state does not change throughout the lifetime of an element.
-         */
-        .descriptor.positive_tolerance = SENSOR_POSITIVE_TOLERANCE,
-        .descriptor.negative_tolerance = SENSOR_NEGATIVE_TOLERANCE,
-        .descriptor.sampling_function = SENSOR_SAMPLE_FUNCTION,
-        .descriptor.measure_period = SENSOR_MEASURE_PERIOD,
-        .descriptor.update_interval = SENSOR_UPDATE_INTERVAL,
-        .sensor_data.format = ESP_BLE_MESH_SENSOR_DATA_FORMAT_A,
-        .sensor_data.length = 1, /* 0 represents the length is 1 */
-        .sensor_data.raw_value = &sensor_data_0,
+    SENSOR_REGISTRY(SENSOR_STATE)
+};
+
+#define SENSOR_DRIVER(name, zone, id, fmt, len, is_signed, read, channel, read_period_ms, bin_low, bin_width, \
+        coarse_id, coarse_step) \
+    [SENSOR_##name] = { #name, read, channel, read_period_ms, is_signed },
+
+static const sensor_driver_t sensor_drivers[SENSOR_COUNT] = {
+    SENSOR_REGISTRY(SENSOR_DRIVER)
+};
+
+#define SENSOR_ZONE_OF(name, zone, ...) [SENSOR_##name] = zone,
+
+static const uint8_t sensor_zone_of[SENSOR_COUNT] = {
+    SENSOR_REGISTRY(SENSOR_ZONE_OF)
+};
+
+/* The SHT35 of zone k is acquisition device k, its samples are read on SHT35 channel k */
+#define SENSOR_DEVICE(zone, i2c_port, i2c_address, gpio) \
+    [zone] = { \
+        .sensor = { \
+            .port = i2c_port, \
+            .address = i2c_address, \
+            .mode = SHT35_SINGLE_SHOT, \
+        }, \
+        .alert_gpio = gpio, \
     },
-    [1] = {
-        .sensor_property_id = SENSOR_PROPERTY_ID_1,
-        .descriptor.positive_tolerance = SENSOR_POSITIVE_TOLERANCE,
-        .descriptor.negative_tolerance = SENSOR_NEGATIVE_TOLERANCE,
-        .descriptor.sampling_function = SENSOR_SAMPLE_FUNCTION,
-        .descriptor.measure_period = SENSOR_MEASURE_PERIOD,
-        .descriptor.update_interval = SENSOR_UPDATE_INTERVAL,
-        .sensor_data.format = ESP_BLE_MESH_SENSOR_DATA_FORMAT_A,
-        .sensor_data.length = 1, /* 0 represents the length is 1 */
-        .sensor_data.raw_value = &sensor_data_1,
+
+static const acquisition_device_t sensor_devices[SENSOR_ZONE_COUNT] = {
+    SHT35_REGISTRY(SENSOR_DEVICE)
+};
+
+/* Sampling settings of the SHT35 of every zone, the Kconfig defaults until a Sensor Setting changes them */
+#define SENSOR_DEVICE_SETTINGS(zone, ...) \
+    [zone] = { \
+        .sample_period_ms = CONFIG_SENSOR_SAMPLE_PERIOD_MS, \
+        .repeatability = SENSOR_REPEATABILITY, \
+        .frequency = SENSOR_PERIODIC_FREQUENCY, \
+        .art = false, \
+        .filter_depth = SENSOR_FILTER_DEPTH, \
     },
+
+static acquisition_settings_t sensor_zone_settings[SENSOR_ZONE_COUNT] = {
+    SHT35_REGISTRY(SENSOR_DEVICE_SETTINGS)
+};
+
+/* Marshalled Sensor Data of all sensors, each one as MPID and raw value in its present encoding.
+ * It is laid out at init and again when the encoding of a sensor changes, new samples only patch
+ * the raw values in place. The buffer is sized for the fine encoding of every sensor. */
+#define SENSOR_MPID_LEN(fmt)        ((fmt) == ESP_BLE_MESH_SENSOR_DATA_FORMAT_A ? \
+                                     ESP_BLE_MESH_SENSOR_DATA_FORMAT_A_MPID_LEN : ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN)
+#define SENSOR_STATUS_FIELDS(name, zone, id, fmt, len, ...) \
+    uint8_t name##_mpid[SENSOR_MPID_LEN(fmt)]; \
+    uint8_t name##_value[len];
+
+struct sensor_status_layout {
+    SENSOR_REGISTRY(SENSOR_STATUS_FIELDS)
+} __attribute__((packed));
+
+/* Largest raw value of all sensors */
+#define SENSOR_VALUE_SIZE(name, zone, id, fmt, len, ...) uint8_t name[len];
+#define SENSOR_DATA_MAX_LEN         sizeof(union { SENSOR_REGISTRY(SENSOR_VALUE_SIZE) })
+
+static struct {
+    uint16_t offset;        /* start of the MPID of the sensor in sensor_status */
+    uint8_t length;         /* MPID and raw value length */
+    uint8_t value_len;      /* raw value length, the raw value ends the entry */
+} sensor_status_entries[SENSOR_COUNT];
+
+static uint8_t sensor_status[sizeof(struct sensor_status_layout)];
+static const uint16_t sensor_status_len = sizeof(struct sensor_status_layout);
+
+/* Samples are stored by the main loop while a Sensor Setting may lay the status out again from the mesh
+ * callbacks, sensor_status, its entries and the zones are only touched with this lock held */
+static portMUX_TYPE sensor_status_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Encodings of the raw value of each sensor, chosen with the SENSOR_SETTING_ENCODING Sensor Setting */
+#define SENSOR_CHECK_ENCODING(name, zone, id, fmt, len, is_signed, read, channel, read_period_ms, bin_low, bin_width, \
+        coarse_id, coarse_step) \
+    _Static_assert(((coarse_id) == 0) == ((coarse_step) == 0) && (coarse_id) < 0x0800, \
+        "The coarse encoding of sensor " #name " needs a coarse property ID of its own that fits Format A");
+SENSOR_REGISTRY(SENSOR_CHECK_ENCODING)
+
+#define SENSOR_ENCODING_FORMAT(name, zone, id, fmt, len, is_signed, read, channel, read_period_ms, bin_low, bin_width, \
+        coarse_id, coarse_step) \
+    [SENSOR_##name] = { len, is_signed, coarse_step },
+
+static const encoding_format_t sensor_formats[SENSOR_COUNT] = {
+    SENSOR_REGISTRY(SENSOR_ENCODING_FORMAT)
+};
+
+/* Property ID a coarse raw value is sent under, every encoding has a property ID of its own */
+#define SENSOR_COARSE_ID(name, zone, id, fmt, len, is_signed, read, channel, read_period_ms, bin_low, bin_width, \
+        coarse_id, coarse_step) \
+    [SENSOR_##name] = coarse_id,
+
+static const uint16_t sensor_coarse_ids[SENSOR_COUNT] = {
+    SENSOR_REGISTRY(SENSOR_COARSE_ID)
+};
+
+static uint8_t sensor_encodings[SENSOR_COUNT];     /* encoding_t, ENCODING_FINE at boot */
+
+/* Slice of the sensor tables served by the Sensor Server of each zone, the marshalled data is found at init */
+#define SENSOR_ZONE_SLICE(zone, ...) [zone] = { SENSOR_ZONE_FIRST(zone), SENSOR_ZONE_SIZE(zone) },
+
+static struct {
+    uint8_t first;              /* first entry of the zone in sensor_states */
+    uint8_t count;              /* number of sensors in the zone */
+    uint16_t status_offset;     /* marshalled data of the zone in sensor_status */
+    uint16_t status_len;
+} sensor_zones[SENSOR_ZONE_COUNT] = {
+    SHT35_REGISTRY(SENSOR_ZONE_SLICE)
+};
+
+/* Latest value of each sensor */
+static int32_t sensor_values[SENSOR_COUNT];
+
+/* Publish bookkeeping of the Sensor Cadence state, one per entry of sensor_states */
+static cadence_tracker_t cadence_trackers[SENSOR_COUNT];
+
+/* Time buckets and value histogram of every reading of each sensor, the columns of its Sensor Series */
+#define SENSOR_HISTORY(name, zone, id, fmt, len, is_signed, read, channel, read_period_ms, bin_low, bin_width, \
+        coarse_id, coarse_step) \
+    [SENSOR_##name] = { SENSOR_SERIES, CONFIG_SENSOR_HISTORY_BUCKET_S, bin_low, bin_width, len, is_signed },
+
+static const history_config_t sensor_history_configs[SENSOR_COUNT] = {
+    SENSOR_REGISTRY(SENSOR_HISTORY)
 };
 
-/* 20 octets is large enough to hold two Sensor Descriptor state values. */
-ESP_BLE_MESH_MODEL_PUB_DEFINE(sensor_pub, 20, ROLE_NODE);
-static esp_ble_mesh_sensor_srv_t sensor_server = {
-    .rsp_ctrl.get_auto_rsp = ESP_BLE_MESH_SERVER_RSP_BY_APP,
-    .rsp_ctrl.set_auto_rsp = ESP_BLE_MESH_SERVER_RSP_BY_APP,
-    .state_count = ARRAY_SIZE(sensor_states),
-    .states = sensor_states,
+static history_t sensor_history[SENSOR_COUNT];
+
+/* Samples of each zone waiting to be sent in one telemetry batch, with CONFIG_SENSOR_BATCH_SIZE above 1 */
+#define SENSOR_ZONE_CHECK_BATCH(zone, ...) \
+    _Static_assert(SENSOR_ZONE_SIZE(zone) <= TELEMETRY_MAX_PROPERTIES, "Zone " #zone " does not fit a telemetry batch");
+SHT35_REGISTRY(SENSOR_ZONE_CHECK_BATCH)
+
+static telemetry_batch_t sensor_batches[SENSOR_ZONE_COUNT];
+
+/* The publication holds the 1 octet Sensor Status opcode and the marshalled data of a zone,
+ * sized for all sensors so every zone can share the definition. */
+#define SENSOR_ZONE_PUB(zone, ...) \
+    ESP_BLE_MESH_MODEL_PUB_DEFINE(sensor_pub_##zone, 1 + sizeof(struct sensor_status_layout), ROLE_NODE); \
+    ESP_BLE_MESH_MODEL_PUB_DEFINE(sensor_setup_pub_##zone, 20, ROLE_NODE);
+SHT35_REGISTRY(SENSOR_ZONE_PUB)
+
+/* The servers of a zone hold the slice of sensor_states of the zone */
+#define SENSOR_ZONE_SERVER(zone, ...) \
+    [zone] = { \
+        .rsp_ctrl.get_auto_rsp = ESP_BLE_MESH_SERVER_RSP_BY_APP, \
+        .rsp_ctrl.set_auto_rsp = ESP_BLE_MESH_SERVER_RSP_BY_APP, \
+        .state_count = SENSOR_ZONE_SIZE(zone), \
+        .states = &sensor_states[SENSOR_ZONE_FIRST(zone)], \
+    },
+
+static esp_ble_mesh_sensor_srv_t sensor_servers[SENSOR_ZONE_COUNT] = {
+    SHT35_REGISTRY(SENSOR_ZONE_SERVER)
 };
 
-ESP_BLE_MESH_MODEL_PUB_DEFINE(sensor_setup_pub, 20, ROLE_NODE);
-static esp_ble_mesh_sensor_setup_srv_t sensor_setup_server = {
-    .rsp_ctrl.get_auto_rsp = ESP_BLE_MESH_SERVER_RSP_BY_APP,
-    .rsp_ctrl.set_auto_rsp = ESP_BLE_MESH_SERVER_RSP_BY_APP,
-    .state_count = ARRAY_SIZE(sensor_states),
-    .states = sensor_states,
+static esp_ble_mesh_sensor_setup_srv_t sensor_setup_servers[SENSOR_ZONE_COUNT] = {
+    SHT35_REGISTRY(SENSOR_ZONE_SERVER)
 };
 
 static esp_ble_mesh_model_t root_models[] = {
     ESP_BLE_MESH_MODEL_CFG_SRV(&config_server),
-    ESP_BLE_MESH_MODEL_SENSOR_SRV(&sensor_pub, &sensor_server),
-    ESP_BLE_MESH_MODEL_SENSOR_SETUP_SRV(&sensor_setup_pub, &sensor_setup_server),
+    ESP_BLE_MESH_MODEL_SENSOR_SRV(&sensor_pub_0, &sensor_servers[0]),
+    ESP_BLE_MESH_MODEL_SENSOR_SETUP_SRV(&sensor_setup_pub_0, &sensor_setup_servers[0]),
+};
+
+/* Store-and-forward of the published samples, the gateway acknowledges its Status and gets the
+ * samples it missed replayed, see backfill.c */
+static esp_ble_mesh_model_op_t backfill_ops[] = {
+    ESP_BLE_MESH_MODEL_OP(BACKFILL_OP_ACK, BACKFILL_ACK_LEN),
+    ESP_BLE_MESH_MODEL_OP(BACKFILL_OP_GET, BACKFILL_GET_LEN),
+    ESP_BLE_MESH_MODEL_OP_END,
 };
 
+ESP_BLE_MESH_MODEL_PUB_DEFINE(backfill_pub, 3 + sizeof(backfill_status_t), ROLE_NODE);
+
+/* Telemetry batches have a model and publication of their own, the main loop publishes them while the
+ * backfill task publishes its Status, see telemetry.h */
+static esp_ble_mesh_model_op_t telemetry_ops[] = {
+    ESP_BLE_MESH_MODEL_OP_END,
+};
+
+ESP_BLE_MESH_MODEL_PUB_DEFINE(telemetry_pub, 3 + TELEMETRY_MAX_LEN, ROLE_NODE);
+
+static esp_ble_mesh_model_t vnd_models[] = {
+    ESP_BLE_MESH_VENDOR_MODEL(BACKFILL_CID, BACKFILL_MODEL_ID_SERVER, backfill_ops, &backfill_pub, NULL),
+    ESP_BLE_MESH_VENDOR_MODEL(BACKFILL_CID, TELEMETRY_MODEL_ID_SERVER, telemetry_ops, &telemetry_pub, NULL),
+};
+
+#define SENSOR_ZONE_MODELS(zone, ...) \
+    static esp_ble_mesh_model_t zone_models_##zone[] = { \
+        ESP_BLE_MESH_MODEL_SENSOR_SRV(&sensor_pub_##zone, &sensor_servers[zone]), \
+        ESP_BLE_MESH_MODEL_SENSOR_SETUP_SRV(&sensor_setup_pub_##zone, &sensor_setup_servers[zone]), \
+    };
+SHT35_REGISTRY_ZONES(SENSOR_ZONE_MODELS)
+
+#define SENSOR_ZONE_ELEMENT(zone, ...) \
+    ESP_BLE_MESH_ELEMENT(0, zone_models_##zone, ESP_BLE_MESH_MODEL_NONE),
+
 static esp_ble_mesh_elem_t elements[] = {
-    ESP_BLE_MESH_ELEMENT(0, root_models, ESP_BLE_MESH_MODEL_NONE),
+    ESP_BLE_MESH_ELEMENT(0, root_models, vnd_models),
+    SHT35_REGISTRY_ZONES(SENSOR_ZONE_ELEMENT)
+};
+
+/* Sensor Server model of each zone, the zone publishes through it */
+#define SENSOR_ZONE_MODEL(zone, ...) [zone] = &zone_models_##zone[0],
+
+static esp_ble_mesh_model_t *const sensor_zone_models[SENSOR_ZONE_COUNT] = {
+    [0] = &root_models[1],
+    SHT35_REGISTRY_ZONES(SENSOR_ZONE_MODEL)
 };
 
 static esp_ble_mesh_comp_t composition = {
@@ -164,11 +454,48 @@ static void prov_complete(uint16_t net_idx, uint16_t addr, uint8_t flags, uint32
 {
     ESP_LOGI(TAG, "net_idx 0x%03x, addr 0x%04x", net_idx, addr);
     ESP_LOGI(TAG, "flags 0x%02x, iv_index 0x%08x", flags, iv_index);
+    indicator_post(INDICATOR_IDLE);
+}
+#if defined(CONFIG_BLE_MESH_LOW_POWER)
+static void example_ble_mesh_lpn_start(void)
+/* Looks for a Friend once every Sensor Server has a publish address, the provisioner is done with the node
+ * then. The node keeps scanning until a Friend offers, from then on it only listens after its polls */
+{
+    esp_err_t err;
+    uint8_t zone;
+
+    for (zone = 0; zone < SENSOR_ZONE_COUNT; zone++) {
+        if (sensor_zone_models[zone]->pub->publish_addr == ESP_BLE_MESH_ADDR_UNASSIGNED) {
+            return;
+        }
+    }
+
+    err = esp_ble_mesh_lpn_enable();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable Low Power Node (err %d)", err);
+    }
+}
+
+static void example_ble_mesh_lpn_poll(void)
+/* Asks the Friend for the messages it queued, so a Sensor Get or a configuration message waits at most one
+ * sample instead of the Poll Timeout */
+{
+#if defined(CONFIG_SENSOR_LPN_POLL_AFTER_PUBLISH)
+    esp_err_t err;
+
+    if (lpn_friend_addr == ESP_BLE_MESH_ADDR_UNASSIGNED) {
+        return;
+    }
 
-    /* Initialize the indoor and outdoor temperatures for each sensor.  */
-    net_buf_simple_add_le16(&sensor_data_0, indoor_temp);
-    net_buf_simple_add_le16(&sensor_data_1, indoor_humidity);
+    err = esp_ble_mesh_lpn_poll();
+    if (err != ESP_OK) {
+        /* A poll of another zone is still waiting for its answer */
+        ESP_LOGD(TAG, "Friend poll failed (err %d)", err);
+    }
+#endif
 }
+#endif
+
 static void example_ble_mesh_provisioning_cb(esp_ble_mesh_prov_cb_event_t event,
                                              esp_ble_mesh_prov_cb_param_t *param)
 {
@@ -183,7 +510,7 @@ static void example_ble_mesh_provisioning_cb(esp_ble_mesh_prov_cb_event_t event,
     case ESP_BLE_MESH_NODE_PROV_LINK_OPEN_EVT:
         ESP_LOGI(TAG, "ESP_BLE_MESH_NODE_PROV_LINK_OPEN_EVT, bearer %s",
             param->node_prov_link_open.bearer == ESP_BLE_MESH_PROV_ADV ? "PB-ADV" : "PB-GATT");
-        LED_setcolor(255,255,0);
+        indicator_post(INDICATOR_PROVISIONING);
         break;
     case ESP_BLE_MESH_NODE_PROV_LINK_CLOSE_EVT:
         ESP_LOGI(TAG, "ESP_BLE_MESH_NODE_PROV_LINK_CLOSE_EVT, bearer %s",
@@ -195,19 +522,87 @@ static void example_ble_mesh_provisioning_cb(esp_ble_mesh_prov_cb_event_t event,
             param->node_prov_complete.flags, param->node_prov_complete.iv_index);
         break;
     case ESP_BLE_MESH_NODE_PROV_RESET_EVT:
+        /* The stack has erased the stored mesh state as well */
         ESP_LOGI(TAG, "ESP_BLE_MESH_NODE_PROV_RESET_EVT");
+        HAS_APPKEY = false;
         break;
     case ESP_BLE_MESH_NODE_SET_UNPROV_DEV_NAME_COMP_EVT:
         ESP_LOGI(TAG, "ESP_BLE_MESH_NODE_SET_UNPROV_DEV_NAME_COMP_EVT, err_code %d", param->node_set_unprov_dev_name_comp.err_code);
         break;
+#if defined(CONFIG_BLE_MESH_LOW_POWER)
+    case ESP_BLE_MESH_LPN_ENABLE_COMP_EVT:
+        ESP_LOGI(TAG, "ESP_BLE_MESH_LPN_ENABLE_COMP_EVT, err_code %d", param->lpn_enable_comp.err_code);
+        break;
+    case ESP_BLE_MESH_LPN_FRIENDSHIP_ESTABLISH_EVT:
+        ESP_LOGI(TAG, "ESP_BLE_MESH_LPN_FRIENDSHIP_ESTABLISH_EVT, friend 0x%04x",
+            param->lpn_friendship_establish.friend_addr);
+        lpn_friend_addr = param->lpn_friendship_establish.friend_addr;
+        break;
+    case ESP_BLE_MESH_LPN_FRIENDSHIP_TERMINATE_EVT:
+        /* The stack looks for a new Friend by itself, the node scans again until it finds one */
+        ESP_LOGW(TAG, "ESP_BLE_MESH_LPN_FRIENDSHIP_TERMINATE_EVT, friend 0x%04x",
+            param->lpn_friendship_terminate.friend_addr);
+        lpn_friend_addr = ESP_BLE_MESH_ADDR_UNASSIGNED;
+        break;
+    case ESP_BLE_MESH_LPN_POLL_COMP_EVT:
+        ESP_LOGD(TAG, "ESP_BLE_MESH_LPN_POLL_COMP_EVT, err_code %d", param->lpn_poll_comp.err_code);
+        break;
+#endif
     default:
         break;
     }
 }
 
+/* Fine values in the publication buffer of every Sensor Server, logged once the stack has published them */
+static int32_t sensor_publication_values[SENSOR_COUNT];
+
+static void example_ble_mesh_fill_sensor_publication(uint8_t zone)
+/* Puts the present Sensor Status of the zone in the publication buffer of its Sensor Server. The stack
+ * publishes the buffer at every Publish Period set by the Config Model Publication Set */
+{
+    struct net_buf_simple *msg = sensor_zone_models[zone]->pub->msg;
+
+    net_buf_simple_reset(msg);
+    net_buf_simple_add_u8(msg, ESP_BLE_MESH_MODEL_OP_SENSOR_STATUS);   /* 1 octet opcode */
+
+    taskENTER_CRITICAL(&sensor_status_lock);
+    net_buf_simple_add_mem(msg, sensor_status + sensor_zones[zone].status_offset, sensor_zones[zone].status_len);
+    memcpy(&sensor_publication_values[sensor_zones[zone].first], &sensor_values[sensor_zones[zone].first],
+           sensor_zones[zone].count * sizeof(int32_t));
+    taskEXIT_CRITICAL(&sensor_status_lock);
+}
+
+#if CONFIG_SENSOR_BATCH_SIZE > 1
+#define SENSOR_SETTINGS_KEY_BATCH_PERIODS   "batchperiods"
+
+/* Publish Period of each Sensor Server in batch mode. Batches go out through the backfill server, the stack
+ * would publish a stale Sensor Status at the period, so it is cleared in the publication and kept here. It
+ * only sets the rate at which the zone is added to its batch */
+static uint8_t sensor_batch_periods[SENSOR_ZONE_COUNT];
+
+static void example_ble_mesh_take_publish_period(uint8_t zone)
+/* The stack stops the periodic publication of the zone at its next timeout once the period is 0 */
+{
+    esp_ble_mesh_model_pub_t *pub = sensor_zone_models[zone]->pub;
+    esp_err_t err;
+
+    sensor_batch_periods[zone] = pub->period;
+    pub->period = 0;
+
+    err = settings_store(SENSOR_SETTINGS_KEY_BATCH_PERIODS, sensor_batch_periods, sizeof(sensor_batch_periods));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Batch periods not stored (err %d)", err);
+    }
+}
+#endif
+
 static void example_ble_mesh_config_server_cb(esp_ble_mesh_cfg_server_cb_event_t event,
                                               esp_ble_mesh_cfg_server_cb_param_t *param)
 {
+#if CONFIG_SENSOR_BATCH_SIZE > 1
+    uint8_t zone;
+#endif
+
     if (event == ESP_BLE_MESH_CFG_SERVER_STATE_CHANGE_EVT) {
         switch (param->ctx.recv_op) {
         case ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD:
@@ -226,6 +621,28 @@ static void example_ble_mesh_config_server_cb(esp_ble_mesh_cfg_server_cb_event_t
                 param->value.state_change.mod_app_bind.company_id,
                 param->value.state_change.mod_app_bind.model_id);
             break;
+        case ESP_BLE_MESH_MODEL_OP_MODEL_PUB_SET:
+            ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_MODEL_PUB_SET");
+            ESP_LOGI(TAG, "elem_addr 0x%04x, pub_addr 0x%04x, ttl %u, period 0x%02x, retransmit 0x%02x, mod_id 0x%04x",
+                param->value.state_change.mod_pub_set.element_addr,
+                param->value.state_change.mod_pub_set.pub_addr,
+                param->value.state_change.mod_pub_set.pub_ttl,
+                param->value.state_change.mod_pub_set.pub_period,
+                param->value.state_change.mod_pub_set.pub_retransmit,
+                param->value.state_change.mod_pub_set.model_id);
+            if (param->value.state_change.mod_pub_set.model_id == ESP_BLE_MESH_MODEL_ID_SENSOR_SRV) {
+#if CONFIG_SENSOR_BATCH_SIZE > 1
+                /* Zone k is element k */
+                zone = param->value.state_change.mod_pub_set.element_addr - esp_ble_mesh_get_primary_element_address();
+                if (zone < SENSOR_ZONE_COUNT) {
+                    example_ble_mesh_take_publish_period(zone);
+                }
+#endif
+#if defined(CONFIG_BLE_MESH_LOW_POWER)
+                example_ble_mesh_lpn_start();
+#endif
+            }
+            break;
         case ESP_BLE_MESH_MODEL_OP_MODEL_SUB_ADD:
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_MODEL_SUB_ADD");
             ESP_LOGI(TAG, "elem_addr 0x%04x, sub_addr 0x%04x, cid 0x%04x, mod_id 0x%04x",
@@ -249,19 +666,104 @@ struct example_sensor_descriptor {
     uint8_t  update_interval;
 } __attribute__((packed));
 
-static void example_ble_mesh_send_sensor_descriptor_status(esp_ble_mesh_sensor_server_cb_param_t *param)
+/* Open addressed index from zone and Sensor Property ID to the entry in sensor_states, built once at init.
+ * The table is kept at least twice as large as the number of sensors so probes stay short. */
+#define SENSOR_INDEX_SIZE           32
+#define SENSOR_INDEX_EMPTY          0xFF
+
+static uint8_t sensor_index[SENSOR_INDEX_SIZE];
+
+static inline uint8_t example_sensor_index_hash(uint8_t zone, uint16_t property_id)
 {
-    struct example_sensor_descriptor descriptor = {0};
-    uint8_t *status = NULL;
-    uint16_t length = 0;
-    esp_err_t err;
+    return (property_id ^ (property_id >> 8) ^ (zone << 2)) & (SENSOR_INDEX_SIZE - 1);
+}
+
+static void example_ble_mesh_build_sensor_index(void)
+{
+    uint8_t slot;
     int i;
 
-    status = calloc(1, ARRAY_SIZE(sensor_states) * ESP_BLE_MESH_SENSOR_DESCRIPTOR_LEN);
-    if (!status) {
-        ESP_LOGE(TAG, "No memory for sensor descriptor status!");
-        return;
+    _Static_assert(SENSOR_INDEX_SIZE >= 2 * SENSOR_COUNT, "Sensor index too small");
+    _Static_assert((SENSOR_INDEX_SIZE & (SENSOR_INDEX_SIZE - 1)) == 0, "Sensor index size must be a power of 2");
+
+    memset(sensor_index, SENSOR_INDEX_EMPTY, sizeof(sensor_index));
+    for (i = 0; i < SENSOR_COUNT; i++) {
+        slot = example_sensor_index_hash(sensor_zone_of[i], sensor_states[i].sensor_property_id);
+        while (sensor_index[slot] != SENSOR_INDEX_EMPTY) {
+            slot = (slot + 1) & (SENSOR_INDEX_SIZE - 1);
+        }
+        sensor_index[slot] = i;
+    }
+}
+
+static int example_ble_mesh_find_sensor(uint8_t zone, uint16_t property_id)
+/* Returns the index in sensor_states of the property in the zone, or -1 when the zone has no such property */
+{
+    uint8_t slot = example_sensor_index_hash(zone, property_id);
+
+    while (sensor_index[slot] != SENSOR_INDEX_EMPTY) {
+        if (sensor_states[sensor_index[slot]].sensor_property_id == property_id &&
+            sensor_zone_of[sensor_index[slot]] == zone) {
+            return sensor_index[slot];
+        }
+        slot = (slot + 1) & (SENSOR_INDEX_SIZE - 1);
+    }
+    return -1;
+}
+
+static esp_err_t example_ble_mesh_build_sensor_zones(void)
+/* Checks that the sensors of every zone follow each other, the marshalled data of a zone is one slice of sensor_status */
+{
+    uint8_t zone;
+    int i;
+
+    for (zone = 0; zone < SENSOR_ZONE_COUNT; zone++) {
+        for (i = sensor_zones[zone].first; i < sensor_zones[zone].first + sensor_zones[zone].count; i++) {
+            if (sensor_zone_of[i] != zone) {
+                ESP_LOGE(TAG, "Sensor %s is not next to the other sensors of zone %u", sensor_drivers[i].name,
+                    sensor_zone_of[i]);
+                return ESP_ERR_INVALID_STATE;
+            }
+        }
     }
+    return ESP_OK;
+}
+
+static inline uint8_t example_ble_mesh_model_zone(const esp_ble_mesh_model_t *model)
+/* Zone k is element k, see elements[] */
+{
+    return model->element_idx;
+}
+
+/* Mesh Model Spec:
+ * Sensor Descriptor state represents the attributes describing the sensor data.
+ * This state does not change throughout the lifetime of an element, so the
+ * Sensor Descriptor Status of all sensors is generated at compile time and kept
+ * in flash. The descriptor of sensor i is the 8 octet entry i. */
+#define SENSOR_DESCRIPTOR(name, zone, id, ...) \
+    [SENSOR_##name] = { \
+        .sensor_prop_id = id, \
+        .pos_tolerance = SENSOR_POSITIVE_TOLERANCE, \
+        .neg_tolerance = SENSOR_NEGATIVE_TOLERANCE, \
+        .sample_func = SENSOR_SAMPLE_FUNCTION, \
+        .measure_period = SENSOR_MEASURE_PERIOD, \
+        .update_interval = SENSOR_UPDATE_INTERVAL, \
+    },
+
+static const struct example_sensor_descriptor sensor_descriptors[SENSOR_COUNT] = {
+    SENSOR_REGISTRY(SENSOR_DESCRIPTOR)
+};
+
+_Static_assert(sizeof(struct example_sensor_descriptor) == ESP_BLE_MESH_SENSOR_DESCRIPTOR_LEN,
+    "Sensor descriptor is not packed");
+
+static void example_ble_mesh_send_sensor_descriptor_status(esp_ble_mesh_sensor_server_cb_param_t *param)
+{
+    uint8_t zone = example_ble_mesh_model_zone(param->model);
+    uint8_t *status = (uint8_t *)&sensor_descriptors[sensor_zones[zone].first];
+    uint16_t length = sensor_zones[zone].count * ESP_BLE_MESH_SENSOR_DESCRIPTOR_LEN;
+    esp_err_t err;
+    int i;
 
     if (param->value.get.sensor_descriptor.op_en == false) {
         /* Mesh Model Spec:
@@ -270,31 +772,14 @@ static void example_ble_mesh_send_sensor_descriptor_status(esp_ble_mesh_sensor_s
          * message containing the Sensor Descriptor states for all sensors within the
          * Sensor Server.
          */
-        for (i = 0; i < ARRAY_SIZE(sensor_states); i++) {
-            descriptor.sensor_prop_id = sensor_states[i].sensor_property_id;
-            descriptor.pos_tolerance = sensor_states[i].descriptor.positive_tolerance;
-            descriptor.neg_tolerance = sensor_states[i].descriptor.negative_tolerance;
-            descriptor.sample_func = sensor_states[i].descriptor.sampling_function;
-            descriptor.measure_period = sensor_states[i].descriptor.measure_period;
-            descriptor.update_interval = sensor_states[i].descriptor.update_interval;
-            memcpy(status + length, &descriptor, ESP_BLE_MESH_SENSOR_DESCRIPTOR_LEN);
-            length += ESP_BLE_MESH_SENSOR_DESCRIPTOR_LEN;
-        }
         goto send;
     }
 
-    for (i = 0; i < ARRAY_SIZE(sensor_states); i++) {
-        if (param->value.get.sensor_descriptor.property_id == sensor_states[i].sensor_property_id) {
-            descriptor.sensor_prop_id = sensor_states[i].sensor_property_id;
-            descriptor.pos_tolerance = sensor_states[i].descriptor.positive_tolerance;
-            descriptor.neg_tolerance = sensor_states[i].descriptor.negative_tolerance;
-            descriptor.sample_func = sensor_states[i].descriptor.sampling_function;
-            descriptor.measure_period = sensor_states[i].descriptor.measure_period;
-            descriptor.update_interval = sensor_states[i].descriptor.update_interval;
-            memcpy(status, &descriptor, ESP_BLE_MESH_SENSOR_DESCRIPTOR_LEN);
-            length = ESP_BLE_MESH_SENSOR_DESCRIPTOR_LEN;
-            goto send;
-        }
+    i = example_ble_mesh_find_sensor(zone, param->value.get.sensor_descriptor.property_id);
+    if (i >= 0) {
+        status = (uint8_t *)&sensor_descriptors[i];
+        length = ESP_BLE_MESH_SENSOR_DESCRIPTOR_LEN;
+        goto send;
     }
 
     /* Mesh Model Spec:
@@ -303,7 +788,7 @@ static void example_ble_mesh_send_sensor_descriptor_status(esp_ble_mesh_sensor_s
      * contain the requested Property ID value and the other fields of the Sensor
      * Descriptor state shall be omitted.
      */
-    memcpy(status, &param->value.get.sensor_descriptor.property_id, ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN);
+    status = (uint8_t *)&param->value.get.sensor_descriptor.property_id;
     length = ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN;
 
 send:
@@ -314,66 +799,61 @@ send:
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to send Sensor Descriptor Status");
     }
-    free(status);
 }
 
-static void example_ble_mesh_send_sensor_cadence_status(esp_ble_mesh_sensor_server_cb_param_t *param)
+static cadence_tracker_t *example_ble_mesh_find_cadence(const esp_ble_mesh_model_t *model, uint16_t property_id)
 {
-    esp_err_t err;
+    int i = example_ble_mesh_find_sensor(example_ble_mesh_model_zone(model), property_id);
 
-    /* Sensor Cadence state is not supported currently. */
-    err = esp_ble_mesh_server_model_send_msg(param->model, &param->ctx,
-            ESP_BLE_MESH_MODEL_OP_SENSOR_CADENCE_STATUS,
-            ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN,
-            (uint8_t *)&param->value.get.sensor_cadence.property_id);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send Sensor Cadence Status");
-    }
+    return i < 0 ? NULL : &cadence_trackers[i];
 }
 
-static void example_ble_mesh_send_sensor_settings_status(esp_ble_mesh_sensor_server_cb_param_t *param)
+static void example_ble_mesh_send_sensor_cadence_status(esp_ble_mesh_sensor_server_cb_param_t *param,
+                                                        uint16_t property_id)
 {
+    uint8_t status[ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN + CADENCE_MAX_LEN(SENSOR_DATA_MAX_LEN)];
+    cadence_tracker_t *tracker = example_ble_mesh_find_cadence(param->model, property_id);
+    uint16_t length;
     esp_err_t err;
 
-    /* Sensor Setting state is not supported currently. */
+    if (tracker) {
+        length = cadence_get(tracker, status);
+    } else {
+        /* Mesh Model Spec:
+         * If the Property ID is not recognized, the Sensor Cadence fields shall be omitted.
+         */
+        memcpy(status, &property_id, ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN);
+        length = ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN;
+    }
+
+    ESP_LOG_BUFFER_HEX("Sensor Cadence", status, length);
+
     err = esp_ble_mesh_server_model_send_msg(param->model, &param->ctx,
-            ESP_BLE_MESH_MODEL_OP_SENSOR_SETTINGS_STATUS,
-            ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN,
-            (uint8_t *)&param->value.get.sensor_settings.property_id);
+            ESP_BLE_MESH_MODEL_OP_SENSOR_CADENCE_STATUS, length, status);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send Sensor Settings Status");
+        ESP_LOGE(TAG, "Failed to send Sensor Cadence Status");
     }
 }
 
-struct example_sensor_setting {
-    uint16_t sensor_prop_id;
-    uint16_t sensor_setting_prop_id;
-} __attribute__((packed));
-
-static void example_ble_mesh_send_sensor_setting_status(esp_ble_mesh_sensor_server_cb_param_t *param)
+static void example_ble_mesh_set_sensor_cadence(esp_ble_mesh_sensor_server_cb_param_t *param)
 {
-    struct example_sensor_setting setting = {0};
+    cadence_tracker_t *tracker = example_ble_mesh_find_cadence(param->model, param->value.set.sensor_cadence.property_id);
+    struct net_buf_simple *cadence = param->value.set.sensor_cadence.cadence;
     esp_err_t err;
 
-    /* Mesh Model Spec:
-     * If the message is sent as a response to the Sensor Setting Get message or
-     * a Sensor Setting Set message with an unknown Sensor Property ID field or
-     * an unknown Sensor Setting Property ID field, the Sensor Setting Access
-     * field and the Sensor Setting Raw field shall be omitted.
-     */
-
-    setting.sensor_prop_id = param->value.get.sensor_setting.property_id;
-    setting.sensor_setting_prop_id = param->value.get.sensor_setting.setting_property_id;
+    if (tracker == NULL || cadence == NULL) {
+        return;
+    }
 
-    err = esp_ble_mesh_server_model_send_msg(param->model, &param->ctx,
-            ESP_BLE_MESH_MODEL_OP_SENSOR_SETTING_STATUS,
-            sizeof(setting), (uint8_t *)&setting);
+    err = cadence_set(tracker, cadence->data, cadence->len);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send Sensor Setting Status");
+        ESP_LOGW(TAG, "Ignored Sensor Cadence Set for 0x%04x (err %d)",
+            param->value.set.sensor_cadence.property_id, err);
     }
 }
 
-static uint16_t example_ble_mesh_get_sensor_data(esp_ble_mesh_sensor_state_t *state, uint8_t *data)
+static uint16_t example_ble_mesh_get_sensor_data(esp_ble_mesh_sensor_state_t *state, uint16_t property_id, uint8_t *data)
+/* Marshals the sensor with the property ID of its present encoding */
 {
     uint8_t mpid_len = 0, data_len = 0;
     uint32_t mpid = 0;
@@ -385,15 +865,15 @@ static uint16_t example_ble_mesh_get_sensor_data(esp_ble_mesh_sensor_state_t *st
 
     if (state->sensor_data.length == ESP_BLE_MESH_SENSOR_DATA_ZERO_LEN) {
         /* For zero-length sensor data, the length is 0x7F, and the format is Format B. */
-        mpid = ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID(state->sensor_data.length, state->sensor_property_id);
+        mpid = ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID(state->sensor_data.length, property_id);
         mpid_len = ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN;
         data_len = 0;
     } else {
         if (state->sensor_data.format == ESP_BLE_MESH_SENSOR_DATA_FORMAT_A) {
-            mpid = ESP_BLE_MESH_SENSOR_DATA_FORMAT_A_MPID(state->sensor_data.length, state->sensor_property_id);
+            mpid = ESP_BLE_MESH_SENSOR_DATA_FORMAT_A_MPID(state->sensor_data.length, property_id);
             mpid_len = ESP_BLE_MESH_SENSOR_DATA_FORMAT_A_MPID_LEN;
         } else {
-            mpid = ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID(state->sensor_data.length, state->sensor_property_id);
+            mpid = ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID(state->sensor_data.length, property_id);
             mpid_len = ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN;
         }
         /* Use "state->sensor_data.length + 1" because the length of sensor data is zero-based. */
@@ -406,13 +886,38 @@ static uint16_t example_ble_mesh_get_sensor_data(esp_ble_mesh_sensor_state_t *st
     return (mpid_len + data_len);
 }
 
-static void example_ble_mesh_send_sensor_status(esp_ble_mesh_sensor_server_cb_param_t *param)
+static void example_ble_mesh_write_sensor_value(int index)
+/* Writes the value of the sensor little endian in its encoding into its raw value and over its old value
+ * in the sensor status, with sensor_status_lock held */
 {
-    uint8_t *status = NULL;
-    uint16_t buf_size = 0;
-    uint16_t length = 0;
-    uint32_t mpid = 0;
-    esp_err_t err;
+    struct net_buf_simple *raw_value = sensor_states[index].sensor_data.raw_value;
+    uint8_t value_len = sensor_status_entries[index].value_len;
+    uint16_t end = sensor_status_entries[index].offset + sensor_status_entries[index].length;
+    int32_t value = encoding_apply(&sensor_formats[index], sensor_encodings[index], sensor_values[index]);
+    int i;
+
+    net_buf_simple_reset(raw_value);
+    for (i = 0; i < value_len; i++) {
+        net_buf_simple_add_u8(raw_value, (uint32_t)value >> (8 * i));
+    }
+    memcpy(sensor_status + end - value_len, raw_value->data, value_len);
+}
+
+static void example_ble_mesh_store_sensor_value(int index, int32_t value)
+/* The value is kept in the fine encoding, the other encodings are derived from it */
+{
+    taskENTER_CRITICAL(&sensor_status_lock);
+    sensor_values[index] = value;
+    example_ble_mesh_write_sensor_value(index);
+    taskEXIT_CRITICAL(&sensor_status_lock);
+}
+
+static void example_ble_mesh_build_sensor_status(void)
+/* Lays out the MPID and raw value of every sensor in its present encoding and finds the slice of every zone,
+ * with sensor_status_lock held */
+{
+    uint16_t offset = 0;
+    uint8_t value_len, zone;
     int i;
 
     /**
@@ -426,156 +931,644 @@ static void example_ble_mesh_send_sensor_status(esp_ble_mesh_sensor_server_cb_pa
      * |----Property ID n----|-------2-------|--ID of the nth device property of the sensor---------|
      * |-----Raw Value n-----|----variable---|--Raw Value field defined by the nth device property--|
      */
-    for (i = 0; i < ARRAY_SIZE(sensor_states); i++) {
-        esp_ble_mesh_sensor_state_t *state = &sensor_states[i];
-        if (state->sensor_data.length == ESP_BLE_MESH_SENSOR_DATA_ZERO_LEN) {
-            buf_size += ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN;
-        } else {
-            /* Use "state->sensor_data.length + 1" because the length of sensor data is zero-based. */
-            if (state->sensor_data.format == ESP_BLE_MESH_SENSOR_DATA_FORMAT_A) {
-                buf_size += ESP_BLE_MESH_SENSOR_DATA_FORMAT_A_MPID_LEN + state->sensor_data.length + 1;
-            } else {
-                buf_size += ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN + state->sensor_data.length + 1;
-            }
-        }
+    for (i = 0; i < SENSOR_COUNT; i++) {
+        value_len = encoding_length(&sensor_formats[i], sensor_encodings[i]);
+        sensor_states[i].sensor_data.length = value_len - 1;    /* 0 represents the length is 1 */
+        sensor_status_entries[i].offset = offset;
+        sensor_status_entries[i].length = SENSOR_MPID_LEN(sensor_states[i].sensor_data.format) + value_len;
+        sensor_status_entries[i].value_len = value_len;
+        example_ble_mesh_write_sensor_value(i);
+        example_ble_mesh_get_sensor_data(&sensor_states[i], sensor_encodings[i] == ENCODING_COARSE ?
+                                         sensor_coarse_ids[i] : sensor_states[i].sensor_property_id, sensor_status + offset);
+        offset += sensor_status_entries[i].length;
     }
 
-    status = calloc(1, buf_size);
-    if (!status) {
-        ESP_LOGE(TAG, "No memory for sensor status!");
-        return;
+    for (zone = 0; zone < SENSOR_ZONE_COUNT; zone++) {
+        i = sensor_zones[zone].first + sensor_zones[zone].count - 1;
+        sensor_zones[zone].status_offset = sensor_status_entries[sensor_zones[zone].first].offset;
+        sensor_zones[zone].status_len = sensor_status_entries[i].offset + sensor_status_entries[i].length
+                                        - sensor_zones[zone].status_offset;
     }
+}
 
-    if (param->value.get.sensor_data.op_en == false) {
-        /* Mesh Model Spec:
-         * If the message is sent as a response to the Sensor Get message, and if the
-         * Property ID field of the incoming message is omitted, the Marshalled Sensor
-         * Data field shall contain data for all device properties within a sensor.
-         */
-        for (i = 0; i < ARRAY_SIZE(sensor_states); i++) {
-            length += example_ble_mesh_get_sensor_data(&sensor_states[i], status + length);
-        }
-        goto send;
-    }
+/* Sensor Settings of the sensors, in the private range of Device Property IDs, all little endian. The encoding
+ * is only listed for sensors that have an encoding besides the fine one. The sampling settings belong to the
+ * SHT35 of the zone and are listed for the sensors read from its samples, a change applies to all of them.
+ * Every setting is stored in NVS and applied again after a reboot */
+#define SENSOR_SETTING_ENCODING             0xFF00  /* encoding_t */
+#define SENSOR_SETTING_SAMPLE_PERIOD        0xFF01  /* uint32 in ms */
+#define SENSOR_SETTING_REPEATABILITY        0xFF02  /* etRepeatability */
+#define SENSOR_SETTING_FREQUENCY            0xFF03  /* etFrequency, periodic and alert mode */
+#define SENSOR_SETTING_ART                  0xFF04  /* 0 or 1, periodic and alert mode */
+#define SENSOR_SETTING_FILTER_DEPTH         0xFF05  /* 1 to FILTER_MAX_DEPTH, periodic mode */
+#define SENSOR_SETTING_RAW_MAX_LEN          4
+#define SENSOR_SETTING_ACCESS_READ_WRITE    0x03
+
+#define SENSOR_SETTINGS_KEY_ENCODINGS       "encodings"
+#define SENSOR_SETTINGS_KEY_ZONE            "zone%u"
+
+static const uint16_t sensor_setting_ids[] = {
+    SENSOR_SETTING_ENCODING,
+    SENSOR_SETTING_SAMPLE_PERIOD,
+    SENSOR_SETTING_REPEATABILITY,
+    SENSOR_SETTING_FREQUENCY,
+    SENSOR_SETTING_ART,
+    SENSOR_SETTING_FILTER_DEPTH,
+};
 
-    /* Mesh Model Spec:
-     * Otherwise, the Marshalled Sensor Data field shall contain data for the requested
-     * device property only.
-     */
-    for (i = 0; i < ARRAY_SIZE(sensor_states); i++) {
-        if (param->value.get.sensor_data.property_id == sensor_states[i].sensor_property_id) {
-            length = example_ble_mesh_get_sensor_data(&sensor_states[i], status);
-            goto send;
-        }
+static _Bool example_ble_mesh_has_setting(int index, uint16_t setting_prop_id)
+{
+    switch (setting_prop_id) {
+    case SENSOR_SETTING_ENCODING:
+        return encoding_supported(&sensor_formats[index], ENCODING_COARSE);
+    case SENSOR_SETTING_SAMPLE_PERIOD:
+    case SENSOR_SETTING_REPEATABILITY:
+    case SENSOR_SETTING_FREQUENCY:
+    case SENSOR_SETTING_ART:
+    case SENSOR_SETTING_FILTER_DEPTH:
+        /* Read on every new sample of the SHT35 of the zone */
+        return sensor_drivers[index].read_period_ms == 0;
+    default:
+        return false;
     }
+}
 
-    /* Mesh Model Spec:
-     * Or the Length shall represent the value of zero and the Raw Value field shall
-     * contain only the Property ID if the requested device property is not recognized
-     * by the Sensor Server.
-     */
-    mpid = ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID(ESP_BLE_MESH_SENSOR_DATA_ZERO_LEN,
-            param->value.get.sensor_data.property_id);
-    memcpy(status, &mpid, ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN);
-    length = ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN;
-
-send:
-    ESP_LOG_BUFFER_HEX("Sensor Data", status, length);
-
-    err = esp_ble_mesh_server_model_send_msg(param->model, &param->ctx,
-            ESP_BLE_MESH_MODEL_OP_SENSOR_STATUS, length, status);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send Sensor Status");
+static uint8_t example_ble_mesh_read_setting(int index, uint16_t setting_prop_id, uint8_t *raw)
+/* Writes the present value of a setting of the sensor into raw, returns its length */
+{
+    const acquisition_settings_t *settings = &sensor_zone_settings[sensor_zone_of[index]];
+
+    switch (setting_prop_id) {
+    case SENSOR_SETTING_SAMPLE_PERIOD:
+        memcpy(raw, &settings->sample_period_ms, sizeof(uint32_t));
+        return sizeof(uint32_t);
+    case SENSOR_SETTING_REPEATABILITY:
+        raw[0] = settings->repeatability;
+        return 1;
+    case SENSOR_SETTING_FREQUENCY:
+        raw[0] = settings->frequency;
+        return 1;
+    case SENSOR_SETTING_ART:
+        raw[0] = settings->art;
+        return 1;
+    case SENSOR_SETTING_FILTER_DEPTH:
+        raw[0] = settings->filter_depth;
+        return 1;
+    default:
+        raw[0] = sensor_encodings[index];
+        return 1;
     }
-    free(status);
 }
 
-static void example_ble_mesh_publish_sensor_status()
+static void example_ble_mesh_load_settings(void)
+/* Settings of an earlier Sensor Setting Set, the defaults stay for what was never set or is no longer valid */
 {
-    uint8_t *status = NULL;
-    uint16_t buf_size = 0;
-    uint16_t length = 0;
-    //uint32_t mpid = 0;
-    esp_err_t err;
+    acquisition_settings_t settings;
+    uint8_t encodings[SENSOR_COUNT];
+    char key[8];
+    uint8_t zone;
     int i;
 
-    for (i = 0; i < ARRAY_SIZE(sensor_states); i++) {
-        esp_ble_mesh_sensor_state_t *state = &sensor_states[i];
-        if (state->sensor_data.length == ESP_BLE_MESH_SENSOR_DATA_ZERO_LEN) {
-            buf_size += ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN;
-        } else {
-            /* Use "state->sensor_data.length + 1" because the length of sensor data is zero-based. */
-            if (state->sensor_data.format == ESP_BLE_MESH_SENSOR_DATA_FORMAT_A) {
-                buf_size += ESP_BLE_MESH_SENSOR_DATA_FORMAT_A_MPID_LEN + state->sensor_data.length + 1;
-            } else {
-                buf_size += ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN + state->sensor_data.length + 1;
+    if (settings_load(SENSOR_SETTINGS_KEY_ENCODINGS, encodings, sizeof(encodings)) == ESP_OK) {
+        for (i = 0; i < SENSOR_COUNT; i++) {
+            if (encodings[i] < ENCODING_COUNT && encoding_supported(&sensor_formats[i], encodings[i])) {
+                sensor_encodings[i] = encodings[i];
             }
         }
     }
 
-    status = calloc(1, buf_size);
-    if (!status) {
-        ESP_LOGE(TAG, "No memory for sensor status!");
+    for (zone = 0; zone < SENSOR_ZONE_COUNT; zone++) {
+        snprintf(key, sizeof(key), SENSOR_SETTINGS_KEY_ZONE, zone);
+        if (settings_load(key, &settings, sizeof(settings)) == ESP_OK && acquisition_check_settings(&settings) == ESP_OK) {
+            sensor_zone_settings[zone] = settings;
+        }
+    }
+#if CONFIG_SENSOR_BATCH_SIZE > 1
+    if (settings_load(SENSOR_SETTINGS_KEY_BATCH_PERIODS, sensor_batch_periods, sizeof(sensor_batch_periods)) != ESP_OK) {
+        memset(sensor_batch_periods, 0, sizeof(sensor_batch_periods));
+    }
+#endif
+}
+
+static void example_ble_mesh_send_sensor_settings_status(esp_ble_mesh_sensor_server_cb_param_t *param)
+{
+    uint8_t status[ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN + ARRAY_SIZE(sensor_setting_ids) * ESP_BLE_MESH_SENSOR_SETTING_PROPERTY_ID_LEN];
+    uint16_t property_id = param->value.get.sensor_settings.property_id;
+    uint16_t length = ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN;
+    esp_err_t err;
+    int i, j;
+
+    memcpy(status, &property_id, ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN);
+    i = example_ble_mesh_find_sensor(example_ble_mesh_model_zone(param->model), property_id);
+    for (j = 0; i >= 0 && j < ARRAY_SIZE(sensor_setting_ids); j++) {
+        if (example_ble_mesh_has_setting(i, sensor_setting_ids[j])) {
+            memcpy(status + length, &sensor_setting_ids[j], ESP_BLE_MESH_SENSOR_SETTING_PROPERTY_ID_LEN);
+            length += ESP_BLE_MESH_SENSOR_SETTING_PROPERTY_ID_LEN;
+        }
+    }
+
+    err = esp_ble_mesh_server_model_send_msg(param->model, &param->ctx,
+            ESP_BLE_MESH_MODEL_OP_SENSOR_SETTINGS_STATUS, length, status);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send Sensor Settings Status");
+    }
+}
+
+struct example_sensor_setting {
+    uint16_t sensor_prop_id;
+    uint16_t sensor_setting_prop_id;
+    uint8_t sensor_setting_access;
+    uint8_t sensor_setting_raw[SENSOR_SETTING_RAW_MAX_LEN];
+} __attribute__((packed));
+
+static uint16_t example_ble_mesh_get_sensor_setting(int index, uint16_t property_id, uint16_t setting_prop_id,
+                                                    struct example_sensor_setting *setting)
+/* Marshals the Sensor Setting Status of the sensor at index, which is -1 for an unknown sensor */
+{
+    setting->sensor_prop_id = property_id;
+    setting->sensor_setting_prop_id = setting_prop_id;
+
+    /* Mesh Model Spec:
+     * If the message is sent as a response to the Sensor Setting Get message or
+     * a Sensor Setting Set message with an unknown Sensor Property ID field or
+     * an unknown Sensor Setting Property ID field, the Sensor Setting Access
+     * field and the Sensor Setting Raw field shall be omitted.
+     */
+    if (index < 0 || !example_ble_mesh_has_setting(index, setting_prop_id)) {
+        return offsetof(struct example_sensor_setting, sensor_setting_access);
+    }
+
+    setting->sensor_setting_access = SENSOR_SETTING_ACCESS_READ_WRITE;
+    return offsetof(struct example_sensor_setting, sensor_setting_raw)
+           + example_ble_mesh_read_setting(index, setting_prop_id, setting->sensor_setting_raw);
+}
+
+static void example_ble_mesh_send_sensor_setting_status(esp_ble_mesh_model_t *model, esp_ble_mesh_msg_ctx_t *ctx,
+                                                        uint16_t property_id, uint16_t setting_prop_id)
+{
+    struct example_sensor_setting setting = {0};
+    uint16_t length;
+    esp_err_t err;
+    int i;
+
+    i = example_ble_mesh_find_sensor(example_ble_mesh_model_zone(model), property_id);
+    length = example_ble_mesh_get_sensor_setting(i, property_id, setting_prop_id, &setting);
+
+    err = esp_ble_mesh_server_model_send_msg(model, ctx,
+            ESP_BLE_MESH_MODEL_OP_SENSOR_SETTING_STATUS, length, (uint8_t *)&setting);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send Sensor Setting Status");
+    }
+}
+
+static void example_ble_mesh_publish_sensor_setting(uint8_t zone, int index, uint16_t setting_prop_id)
+/* Tells the gateway about a changed setting */
+{
+    struct example_sensor_setting setting = {0};
+    esp_ble_mesh_model_t *model = sensor_setup_servers[zone].model;
+    uint16_t length;
+    esp_err_t err;
+
+    if (model == NULL || model->pub->publish_addr == ESP_BLE_MESH_ADDR_UNASSIGNED) {
+        return;
+    }
+    length = example_ble_mesh_get_sensor_setting(index, sensor_states[index].sensor_property_id,
+                                                 setting_prop_id, &setting);
+    err = esp_ble_mesh_model_publish(model, ESP_BLE_MESH_MODEL_OP_SENSOR_SETTING_STATUS,
+                                     length, (uint8_t *)&setting, ROLE_NODE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to publish Sensor Setting Status (err %d)", err);
+    }
+}
+
+static void example_ble_mesh_set_sensor_encoding(int index, encoding_t encoding)
+/* Lays the sensor status out again for the new raw value length */
+{
+    esp_err_t err;
+
+    taskENTER_CRITICAL(&sensor_status_lock);
+    sensor_encodings[index] = encoding;
+    example_ble_mesh_build_sensor_status();
+    taskEXIT_CRITICAL(&sensor_status_lock);
+
+    /* Cadence thresholds are raw values, they have no meaning in the new encoding */
+    cadence_init(&cadence_trackers[index], &sensor_states[index], sensor_formats[index].is_signed);
+
+    ESP_LOGI(TAG, "Sensor %s sends %d octet raw values (encoding %d)", sensor_drivers[index].name,
+        sensor_status_entries[index].value_len, encoding);
+
+    err = settings_store(SENSOR_SETTINGS_KEY_ENCODINGS, sensor_encodings, sizeof(sensor_encodings));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Encodings not stored (err %d)", err);
+    }
+}
+
+static esp_err_t example_ble_mesh_set_sampling(uint8_t zone, uint16_t setting_prop_id, const struct net_buf_simple *raw)
+/* Reconfigures the SHT35 of the zone while it is sampled and stores its new settings */
+{
+    acquisition_settings_t settings = sensor_zone_settings[zone];
+    char key[8];
+    esp_err_t err;
+
+    if (raw->len != (setting_prop_id == SENSOR_SETTING_SAMPLE_PERIOD ? sizeof(uint32_t) : 1)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    switch (setting_prop_id) {
+    case SENSOR_SETTING_SAMPLE_PERIOD:
+        memcpy(&settings.sample_period_ms, raw->data, sizeof(uint32_t));
+        break;
+    case SENSOR_SETTING_REPEATABILITY:
+        settings.repeatability = raw->data[0];
+        break;
+    case SENSOR_SETTING_FREQUENCY:
+        settings.frequency = raw->data[0];
+        break;
+    case SENSOR_SETTING_ART:
+        if (raw->data[0] > 1) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        settings.art = raw->data[0];
+        break;
+    default:
+        settings.filter_depth = raw->data[0];
+        break;
+    }
+
+    err = acquisition_configure(zone, &settings);
+    if (err != ESP_OK) {
+        return err;
+    }
+    sensor_zone_settings[zone] = settings;
+
+    snprintf(key, sizeof(key), SENSOR_SETTINGS_KEY_ZONE, zone);
+    err = settings_store(key, &settings, sizeof(settings));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Settings of zone %u not stored (err %d)", zone, err);
+    }
+    return ESP_OK;
+}
+
+static void example_ble_mesh_set_sensor_setting(esp_ble_mesh_sensor_server_cb_param_t *param)
+{
+    uint8_t zone = example_ble_mesh_model_zone(param->model);
+    uint16_t property_id = param->value.set.sensor_setting.property_id;
+    uint16_t setting_prop_id = param->value.set.sensor_setting.setting_property_id;
+    struct net_buf_simple *raw = param->value.set.sensor_setting.setting_raw;
+    esp_err_t err;
+    int i;
+
+    i = example_ble_mesh_find_sensor(zone, property_id);
+    if (i < 0 || !example_ble_mesh_has_setting(i, setting_prop_id) || raw == NULL || raw->len == 0) {
         return;
     }
 
+    if (setting_prop_id == SENSOR_SETTING_ENCODING) {
+        if (raw->len != 1 || raw->data[0] >= ENCODING_COUNT || !encoding_supported(&sensor_formats[i], raw->data[0])) {
+            ESP_LOGW(TAG, "Ignored encoding %d for 0x%04x", raw->data[0], property_id);
+            return;
+        }
+        if (raw->data[0] == sensor_encodings[i]) {
+            return;
+        }
+        example_ble_mesh_set_sensor_encoding(i, raw->data[0]);
+    } else {
+        err = example_ble_mesh_set_sampling(zone, setting_prop_id, raw);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Ignored setting 0x%04x for 0x%04x (err %d)", setting_prop_id, property_id, err);
+            return;
+        }
+    }
+    example_ble_mesh_publish_sensor_setting(zone, i, setting_prop_id);
+}
 
-    for (i = 0; i < ARRAY_SIZE(sensor_states); i++) {
-        length += example_ble_mesh_get_sensor_data(&sensor_states[i], status + length);
+/* Key of a Sensor Get without Property ID, property IDs are 16 bit */
+#define SENSOR_GET_ALL  0x10000
+
+static uint16_t example_ble_mesh_get_sensor_status(uint8_t zone, uint32_t key, uint8_t *status)
+/* Marshals the Sensor Status answering a Sensor Get of key into status, a copy because the layout may
+ * change while it is sent */
+{
+    uint16_t length;
+    uint32_t mpid = 0;
+    int i;
+
+    if (key == SENSOR_GET_ALL) {
+        /* Mesh Model Spec:
+         * If the message is sent as a response to the Sensor Get message, and if the
+         * Property ID field of the incoming message is omitted, the Marshalled Sensor
+         * Data field shall contain data for all device properties within a sensor.
+         * Those are the sensors of the zone of the element.
+         */
+        taskENTER_CRITICAL(&sensor_status_lock);
+        length = sensor_zones[zone].status_len;
+        memcpy(status, sensor_status + sensor_zones[zone].status_offset, length);
+        taskEXIT_CRITICAL(&sensor_status_lock);
+        return length;
     }
 
+    /* Mesh Model Spec:
+     * Otherwise, the Marshalled Sensor Data field shall contain data for the requested
+     * device property only.
+     */
+    i = example_ble_mesh_find_sensor(zone, key);
+    if (i >= 0) {
+        taskENTER_CRITICAL(&sensor_status_lock);
+        length = sensor_status_entries[i].length;
+        memcpy(status, sensor_status + sensor_status_entries[i].offset, length);
+        taskEXIT_CRITICAL(&sensor_status_lock);
+        return length;
+    }
 
+    /* Mesh Model Spec:
+     * Or the Length shall represent the value of zero and the Raw Value field shall
+     * contain only the Property ID if the requested device property is not recognized
+     * by the Sensor Server.
+     */
+    mpid = ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID(ESP_BLE_MESH_SENSOR_DATA_ZERO_LEN, key);
+    memcpy(status, &mpid, ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN);
+    return ESP_BLE_MESH_SENSOR_DATA_FORMAT_B_MPID_LEN;
+}
+
+static uint8_t example_ble_mesh_answer_sensor_get(esp_ble_mesh_model_t *model, uint32_t key,
+                                                  const esp_ble_mesh_msg_ctx_t *requesters, uint8_t count)
+/* Answers the Sensor Gets of key, from the mesh callback or from a closing coalescing window.
+ * Every requester gets the same snapshot */
+{
+    uint8_t status[sizeof(struct sensor_status_layout)];
+    esp_ble_mesh_msg_ctx_t ctx;
+    uint16_t length;
+    uint8_t i;
+    esp_err_t err;
+
+    length = example_ble_mesh_get_sensor_status(example_ble_mesh_model_zone(model), key, status);
     ESP_LOG_BUFFER_HEX("Sensor Data", status, length);
 
+#if defined(CONFIG_SENSOR_GET_COALESCE_GROUP)
+    /* Group and fixed group addresses have the two top bits set. Sent with the keys of the first
+     * requester, the publication buffer of the model belongs to the main loop */
+    if (count > 1 && model->pub->publish_addr >= 0xC000) {
+        ctx = requesters[0];
+        ctx.addr = model->pub->publish_addr;
+        err = esp_ble_mesh_server_model_send_msg(model, &ctx, ESP_BLE_MESH_MODEL_OP_SENSOR_STATUS, length, status);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to send Sensor Status to 0x%04x", ctx.addr);
+        }
+        return 1;
+    }
+#endif
+
+    for (i = 0; i < count; i++) {
+        ctx = requesters[i];
+        err = esp_ble_mesh_server_model_send_msg(model, &ctx, ESP_BLE_MESH_MODEL_OP_SENSOR_STATUS, length, status);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to send Sensor Status");
+        }
+    }
+    return count;
+}
+
+static void example_ble_mesh_send_sensor_status(esp_ble_mesh_sensor_server_cb_param_t *param)
+/* A burst of Gets for the same data is answered once, see coalesce.c */
+{
+    uint32_t key = param->value.get.sensor_data.op_en ? param->value.get.sensor_data.property_id : SENSOR_GET_ALL;
+
+    if (!coalesce_get(param->model, key, &param->ctx)) {
+        example_ble_mesh_answer_sensor_get(param->model, key, &param->ctx, 1);
+    }
+}
+
+static void example_ble_mesh_zone_published(uint8_t zone, const int32_t *values, TickType_t now)
+/* Bookkeeping of a publication of the fine values of the zone: Sensor Cadence, sample log and console */
+{
+    static _Bool first_published = false;
+    int i;
+
+    if (!first_published) {
+        first_published = true;
+        ESP_LOGI(TAG, "Time to first publish: %u ms after reset, %s", (uint32_t)(esp_timer_get_time() / 1000),
+            mesh_state_restored ? "mesh state restored" : "provisioned after boot");
+    }
+
+    for (i = 0; i < sensor_zones[zone].count; i++) {
+        int index = sensor_zones[zone].first + i;
+
+        /* The Sensor Status of a zone carries all its sensors, so every state of the zone counts as published */
+        taskENTER_CRITICAL(&sensor_status_lock);
+        cadence_published(&cadence_trackers[index],
+                          encoding_apply(&sensor_formats[index], sensor_encodings[index], values[i]), now);
+        taskEXIT_CRITICAL(&sensor_status_lock);
+        sample_log_append(zone, sensor_states[index].sensor_property_id, values[i]);
+
+        /* Data format:
+        [Info tag (unimportant)] [? (uninportant)] DATA: 0x[publish addr] 0x[received from addr] 0x[property ID] [data] end*/
+        ESP_LOGI(DATA_TAG, "0x%04x 0x%04x 0x%02x %d end", sensor_zone_models[zone]->pub->publish_addr, 0x0000,
+            sensor_states[index].sensor_property_id, (int)values[i]);
+    }
+#if defined(CONFIG_BLE_MESH_LOW_POWER)
+    example_ble_mesh_lpn_poll();
+#endif
+}
+
+static void example_ble_mesh_sensor_publication_update(esp_ble_mesh_model_t *model)
+/* Raised by the stack at every periodic publication of a model. The stack has just sent the buffer of the
+ * Sensor Server, the freshest cached samples of its zone go in for the next period. This is the only place
+ * the buffer is refilled once the stack runs, in batch mode the stack does not publish periodically */
+{
+    uint8_t zone;
+
+    for (zone = 0; zone < SENSOR_ZONE_COUNT; zone++) {
+        if (sensor_zone_models[zone] == model) {
+            break;
+        }
+    }
+    if (zone == SENSOR_ZONE_COUNT) {
+        return;
+    }
+
+    ESP_LOG_BUFFER_HEX("Sensor Data", model->pub->msg->data + 1, model->pub->msg->len - 1);
+    example_ble_mesh_zone_published(zone, &sensor_publication_values[sensor_zones[zone].first], xTaskGetTickCount());
+    example_ble_mesh_fill_sensor_publication(zone);
+    indicator_post(INDICATOR_PUBLISHED);
+}
 
-    sensor_pub.ttl = 7;
-    err = esp_ble_mesh_model_publish(&root_models[1], ESP_BLE_MESH_MODEL_OP_SENSOR_STATUS, length, status, ROLE_NODE);
+static void example_ble_mesh_publish_sensor_status(uint8_t zone)
+/* Publishes the zone between the periodic publications, when a status trigger of the Sensor Cadence fires */
+{
+    static uint8_t status[sizeof(struct sensor_status_layout)];
+    esp_ble_mesh_model_t *model = sensor_zone_models[zone];
+    uint16_t length;
+    esp_err_t err;
+
+    if (model->pub->publish_addr == ESP_BLE_MESH_ADDR_UNASSIGNED) {
+        return;
+    }
+
+    /* The message replaces the publication buffer, the next periodic publication repeats it */
+    taskENTER_CRITICAL(&sensor_status_lock);
+    length = sensor_zones[zone].status_len;
+    memcpy(status, sensor_status + sensor_zones[zone].status_offset, length);
+    memcpy(&sensor_publication_values[sensor_zones[zone].first], &sensor_values[sensor_zones[zone].first],
+           sensor_zones[zone].count * sizeof(int32_t));
+    taskEXIT_CRITICAL(&sensor_status_lock);
+
+    ESP_LOG_BUFFER_HEX("Sensor Data", status, length);
+
+    /* TTL and retransmissions are those of the publication parameters */
+    err = esp_ble_mesh_model_publish(model, ESP_BLE_MESH_MODEL_OP_SENSOR_STATUS, length, status, ROLE_NODE);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to send Sensor Status %x", err);
+        indicator_post(INDICATOR_ERROR);
     } else {
-    	LED_setcolor(0, 255, 0);
-    	vTaskDelay(pdMS_TO_TICKS(50));
-    	LED_setcolor(0, 0, 0);
+        indicator_post(INDICATOR_PUBLISHED);
     }
-    free(status);
 }
 
-static void example_ble_mesh_send_sensor_column_status(esp_ble_mesh_sensor_server_cb_param_t *param)
+static void example_ble_mesh_batch_sensor_status(uint8_t zone)
+/* Adds the present values of the zone to its batch, a full batch is published in one message */
 {
-    uint8_t *status = NULL;
-    uint16_t length = 0;
+    static uint8_t batch[TELEMETRY_MAX_LEN];
+    uint16_t length;
     esp_err_t err;
 
-    length = ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN +param->value.get.sensor_column.raw_value_x->len;
+    if (!telemetry_add(&sensor_batches[zone], &sensor_values[sensor_zones[zone].first])) {
+        return;
+    }
+    length = telemetry_encode(&sensor_batches[zone], batch);
+
+    ESP_LOG_BUFFER_HEX("Sensor Batch", batch, length);
+
+    err = esp_ble_mesh_model_publish(&vnd_models[1], TELEMETRY_OP_BATCH, length, batch, ROLE_NODE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send Sensor Batch %x", err);
+        indicator_post(INDICATOR_ERROR);
+    } else {
+        indicator_post(INDICATOR_PUBLISHED);
+    }
+}
+
+/* Time the main loop spends publishing a zone, the LED flash used to block it for more than 50 ms */
+static struct {
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t max_us;
+    int64_t next_log_us;
+} publish_latency;
+
+static void example_publish_latency_record(int64_t start_us)
+/* Logged at the scheduler statistics period */
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t latency_us = now - start_us;
 
-    status = calloc(1, length);
-    if (!status) {
-        ESP_LOGE(TAG, "No memory for sensor column status!");
+    publish_latency.count++;
+    publish_latency.total_us += latency_us;
+    if (latency_us > publish_latency.max_us) {
+        publish_latency.max_us = latency_us;
+    }
+
+    if (CONFIG_SENSOR_STATS_PERIOD_S == 0 || now < publish_latency.next_log_us) {
+        return;
+    }
+    ESP_LOGI(TAG, "Publish latency: %u publications, mean %u us, max %u us, LED events dropped %u, "
+        "log records dropped %u", publish_latency.count, (uint32_t)(publish_latency.total_us / publish_latency.count),
+        publish_latency.max_us, indicator_dropped(), sample_log_dropped());
+    publish_latency.count = 0;
+    publish_latency.total_us = 0;
+    publish_latency.max_us = 0;
+    publish_latency.next_log_us = now + (int64_t)CONFIG_SENSOR_STATS_PERIOD_S * 1000000;
+}
+
+static uint32_t heap_low_watermark = UINT32_MAX;
+static uint32_t heap_watermark_drops = 0;
+
+static void example_heap_watermark_check(void)
+/* The steady state publish loop should not allocate; once it has run a few times the
+ * low watermark should not move anymore. Every drop is counted and logged */
+{
+    uint32_t low = esp_get_minimum_free_heap_size();
+
+    if (low >= heap_low_watermark) {
         return;
     }
+    if (heap_low_watermark != UINT32_MAX) {
+        heap_watermark_drops++;
+        ESP_LOGW(TAG, "Heap low watermark %u -> %u bytes (free %u, drops %u)", heap_low_watermark, low,
+            esp_get_free_heap_size(), heap_watermark_drops);
+    }
+    heap_low_watermark = low;
+}
+
+/* Mesh Model Spec:
+ * The Sensor Series Status is an access message, the Property ID and the columns fill
+ * at most the 384 octets of a segmented message less the opcode and the TransMIC.
+ * The responses are built in static buffers, they are only sent from the mesh callbacks.
+ */
+#define SENSOR_SERIES_STATUS_MAX_LEN    (ESP_BLE_MESH_SDU_MAX_LEN - 1 - ESP_BLE_MESH_MIC_SHORT)
+
+static void example_ble_mesh_send_sensor_column_status(esp_ble_mesh_sensor_server_cb_param_t *param)
+{
+    static uint8_t status[ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN + 3 * SENSOR_DATA_MAX_LEN];
+    struct net_buf_simple *raw_value_x = param->value.get.sensor_column.raw_value_x;
+    uint16_t length = ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN;
+    esp_err_t err;
+    int i;
 
     memcpy(status, &param->value.get.sensor_column.property_id, ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN);
-    memcpy(status + ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN, param->value.get.sensor_column.raw_value_x->data,
-        param->value.get.sensor_column.raw_value_x->len);
+
+    /* Mesh Model Spec:
+     * The Raw Value X field identifies the column. If the requested column does not exist,
+     * the Column Width and Raw Value Y fields shall be omitted.
+     */
+    i = example_ble_mesh_find_sensor(example_ble_mesh_model_zone(param->model),
+            param->value.get.sensor_column.property_id);
+    if (i >= 0 && raw_value_x->len == sensor_formats[i].length) {
+        memcpy(status + length, raw_value_x->data, raw_value_x->len);
+        length += raw_value_x->len;
+        length += history_column(&sensor_history[i], raw_value_x->data, raw_value_x->len, status + length);
+    }
 
     err = esp_ble_mesh_server_model_send_msg(param->model, &param->ctx,
             ESP_BLE_MESH_MODEL_OP_SENSOR_COLUMN_STATUS, length, status);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to send Sensor Column Status");
     }
-    free(status);
 }
 
 static void example_ble_mesh_send_sensor_series_status(esp_ble_mesh_sensor_server_cb_param_t *param)
 {
+    static uint8_t status[SENSOR_SERIES_STATUS_MAX_LEN];
+    struct net_buf_simple *range = param->value.get.sensor_series.raw_value;
+    uint16_t length = ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN;
+    int32_t min, max, mean;
     esp_err_t err;
+    int i;
+
+    memcpy(status, &param->value.get.sensor_series.property_id, ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN);
+
+    /* Mesh Model Spec:
+     * The Raw Value X1 and Raw Value X2 fields are optional, when present only the columns
+     * from X1 up to X2 are sent. An unknown Property ID gets the Property ID only.
+     */
+    i = example_ble_mesh_find_sensor(example_ble_mesh_model_zone(param->model),
+            param->value.get.sensor_series.property_id);
+    if (i >= 0) {
+        if (param->value.get.sensor_series.op_en && range != NULL) {
+            length += history_series(&sensor_history[i], range->data, range->len, status + length,
+                sizeof(status) - length);
+        } else {
+            length += history_series(&sensor_history[i], NULL, 0, status + length, sizeof(status) - length);
+        }
+        if (history_window(&sensor_history[i], &min, &max, &mean)) {
+            ESP_LOGI(TAG, "History of %s: min %d, max %d, mean %d", sensor_drivers[i].name,
+                (int)min, (int)max, (int)mean);
+        }
+    }
 
     err = esp_ble_mesh_server_model_send_msg(param->model, &param->ctx,
-            ESP_BLE_MESH_MODEL_OP_SENSOR_SERIES_STATUS,
-            ESP_BLE_MESH_SENSOR_PROPERTY_ID_LEN,
-            (uint8_t *)&param->value.get.sensor_series.property_id);
+            ESP_BLE_MESH_MODEL_OP_SENSOR_SERIES_STATUS, length, status);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send Sensor Column Status");
+        ESP_LOGE(TAG, "Failed to send Sensor Series Status");
     }
 }
 
@@ -594,7 +1587,7 @@ static void example_ble_mesh_sensor_server_cb(esp_ble_mesh_sensor_server_cb_even
             break;
         case ESP_BLE_MESH_MODEL_OP_SENSOR_CADENCE_GET:
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_SENSOR_CADENCE_GET");
-            example_ble_mesh_send_sensor_cadence_status(param);
+            example_ble_mesh_send_sensor_cadence_status(param, param->value.get.sensor_cadence.property_id);
             break;
         case ESP_BLE_MESH_MODEL_OP_SENSOR_SETTINGS_GET:
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_SENSOR_SETTINGS_GET");
@@ -602,7 +1595,8 @@ static void example_ble_mesh_sensor_server_cb(esp_ble_mesh_sensor_server_cb_even
             break;
         case ESP_BLE_MESH_MODEL_OP_SENSOR_SETTING_GET:
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_SENSOR_SETTINGS_GET");
-            example_ble_mesh_send_sensor_setting_status(param);
+            example_ble_mesh_send_sensor_setting_status(param->model, &param->ctx,
+                param->value.get.sensor_setting.property_id, param->value.get.sensor_setting.setting_property_id);
             break;
         case ESP_BLE_MESH_MODEL_OP_SENSOR_GET:
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_SENSOR_GET");
@@ -625,17 +1619,22 @@ static void example_ble_mesh_sensor_server_cb(esp_ble_mesh_sensor_server_cb_even
         switch (param->ctx.recv_op) {
         case ESP_BLE_MESH_MODEL_OP_SENSOR_CADENCE_SET:
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_SENSOR_CADENCE_SET");
-            example_ble_mesh_send_sensor_cadence_status(param);
+            example_ble_mesh_set_sensor_cadence(param);
+            example_ble_mesh_send_sensor_cadence_status(param, param->value.set.sensor_cadence.property_id);
             break;
         case ESP_BLE_MESH_MODEL_OP_SENSOR_CADENCE_SET_UNACK:
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_SENSOR_CADENCE_SET_UNACK");
+            example_ble_mesh_set_sensor_cadence(param);
             break;
         case ESP_BLE_MESH_MODEL_OP_SENSOR_SETTING_SET:
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_SENSOR_SETTING_SET");
-            example_ble_mesh_send_sensor_setting_status(param);
+            example_ble_mesh_set_sensor_setting(param);
+            example_ble_mesh_send_sensor_setting_status(param->model, &param->ctx,
+                param->value.set.sensor_setting.property_id, param->value.set.sensor_setting.setting_property_id);
             break;
         case ESP_BLE_MESH_MODEL_OP_SENSOR_SETTING_SET_UNACK:
             ESP_LOGI(TAG, "ESP_BLE_MESH_MODEL_OP_SENSOR_SETTING_SET_UNACK");
+            example_ble_mesh_set_sensor_setting(param);
             break;
         default:
             ESP_LOGE(TAG, "Unknown Sensor Set opcode 0x%04x", param->ctx.recv_op);
@@ -648,6 +1647,108 @@ static void example_ble_mesh_sensor_server_cb(esp_ble_mesh_sensor_server_cb_even
     }
 }
 
+static uint32_t example_ble_mesh_publish_period_ms(uint8_t zone)
+/* Mesh Profile Spec: Publish Period is a 6 bit step count with a 2 bit resolution of 100 ms, 1 s, 10 s or 10 min.
+ * Without a configured period the sample period of the zone is used */
+{
+    static const uint32_t resolution_ms[] = { 100, 1000, 10000, 600000 };
+#if CONFIG_SENSOR_BATCH_SIZE > 1
+    uint8_t period = sensor_batch_periods[zone];
+#else
+    uint8_t period = sensor_zone_models[zone]->pub->period;
+#endif
+    uint32_t steps = period & 0x3F;
+
+    if (steps == 0) {
+        return sensor_zone_settings[zone].sample_period_ms;
+    }
+    return steps * resolution_ms[period >> 6];
+}
+
+#if CONFIG_SENSOR_BATCH_SIZE > 1
+static _Bool example_ble_mesh_zone_publish_due(uint8_t zone, TickType_t now, TickType_t *wait_ticks)
+/* True when a sensor of the zone is due for publication, the others lower wait_ticks to the time until they are */
+{
+    uint32_t period_ms = example_ble_mesh_publish_period_ms(zone);
+    TickType_t ticks_to_due;
+    _Bool due = false;
+    int i;
+
+    for (i = sensor_zones[zone].first; i < sensor_zones[zone].first + sensor_zones[zone].count; i++) {
+        if (cadence_publish_due(&cadence_trackers[i], period_ms, now, &ticks_to_due)) {
+            due = true;
+        } else if (ticks_to_due < *wait_ticks) {
+            *wait_ticks = ticks_to_due;
+        }
+    }
+    return due;
+}
+#else
+static _Bool example_ble_mesh_zone_trigger_due(uint8_t zone, TickType_t now, TickType_t *wait_ticks)
+/* True when a status trigger of a sensor of the zone fires, triggers held back by the minimum interval
+ * lower wait_ticks to the time until they may fire */
+{
+    TickType_t ticks_to_due = portMAX_DELAY;
+    _Bool due = false;
+    int i;
+
+    taskENTER_CRITICAL(&sensor_status_lock);
+    for (i = sensor_zones[zone].first; i < sensor_zones[zone].first + sensor_zones[zone].count; i++) {
+        if (cadence_trigger_due(&cadence_trackers[i], now, &ticks_to_due)) {
+            due = true;
+        } else if (ticks_to_due < *wait_ticks) {
+            *wait_ticks = ticks_to_due;
+        }
+    }
+    taskEXIT_CRITICAL(&sensor_status_lock);
+    return due;
+}
+
+static void example_ble_mesh_apply_fast_cadence(uint8_t zone)
+/* The stack divides the Publish Period by 2^period_div while fast_period is set, the fastest cadence of the
+ * sensors of the zone is used. A change takes effect from the next period */
+{
+    esp_ble_mesh_model_pub_t *pub = sensor_zone_models[zone]->pub;
+    uint32_t period_ms = example_ble_mesh_publish_period_ms(zone);
+    uint8_t divisor = 0, sensor_divisor;
+    int i;
+
+    for (i = sensor_zones[zone].first; i < sensor_zones[zone].first + sensor_zones[zone].count; i++) {
+        sensor_divisor = cadence_period_divisor(&cadence_trackers[i], period_ms);
+        if (sensor_divisor > divisor) {
+            divisor = sensor_divisor;
+        }
+    }
+
+    /* The stack updates the retransmit count next to these bits, they are only written on a change */
+    if (pub->fast_period != (divisor > 0) || pub->period_div != divisor) {
+        pub->period_div = divisor;
+        pub->fast_period = divisor > 0;
+    }
+}
+#endif
+
+static void example_ble_mesh_custom_model_cb(esp_ble_mesh_model_cb_event_t event,
+                                             esp_ble_mesh_model_cb_param_t *param)
+{
+    switch (event) {
+    case ESP_BLE_MESH_MODEL_OPERATION_EVT:
+        backfill_receive(param->model_operation.model, param->model_operation.ctx, param->model_operation.opcode,
+            param->model_operation.msg, param->model_operation.length);
+        break;
+    case ESP_BLE_MESH_MODEL_SEND_COMP_EVT:
+        if (param->model_send_comp.err_code) {
+            ESP_LOGE(TAG, "Failed to send message 0x%06x", param->model_send_comp.opcode);
+        }
+        break;
+    case ESP_BLE_MESH_MODEL_PUBLISH_UPDATE_EVT:
+        example_ble_mesh_sensor_publication_update(param->model_publish_update.model);
+        break;
+    default:
+        break;
+    }
+}
+
 static esp_err_t ble_mesh_init(void)
 {
     esp_err_t err;
@@ -655,6 +1756,7 @@ static esp_err_t ble_mesh_init(void)
     esp_ble_mesh_register_prov_callback(example_ble_mesh_provisioning_cb);
     esp_ble_mesh_register_config_server_callback(example_ble_mesh_config_server_cb);
     esp_ble_mesh_register_sensor_server_callback(example_ble_mesh_sensor_server_cb);
+    esp_ble_mesh_register_custom_model_callback(example_ble_mesh_custom_model_cb);
 
     err = esp_ble_mesh_init(&provision, &composition);
     if (err != ESP_OK) {
@@ -673,20 +1775,64 @@ static esp_err_t ble_mesh_init(void)
     return ESP_OK;
 }
 
+static void example_power_init(void)
+{
+    /* The CPU drops to POWER_MIN_FREQ_MHZ whenever no task or the BLE controller holds a lock. Light
+     * sleep only happens while the controller does not scan, which for a node that is not a Low Power
+     * Node is never, so it mostly saves on the frequency */
+#if CONFIG_PM_ENABLE
+    esp_err_t err;
+    esp_pm_config_esp32c3_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP32C3_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+
+    err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Power management config failed (err %d)", err);
+        return;
+    }
+    ESP_LOGI(TAG, "Power management: %d - %d MHz, light sleep %d",
+        pm_config.min_freq_mhz, pm_config.max_freq_mhz, pm_config.light_sleep_enable);
+#else
+    ESP_LOGW(TAG, "Power management disabled, CONFIG_PM_ENABLE is not set");
+#endif
+}
+
 void app_main(void)
 {
     esp_err_t err;
+    uint8_t zone;
+    int i;
 
-    err = i2c_master_init();
+    err = i2c_master_init(I2C_MASTER_NUM, I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO);
     if (err) {
         ESP_LOGE(TAG, "I2C init error", err);
     }
+#if CONFIG_SHT35_SENSOR_COUNT > 2
+    err = i2c_master_init(I2C_NUM_1, CONFIG_SHT35_BUS1_SDA_GPIO, CONFIG_SHT35_BUS1_SCL_GPIO);
+    if (err) {
+        ESP_LOGE(TAG, "I2C1 init error (err %d)", err);
+    }
+#endif
 
     ESP_LOGI(TAG, "Initializing...");
 
-    LED_init();
-    vTaskDelay(pdMS_TO_TICKS(10));
-    LED_setcolor(0, 255, 255);
+    example_power_init();
+
+    err = sensors_init();
+    if (err) {
+        ESP_LOGE(TAG, "Sensors init failed (err %d)", err);
+    }
+
+    err = indicator_start();
+    if (err) {
+        ESP_LOGE(TAG, "Indicator start failed (err %d)", err);
+    }
+    indicator_post(INDICATOR_BOOT);
 
     err = nvs_flash_init();
     if (err == ESP_ERR_NVS_NO_FREE_PAGES) {
@@ -702,6 +1848,25 @@ void app_main(void)
     }
 
     ble_mesh_get_dev_uuid(dev_uuid);
+    dev_uuid[NODE_ROLE_UUID_OFFSET] = NODE_ROLE;
+
+    err = example_ble_mesh_build_sensor_zones();
+    if (err) {
+        return;
+    }
+    example_ble_mesh_build_sensor_index();
+    example_ble_mesh_load_settings();
+    example_ble_mesh_build_sensor_status();
+    for (zone = 0; zone < SENSOR_ZONE_COUNT; zone++) {
+        example_ble_mesh_fill_sensor_publication(zone);
+    }
+
+    /* Without coalescing every Sensor Get is answered right away */
+    err = coalesce_init(CONFIG_SENSOR_GET_COALESCE_MS, CONFIG_SENSOR_STATS_PERIOD_S * 1000,
+                        example_ble_mesh_answer_sensor_get);
+    if (err) {
+        ESP_LOGE(TAG, "Sensor Get coalescing init failed (err %d)", err);
+    }
 
     /* Initialize the Bluetooth Mesh Subsystem */
     err = ble_mesh_init();
@@ -709,43 +1874,147 @@ void app_main(void)
         ESP_LOGE(TAG, "Bluetooth mesh init failed (err %d)", err);
     }
 
-    root_models[1].pub->publish_addr = 0xFFFF;
+    /* With CONFIG_BLE_MESH_SETTINGS the stack has restored the keys, bindings, publications and the sequence
+     * number of a node provisioned before the reset. It publishes at its Publish Period again right away */
+    if (esp_ble_mesh_node_is_provisioned() && sensor_zone_models[0]->keys[0] != ESP_BLE_MESH_KEY_UNUSED) {
+        mesh_state_restored = true;
+        HAS_APPKEY = true;
+        indicator_post(INDICATOR_IDLE);
+        ESP_LOGI(TAG, "Mesh state restored, operational %u ms after reset", (uint32_t)(esp_timer_get_time() / 1000));
+#if defined(CONFIG_BLE_MESH_LOW_POWER)
+        example_ble_mesh_lpn_start();
+#endif
+    }
 
-    while(1) {
-    	vTaskDelay(pdMS_TO_TICKS(1000));
-    	//indoor_temp += 50;
-    	//indoor_humidity += 50;
+    /* The Sensor Servers publish as set by the Config Model Publication Set of the provisioner,
+     * the other models default to all nodes unless a restored publication says otherwise */
+    for (i = 0; i < SENSOR_ZONE_COUNT; i++) {
+        if (sensor_setup_servers[i].model->pub->publish_addr == ESP_BLE_MESH_ADDR_UNASSIGNED) {
+            sensor_setup_servers[i].model->pub->publish_addr = 0xFFFF;
+        }
+#if CONFIG_SENSOR_BATCH_SIZE > 1
+        /* A period restored by the stack was set before the node was built for batches */
+        if (sensor_zone_models[i]->pub->period != 0) {
+            example_ble_mesh_take_publish_period(i);
+        }
+#endif
+    }
+    if (backfill_pub.publish_addr == ESP_BLE_MESH_ADDR_UNASSIGNED) {
+        backfill_pub.publish_addr = 0xFFFF;
+    }
+    if (telemetry_pub.publish_addr == ESP_BLE_MESH_ADDR_UNASSIGNED) {
+        telemetry_pub.publish_addr = 0xFFFF;
+    }
+
+    /* Every published sample is logged to flash, the gateway gets the samples it missed replayed */
+    err = sample_log_init();
+    if (err) {
+        ESP_LOGW(TAG, "No sample log, backfill disabled (err %d)", err);
+    } else {
+        backfill_config_t backfill_config = {
+            .status_period_ms = CONFIG_BACKFILL_STATUS_PERIOD_S * 1000,
+            .batch_size = CONFIG_BACKFILL_BATCH_SIZE,
+            .replay_interval_ms = CONFIG_BACKFILL_REPLAY_INTERVAL_MS,
+        };
+        err = backfill_start(&vnd_models[0], &backfill_config);
+        if (err) {
+            ESP_LOGE(TAG, "Backfill start failed (err %d)", err);
+        }
+    }
 
-    	//if (indoor_humidity > 10000) { /* max humidity value is 10000 (100%) */
-    	//	indoor_humidity = 10000;
-    	//}
+    for (i = 0; i < SENSOR_COUNT; i++) {
+        cadence_init(&cadence_trackers[i], &sensor_states[i], sensor_drivers[i].is_signed);
+        history_init(&sensor_history[i], &sensor_history_configs[i]);
+    }
 
+    for (zone = 0; zone < SENSOR_ZONE_COUNT; zone++) {
+        uint16_t property_ids[TELEMETRY_MAX_PROPERTIES];
 
-        err = SHT35_single_measurement(&indoor_temp, &indoor_humidity);
-        if (err) {
-            ESP_LOGE(TAG, "I2C com error 0x%x, is the I2C device connected?", err);
-        }else if(HAS_APPKEY) {
-            net_buf_simple_pull_le16(&sensor_data_0);
-            net_buf_simple_push_le16(&sensor_data_0, indoor_temp);
-            net_buf_simple_pull_le16(&sensor_data_1);
-            net_buf_simple_push_le16(&sensor_data_1, indoor_humidity);
-        	example_ble_mesh_publish_sensor_status();
-        	/* Data format:
-        	[Info tag (unimportant)] [? (uninportant)] DATA: 0x[publish addr] 0x[received from addr] 0x[property ID] [data] end*/
-        	ESP_LOGI(DATA_TAG, "0x%04x 0x%04x 0x%02x %d end", root_models[1].pub->publish_addr, 0x0000 , SENSOR_PROPERTY_ID_0, indoor_temp);
-        	ESP_LOGI(DATA_TAG, "0x%04x 0x%04x 0x%02x %d end", root_models[1].pub->publish_addr, 0x0000 , SENSOR_PROPERTY_ID_1, indoor_humidity);
+        for (i = 0; i < sensor_zones[zone].count; i++) {
+            property_ids[i] = sensor_states[sensor_zones[zone].first + i].sensor_property_id;
+        }
+        telemetry_init(&sensor_batches[zone], zone, property_ids, sensor_zones[zone].count, CONFIG_SENSOR_BATCH_SIZE);
+    }
+
+    /* The SHT35s are sampled by their own task, interleaved over the sample period, and their samples
+     * are picked up by the scheduler. In alert mode samples only arrive when a value changed or on the heartbeat */
+    acquisition_config_t acquisition_config = {
+        .mode = SENSOR_ACQUISITION_MODE,
+        .filter = SENSOR_FILTER,
+        .temperature_delta = SENSOR_TEMPERATURE_DELTA,
+        .humidity_delta = SENSOR_HUMIDITY_DELTA,
+        .heartbeat_period_ms = SENSOR_HEARTBEAT_PERIOD_MS,
+    };
+    err = acquisition_start(&acquisition_config, sensor_devices, sensor_zone_settings, SENSOR_ZONE_COUNT);
+    if (err) {
+        ESP_LOGE(TAG, "Acquisition start failed (err %d)", err);
+        return;
+    }
+
+    /* Every sensor is read at its own period by the scheduler, this loop only stores the readings.
+     * The stack publishes them every Publish Period, this loop adds the status trigger publications */
+    err = scheduler_start(sensor_drivers, SENSOR_COUNT, CONFIG_SENSOR_STATS_PERIOD_S * 1000);
+    if (err) {
+        ESP_LOGE(TAG, "Scheduler start failed (err %d)", err);
+        return;
+    }
 
+    TickType_t wait_ticks = portMAX_DELAY;
 
+    while(1) {
+        sensor_reading_t reading;
+        TickType_t now;
+        int64_t publish_start_us;
+        _Bool published;
+
+        /* Wake up for a new reading or when the (fast) cadence period of a sensor expires */
+        if (scheduler_receive(&reading, wait_ticks) == pdTRUE) {
+            do {
+                example_ble_mesh_store_sensor_value(reading.index, reading.value);
+                history_add(&sensor_history[reading.index], reading.value);
+            } while (scheduler_receive(&reading, 0) == pdTRUE);
         }
 
-    	if(HAS_APPKEY) {
-    		LED_setcolor(0, 0, 0);
-    	}
+        now = xTaskGetTickCount();
+        wait_ticks = portMAX_DELAY;
+        published = false;
+
+        if(!HAS_APPKEY) {
+            continue;
+        }
+
+        for (zone = 0; zone < SENSOR_ZONE_COUNT; zone++) {
+#if CONFIG_SENSOR_BATCH_SIZE > 1
+            if (!example_ble_mesh_zone_publish_due(zone, now, &wait_ticks)) {
+                continue;
+            }
 
-    	/* Refresh network buffer with sensor data */
+            /* A batch counts the samples of the zone as published once they are in it */
+            publish_start_us = esp_timer_get_time();
+            example_ble_mesh_batch_sensor_status(zone);
+            example_publish_latency_record(publish_start_us);
+            example_ble_mesh_zone_published(zone, &sensor_values[sensor_zones[zone].first], now);
 
+            /* Right after a publication no sensor of the zone is due, this only collects the time to the next one */
+            example_ble_mesh_zone_publish_due(zone, now, &wait_ticks);
+#else
+            /* The stack publishes the zone every Publish Period, a status trigger publishes it in between */
+            example_ble_mesh_apply_fast_cadence(zone);
+            if (!example_ble_mesh_zone_trigger_due(zone, now, &wait_ticks)) {
+                continue;
+            }
 
-    	//ESP_LOGI(TAG, "Raw temp data %d (%.2f C); Raw humidity data: %d (%.2f %%)", indoor_temp, (float)indoor_temp/100, indoor_humidity, (float)indoor_humidity/100);
+            publish_start_us = esp_timer_get_time();
+            example_ble_mesh_publish_sensor_status(zone);
+            example_publish_latency_record(publish_start_us);
+            example_ble_mesh_zone_published(zone, &sensor_values[sensor_zones[zone].first], now);
+#endif
+            published = true;
+        }
+        if (!published) {
+            continue;
+        }
+        example_heap_watermark_check();
     }
 
 }
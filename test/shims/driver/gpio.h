@@ -0,0 +1,45 @@
+/* Host shim of the ESP-IDF header, only what the tested components use */
+#pragma once
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+
+#define GPIO_NUM_NC		-1
+
+typedef enum{
+	GPIO_MODE_DISABLE,
+	GPIO_MODE_INPUT,
+	GPIO_MODE_OUTPUT,
+}gpio_mode_t;
+
+typedef enum{
+	GPIO_PULLUP_DISABLE,
+	GPIO_PULLUP_ENABLE,
+}gpio_pullup_t;
+
+typedef enum{
+	GPIO_PULLDOWN_DISABLE,
+	GPIO_PULLDOWN_ENABLE,
+}gpio_pulldown_t;
+
+typedef enum{
+	GPIO_INTR_DISABLE,
+	GPIO_INTR_POSEDGE,
+	GPIO_INTR_NEGEDGE,
+	GPIO_INTR_ANYEDGE,
+}gpio_int_type_t;
+
+typedef struct{
+	uint64_t pin_bit_mask;
+	gpio_mode_t mode;
+	gpio_pullup_t pull_up_en;
+	gpio_pulldown_t pull_down_en;
+	gpio_int_type_t intr_type;
+}gpio_config_t;
+
+typedef void (*gpio_isr_t)(void *arg);
+
+esp_err_t gpio_config(const gpio_config_t *pGPIOConfig);
+esp_err_t gpio_install_isr_service(int intr_alloc_flags);
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args);
+int gpio_get_level(gpio_num_t gpio_num);
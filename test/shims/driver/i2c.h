@@ -0,0 +1,25 @@
+/* Host shim of the ESP-IDF header, only what the tested components use */
+#pragma once
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+typedef int i2c_port_t;
+
+typedef enum{
+	I2C_MODE_SLAVE,
+	I2C_MODE_MASTER,
+}i2c_mode_t;
+
+typedef struct{
+	i2c_mode_t mode;
+	int sda_io_num;
+	int scl_io_num;
+	gpio_pullup_t sda_pullup_en;
+	gpio_pullup_t scl_pullup_en;
+	struct{
+		uint32_t clk_speed;
+	}master;
+}i2c_config_t;
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf);
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags);
@@ -0,0 +1,12 @@
+/* Host shim of the ESP-BLE-MESH header, only what the tested components use */
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_BLE_MESH_MODEL_OP_3(b0, cid)	((((b0) << 16) | 0xC00000) | (cid))
+
+typedef struct esp_ble_mesh_model esp_ble_mesh_model_t;
+typedef struct {
+	uint16_t addr;
+	uint16_t recv_dst;
+} esp_ble_mesh_msg_ctx_t;
@@ -0,0 +1,5 @@
+/* Host shim of the ESP-IDF header, the test defines esp_timer_get_time */
+#pragma once
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,9 @@
+/* Host shim of the FreeRTOS header, the test provides the functions */
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef struct queue_definition *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait);
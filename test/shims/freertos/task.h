@@ -0,0 +1,29 @@
+/* Host shim of the FreeRTOS header, the test provides the functions on a simulated tick */
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+typedef int portMUX_TYPE;
+
+typedef enum{
+	eNoAction,
+	eSetBits,
+	eIncrement,
+	eSetValueWithOverwrite,
+	eSetValueWithoutOverwrite,
+}eNotifyAction;
+
+#define portMUX_INITIALIZER_UNLOCKED	0
+#define taskENTER_CRITICAL(mux)		((void)(mux))
+#define taskEXIT_CRITICAL(mux)		((void)(mux))
+#define portYIELD_FROM_ISR()
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack_depth, void *parameters,
+		UBaseType_t priority, TaskHandle_t *created_task);
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks_to_delay);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *higher_priority_task_woken);
+BaseType_t xTaskNotifyWait(uint32_t bits_to_clear_on_entry, uint32_t bits_to_clear_on_exit, uint32_t *notification_value,
+		TickType_t ticks_to_wait);
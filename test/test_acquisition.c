@@ -0,0 +1,614 @@
+/*
+ * test_acquisition.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "acquisition.h"
+#include "i2c_bus.h"
+
+/* The acquisition task runs on a simulated FreeRTOS tick against mock SHT35s on a mock I2C bus. A mock sensor NACKs a
+ * result that is not converted yet, like the real one, so every fetch that succeeds was not early. The task may only
+ * block in xTaskNotifyWait, the steps have to run at the tick they were scheduled for and the samples have to come
+ * out at the sample period. One scenario per run, acquisition_start can only be called once:
+ *   test_acquisition single_shot | periodic | alert | heartbeat */
+
+#define CHECK(condition) \
+	do { if(!(condition)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #condition); failures++; } } while(0)
+
+#define TICK_MS					(1000 / configTICK_RATE_HZ)
+#define MOCK_SENSOR_COUNT		2
+#define MOCK_LOG_LENGTH			4096
+#define MOCK_ALERT_GPIO			5
+#define MOCK_STATUS_COMMAND		0xF32D
+#define MOCK_FETCH_COMMAND		0xE000
+#define MOCK_BREAK_COMMAND		0x3093
+#define MOCK_ART_COMMAND		0x2B32
+#define MOCK_READ				0x0000	// logged command of a read without write
+
+// One SHT35 on the mock bus, times in microseconds of simulated time
+typedef struct{
+	uint8_t address;
+	uint16_t raw_temperature;
+	uint16_t raw_humidity;
+	int64_t ready_us;				// single shot result converted at, -1 when no single shot runs
+	_Bool periodic;
+	int64_t periodic_start_us;
+	uint32_t interval_us;
+	int64_t last_result;			// periodic result read last, -1 for none
+}mock_sensor_t;
+
+// One I2C transaction
+typedef struct{
+	TickType_t tick;
+	uint8_t sensor;
+	uint16_t command;
+	esp_err_t result;
+}mock_transaction_t;
+
+// Something the test does at a tick while the task runs
+typedef struct{
+	TickType_t tick;
+	void (*action)(void);
+}sim_event_t;
+
+static int failures;
+
+static mock_sensor_t sensors[MOCK_SENSOR_COUNT] = {
+	{ .address = SHT35_SENSOR_ADDR_ALT, .raw_temperature = 0x6666, .raw_humidity = 0x8000, .ready_us = -1 },
+	{ .address = SHT35_SENSOR_ADDR, .raw_temperature = 0x7000, .raw_humidity = 0x4000, .ready_us = -1 },
+};
+static mock_transaction_t transactions[MOCK_LOG_LENGTH];
+static int transaction_count;
+static sensor_sample_t samples[MOCK_LOG_LENGTH];
+static int sample_count;
+
+static TickType_t sim_now;
+static TickType_t sim_end;
+static jmp_buf sim_exit;
+static TaskFunction_t sim_task;
+static uint32_t sim_notification;
+static const sim_event_t *sim_events;
+static int sim_event_count;
+static int sim_next_event;
+static int sim_wakeups;
+static TickType_t sim_delayed;
+static gpio_isr_t alert_isr;
+static void *alert_isr_arg;
+static int alert_level;
+
+// Queue of the samples, every sample sent is also kept in samples[]
+struct queue_definition{
+	UBaseType_t length;
+	UBaseType_t item_size;
+	UBaseType_t count;
+	UBaseType_t head;
+	uint8_t *items;
+};
+
+/* FreeRTOS on a simulated tick */
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack_depth, void *parameters,
+		UBaseType_t priority, TaskHandle_t *created_task)
+{
+	sim_task = task;
+	*created_task = &sim_task;
+	return pdPASS;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return sim_now;
+}
+
+void vTaskDelay(TickType_t ticks_to_delay)
+{
+	sim_delayed += ticks_to_delay;
+	sim_now += ticks_to_delay;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+	sim_notification |= value;
+	return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *higher_priority_task_woken)
+{
+	sim_notification |= value;
+	*higher_priority_task_woken = pdTRUE;
+	return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t bits_to_clear_on_entry, uint32_t bits_to_clear_on_exit, uint32_t *notification_value,
+		TickType_t ticks_to_wait)
+/* The only place the task blocks, time jumps to the timeout or to the next event, whichever comes first.
+ * Leaves the task once the end of the run is reached */
+{
+	TickType_t timeout = sim_now + ticks_to_wait;
+	TickType_t next;
+
+	sim_wakeups++;
+	while(1)
+	{
+		while(sim_next_event < sim_event_count && (int32_t)(sim_events[sim_next_event].tick - sim_now) <= 0)
+			sim_events[sim_next_event++].action();
+
+		if(sim_notification)
+		{
+			*notification_value = sim_notification;
+			sim_notification = 0;
+			return pdTRUE;
+		}
+
+		next = ticks_to_wait == portMAX_DELAY ? sim_end + 1 : timeout;
+		if(sim_next_event < sim_event_count && (int32_t)(sim_events[sim_next_event].tick - next) < 0)
+			next = sim_events[sim_next_event].tick;
+		if((int32_t)(next - sim_end) > 0)
+		{
+			sim_now = sim_end;
+			longjmp(sim_exit, 1);
+		}
+
+		sim_now = next;
+		if(sim_now == timeout && ticks_to_wait != portMAX_DELAY)
+			return pdFALSE;
+	}
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+	QueueHandle_t queue = calloc(1, sizeof(*queue));
+
+	queue->length = length;
+	queue->item_size = item_size;
+	queue->items = calloc(length, item_size);
+	return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+	if(queue->count == queue->length)
+		return pdFALSE;
+	memcpy(queue->items + ((queue->head + queue->count) % queue->length) * queue->item_size, item, queue->item_size);
+	queue->count++;
+	if(sample_count < MOCK_LOG_LENGTH)
+		samples[sample_count++] = *(const sensor_sample_t *)item;
+	return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+	if(queue->count == 0)
+		return pdFALSE;
+	memcpy(buffer, queue->items + queue->head * queue->item_size, queue->item_size);
+	queue->head = (queue->head + 1) % queue->length;
+	queue->count--;
+	return pdTRUE;
+}
+
+/* GPIO of the ALERT pin */
+
+esp_err_t gpio_config(const gpio_config_t *pGPIOConfig)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+	if(gpio_num != MOCK_ALERT_GPIO)
+		return ESP_ERR_INVALID_ARG;
+	alert_isr = isr_handler;
+	alert_isr_arg = args;
+	return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+	return gpio_num == MOCK_ALERT_GPIO ? alert_level : 0;
+}
+
+static void alert_rise(void)
+{
+	alert_level = 1;
+	alert_isr(alert_isr_arg);
+}
+
+static void alert_fall(void)
+{
+	alert_level = 0;
+}
+
+/* SHT35s on the I2C bus */
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+	return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+	return ESP_OK;
+}
+
+esp_err_t i2c_bus_start(i2c_port_t port)
+{
+	return ESP_OK;
+}
+
+static uint8_t crc_bitwise(const uint8_t data[], uint8_t number_of_bytes)
+{
+	uint8_t crc = 0xFF;
+	uint8_t byte_ctr, bit;
+
+	for(byte_ctr = 0; byte_ctr < number_of_bytes; byte_ctr++)
+	{
+		crc ^= data[byte_ctr];
+		for(bit = 8; bit > 0; bit--)
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+	}
+	return crc;
+}
+
+static void mock_word(uint8_t *data, uint16_t word)
+{
+	data[0] = word >> 8;
+	data[1] = word & 0xFF;
+	data[2] = crc_bitwise(data, 2);
+}
+
+static uint32_t mock_conversion_us(uint16_t command)
+/* Maximum measurement duration of the datasheet, periodic mode is only run at high repeatability */
+{
+	switch(command)
+	{
+		case 0x240B:
+			return 6500;
+		case 0x2416:
+			return 4500;
+		default:
+			return 15500;
+	}
+}
+
+static uint32_t mock_interval_us(uint16_t command)
+{
+	switch(command >> 8)
+	{
+		case 0x20:
+			return 2000000;
+		case 0x22:
+			return 500000;
+		case 0x23:
+			return 250000;
+		case 0x27:
+			return 100000;
+		case 0x2B:
+			return 250000;
+		default:
+			return 1000000;
+	}
+}
+
+static esp_err_t mock_transfer(mock_sensor_t *sensor, uint16_t command, const uint8_t *write_data, size_t write_size,
+		uint8_t *read_data, size_t read_size)
+{
+	int64_t now_us = (int64_t)sim_now * TICK_MS * 1000;
+	int64_t result;
+
+	if(write_size == 0 && read_size == 6)
+	{
+		/* Single shot result, NACKed while converting */
+		if(sensor->ready_us < 0 || now_us < sensor->ready_us)
+			return ESP_FAIL;
+		sensor->ready_us = -1;
+		mock_word(read_data, sensor->raw_temperature);
+		mock_word(read_data + 3, sensor->raw_humidity);
+		return ESP_OK;
+	}
+	if(write_size == 2 && read_size == 6 && command == MOCK_FETCH_COMMAND)
+	{
+		/* Periodic result, NACKed when there is no new one */
+		if(!sensor->periodic || now_us < sensor->periodic_start_us)
+			return ESP_FAIL;
+		result = (now_us - sensor->periodic_start_us) / sensor->interval_us;
+		if(result <= sensor->last_result)
+			return ESP_FAIL;
+		sensor->last_result = result;
+		mock_word(read_data, sensor->raw_temperature);
+		mock_word(read_data + 3, sensor->raw_humidity);
+		return ESP_OK;
+	}
+	if(write_size == 2 && read_size == 3 && command == MOCK_STATUS_COMMAND)
+	{
+		mock_word(read_data, 0x8000);
+		return ESP_OK;
+	}
+	if(read_size != 0)
+		return ESP_FAIL;
+	if(write_size == 5 && (command >> 8) == 0x61)
+		return crc_bitwise(write_data + 2, 2) == write_data[4] ? ESP_OK : ESP_FAIL;
+	if(write_size != 2)
+		return ESP_FAIL;
+
+	if(command == MOCK_BREAK_COMMAND)
+		sensor->periodic = false;
+	else if(sensor->periodic)
+		return ESP_FAIL;	// only the break command and reads are accepted while measuring periodically
+	else if((command >> 8) == 0x24)
+		sensor->ready_us = now_us + mock_conversion_us(command);
+	else if((command >> 8) == 0x20 || (command >> 8) == 0x21 || (command >> 8) == 0x22 || (command >> 8) == 0x23
+			|| (command >> 8) == 0x27 || command == MOCK_ART_COMMAND)
+	{
+		sensor->periodic = true;
+		sensor->interval_us = mock_interval_us(command);
+		sensor->periodic_start_us = now_us + mock_conversion_us(command);
+		sensor->last_result = -1;
+	}
+	return ESP_OK;
+}
+
+esp_err_t i2c_bus_transfer(i2c_port_t port, uint8_t address, const uint8_t *write_data, size_t write_size, uint8_t *read_data, size_t read_size)
+/* Every transaction is logged with the tick it ran at */
+{
+	uint16_t command = write_size >= 2 ? (write_data[0] << 8) | write_data[1] : MOCK_READ;
+	esp_err_t err = ESP_FAIL;
+	uint8_t i;
+
+	for(i = 0; i < MOCK_SENSOR_COUNT; i++)
+	{
+		if(port == 0 && sensors[i].address == address)
+		{
+			err = mock_transfer(&sensors[i], command, write_data, write_size, read_data, read_size);
+			break;
+		}
+	}
+	if(transaction_count < MOCK_LOG_LENGTH)
+		transactions[transaction_count++] = (mock_transaction_t){ sim_now, i, command, err };
+	return err;
+}
+
+/* Scenarios */
+
+static void sim_run(const sim_event_t *events, int event_count, TickType_t end)
+/* Runs the task until the end tick */
+{
+	sim_events = events;
+	sim_event_count = event_count;
+	sim_next_event = 0;
+	sim_end = end;
+	if(!setjmp(sim_exit))
+		sim_task(NULL);
+}
+
+static int find_transaction(int from, uint8_t sensor, uint16_t command)
+/* Index of the next transaction of the sensor with the command, -1 when there is none */
+{
+	for(; from < transaction_count; from++)
+	{
+		if(transactions[from].sensor == sensor && transactions[from].command == command)
+			return from;
+	}
+	return -1;
+}
+
+static void check_no_nack(void)
+{
+	int i;
+
+	for(i = 0; i < transaction_count; i++)
+	{
+		if(transactions[i].result != ESP_OK)
+			printf("tick %u: sensor %u command 0x%04X failed\n", transactions[i].tick, transactions[i].sensor, transactions[i].command);
+		CHECK(transactions[i].result == ESP_OK);
+	}
+}
+
+static void check_sample_values(void)
+{
+	int i;
+
+	for(i = 0; i < sample_count; i++)
+	{
+		CHECK(samples[i].device < MOCK_SENSOR_COUNT);
+		CHECK(samples[i].temperature == convert_raw_temperature(sensors[samples[i].device].raw_temperature));
+		CHECK(samples[i].humidity == convert_raw_humidity(sensors[samples[i].device].raw_humidity));
+	}
+}
+
+static int check_single_shot(uint8_t sensor, uint16_t command, TickType_t first, TickType_t period, TickType_t conversion)
+/* Triggers with the command come every period from the first one, every fetch exactly one conversion later.
+ * Returns the number of triggers */
+{
+	TickType_t expected = first;
+	int trigger, fetch, count = 0;
+
+	for(trigger = find_transaction(0, sensor, command); trigger >= 0; trigger = find_transaction(trigger + 1, sensor, command))
+	{
+		CHECK(transactions[trigger].tick == expected);
+		fetch = find_transaction(trigger + 1, sensor, MOCK_READ);
+		CHECK(fetch < 0 || transactions[fetch].tick == transactions[trigger].tick + conversion);
+		expected += period;
+		count++;
+	}
+	return count;
+}
+
+static void reconfigure_single_shot(void)
+{
+	const acquisition_settings_t settings = { .sample_period_ms = 2000, .repeatability = LOW_REPEATABILITY, .filter_depth = 1 };
+
+	CHECK(acquisition_configure(0, &settings) == ESP_OK);
+}
+
+static void test_single_shot(void)
+/* Two sensors a half period apart, every trigger is followed by its fetch one conversion time later. Sensor 0 changes
+ * to a 2 s period at low repeatability at 4.8 s, from the next tick on */
+{
+	const acquisition_config_t config = { .mode = SINGLE_SHOT_MODE };
+	const acquisition_device_t devices[2] = {
+		{ .sensor = { .port = 0, .address = SHT35_SENSOR_ADDR_ALT }, .alert_gpio = GPIO_NUM_NC },
+		{ .sensor = { .port = 0, .address = SHT35_SENSOR_ADDR }, .alert_gpio = GPIO_NUM_NC },
+	};
+	const acquisition_settings_t settings[2] = {
+		{ .sample_period_ms = 1000, .repeatability = HIGH_REPEATABILITY, .filter_depth = 1 },
+		{ .sample_period_ms = 1000, .repeatability = HIGH_REPEATABILITY, .filter_depth = 1 },
+	};
+	const sim_event_t events[] = { { 480, reconfigure_single_shot } };
+	int triggers, samples_of[2] = { 0 }, i;
+	sensor_sample_t sample;
+
+	CHECK(acquisition_start(&config, devices, settings, 2) == ESP_OK);
+	sim_run(events, sizeof(events) / sizeof(events[0]), 1000);
+
+	check_no_nack();
+	triggers = check_single_shot(0, 0x2400, 0, 100, 2);
+	CHECK(triggers == 5);
+	i = check_single_shot(0, 0x2416, 481, 200, 1);
+	CHECK(i == 3);
+	triggers += i;
+	i = check_single_shot(1, 0x2400, 50, 100, 2);
+	CHECK(i == 10);
+	triggers += i;
+
+	for(i = 0; i < sample_count; i++)
+		samples_of[samples[i].device]++;
+	CHECK(samples_of[0] == 5 + 3);
+	CHECK(samples_of[1] == 10);
+	check_sample_values();
+
+	/* Never delayed, only woken for a trigger or a fetch and for the new settings */
+	CHECK(sim_delayed == 0);
+	CHECK(sim_wakeups <= 2 * triggers + 2);
+	CHECK(acquisition_receive(&sample, 0) == pdTRUE);
+}
+
+static void reconfigure_periodic(void)
+{
+	const acquisition_settings_t settings = { .sample_period_ms = 5000, .repeatability = HIGH_REPEATABILITY,
+			.frequency = FREQUENCY_1HZ, .art = true, .filter_depth = 5 };
+
+	CHECK(acquisition_configure(0, &settings) == ESP_OK);
+}
+
+static void test_periodic(void)
+/* One sensor at 1 Hz, fetched every interval and filtered down to a sample every 5 s. It changes to ART (4 Hz) at 10 s,
+ * the sensor is stopped first and the filter starts over */
+{
+	const acquisition_config_t config = { .mode = PERIODIC_MODE, .filter = FILTER_MOVING_AVERAGE };
+	const acquisition_device_t devices[1] = {
+		{ .sensor = { .port = 0, .address = SHT35_SENSOR_ADDR_ALT }, .alert_gpio = GPIO_NUM_NC },
+	};
+	const acquisition_settings_t settings[1] = {
+		{ .sample_period_ms = 5000, .repeatability = HIGH_REPEATABILITY, .frequency = FREQUENCY_1HZ, .filter_depth = 5 },
+	};
+	const sim_event_t events[] = { { 1000, reconfigure_periodic } };
+	const TickType_t expected_samples[] = { 502, 1503, 2003, 2503 };
+	TickType_t expected_fetch;
+	int start, fetch, art, i;
+
+	CHECK(acquisition_start(&config, devices, settings, 1) == ESP_OK);
+	sim_run(events, sizeof(events) / sizeof(events[0]), 3000);
+
+	check_no_nack();
+	start = find_transaction(0, 0, 0x2130);
+	CHECK(start >= 0 && transactions[start].tick == 0);
+
+	/* First result one interval plus one conversion after the command, then one every interval */
+	expected_fetch = 102;
+	for(fetch = find_transaction(0, 0, MOCK_FETCH_COMMAND); fetch >= 0 && expected_fetch < 1000; fetch = find_transaction(fetch + 1, 0, MOCK_FETCH_COMMAND))
+	{
+		CHECK(transactions[fetch].tick == expected_fetch);
+		expected_fetch += 100;
+	}
+	CHECK(expected_fetch == 1002);
+
+	art = find_transaction(0, 0, MOCK_ART_COMMAND);
+	CHECK(art > 0 && transactions[art - 1].command == MOCK_BREAK_COMMAND && transactions[art - 1].tick == 1000);
+	CHECK(art > 0 && transactions[art].tick == 1001);
+	expected_fetch = 1001 + 25 + 2;
+	for(fetch = find_transaction(art, 0, MOCK_FETCH_COMMAND); fetch >= 0; fetch = find_transaction(fetch + 1, 0, MOCK_FETCH_COMMAND))
+	{
+		CHECK(transactions[fetch].tick == expected_fetch);
+		expected_fetch += 25;
+	}
+
+	CHECK(sample_count == sizeof(expected_samples) / sizeof(expected_samples[0]));
+	for(i = 0; i < sample_count && i < sizeof(expected_samples) / sizeof(expected_samples[0]); i++)
+		CHECK(samples[i].timestamp == expected_samples[i]);
+	check_sample_values();
+	CHECK(sim_delayed == 0);
+}
+
+static void test_alert(_Bool heartbeat)
+/* One sensor at 1 Hz. Without heartbeat the ALERT pin rises at 5 s and stays high until 9 s: it is fetched at the edge
+ * and after every result while the pin stays high, then nothing until the end. With a 3 s heartbeat and no alert
+ * it is fetched every 3 s. The re-arm restarts the sensor one tick after the fetch */
+{
+	const acquisition_config_t config = { .mode = ALERT_MODE, .temperature_delta = 100, .humidity_delta = 500,
+			.heartbeat_period_ms = heartbeat ? 3000 : 0 };
+	const acquisition_device_t devices[1] = {
+		{ .sensor = { .port = 0, .address = SHT35_SENSOR_ADDR_ALT }, .alert_gpio = MOCK_ALERT_GPIO },
+	};
+	const acquisition_settings_t settings[1] = {
+		{ .sample_period_ms = 1000, .repeatability = HIGH_REPEATABILITY, .frequency = FREQUENCY_1HZ, .filter_depth = 1 },
+	};
+	const sim_event_t events[] = { { 500, alert_rise }, { 900, alert_fall } };
+	int i;
+
+	CHECK(acquisition_start(&config, devices, settings, 1) == ESP_OK);
+	sim_run(events, heartbeat ? 0 : 2, 2000);
+
+	check_no_nack();
+	CHECK(sample_count >= 1 && samples[0].timestamp == 102);
+	if(heartbeat)
+	{
+		CHECK(sample_count == 7);
+		for(i = 1; i < sample_count; i++)
+			CHECK(samples[i].timestamp - samples[i - 1].timestamp >= 300 && samples[i].timestamp - samples[i - 1].timestamp <= 302);
+	}
+	else
+	{
+		CHECK(sample_count == 5);
+		CHECK(sample_count >= 2 && samples[1].timestamp == 500);
+		for(i = 2; i < sample_count; i++)
+			CHECK(samples[i].timestamp - samples[i - 1].timestamp >= 102 && samples[i].timestamp - samples[i - 1].timestamp <= 104);
+		CHECK(samples[sample_count - 1].timestamp < 900);
+		CHECK(find_transaction(0, 0, MOCK_STATUS_COMMAND) >= 0);
+	}
+	check_sample_values();
+}
+
+int main(int argc, char **argv)
+{
+	if(argc != 2)
+	{
+		printf("usage: %s single_shot | periodic | alert | heartbeat\n", argv[0]);
+		return 2;
+	}
+
+	if(!strcmp(argv[1], "single_shot"))
+		test_single_shot();
+	else if(!strcmp(argv[1], "periodic"))
+		test_periodic();
+	else if(!strcmp(argv[1], "alert"))
+		test_alert(false);
+	else if(!strcmp(argv[1], "heartbeat"))
+		test_alert(true);
+	else
+		return 2;
+
+	printf("%d transactions, %d samples, %d wakeups\n", transaction_count, sample_count, sim_wakeups);
+	if(failures)
+		printf("%d checks failed\n", failures);
+	return failures != 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * test_communication.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "communication.h"
+
+/* The integer conversions of communication.c have to give the correctly rounded value of the SHT35 formulas for
+ * every raw word. The float reference is only counted, it is allowed to be 0.01 off where single precision rounds.
+ * The benchmark runs on the host, it shows the ratio between the two paths, not the soft-float cost on the ESP32-C3 */
+
+#define CHECK(condition) \
+	do { if(!(condition)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #condition); failures++; } } while(0)
+
+#define BENCHMARK_PASSES	100
+
+static int failures;
+
+static void test_exhaustive(void)
+/* All 65536 raw words against the formulas in double precision, no input is half way between two 0.01 steps */
+{
+	uint8_t data[6] = { 0 };
+	int16_t temperature, temperature_float;
+	uint16_t humidity, humidity_float;
+	uint32_t raw;
+	int float_errors = 0;
+
+	for(raw = 0; raw <= 0xFFFF; raw++)
+	{
+		int16_t expected_temperature = round((-45 + 175.0 * raw / 65535.0) * 100.0);
+		uint16_t expected_humidity = round(100.0 * raw / 65535.0 * 100.0);
+
+		CHECK(convert_raw_temperature(raw) == expected_temperature);
+		CHECK(convert_raw_humidity(raw) == expected_humidity);
+
+		data[0] = data[3] = raw >> 8;
+		data[1] = data[4] = raw & 0xFF;
+		CHECK(process_raw_temp_hum_values(data, sizeof(data), &temperature, &humidity) == ESP_OK);
+		CHECK(temperature == expected_temperature && humidity == expected_humidity);
+		CHECK(process_raw_temp_hum_values_float(data, sizeof(data), &temperature_float, &humidity_float) == ESP_OK);
+		CHECK(temperature_float - expected_temperature <= 1 && temperature_float - expected_temperature >= -1);
+		CHECK(humidity_float - expected_humidity <= 1 && humidity_float - expected_humidity >= -1);
+		float_errors += temperature_float != expected_temperature;
+		float_errors += humidity_float != expected_humidity;
+
+		/* The inverse gives back a raw word that converts to the same value */
+		CHECK(convert_raw_temperature(convert_temperature_to_raw(expected_temperature)) == expected_temperature);
+		CHECK(convert_raw_humidity(convert_humidity_to_raw(expected_humidity)) == expected_humidity);
+	}
+	printf("float reference: %d of %u conversions 0.01 off\n", float_errors, 2 * 65536);
+
+	CHECK(process_raw_temp_hum_values(data, 4, &temperature, &humidity) == ESP_ERR_INVALID_ARG);
+	CHECK(process_raw_temp_hum_values(data, 7, &temperature, &humidity) == ESP_ERR_INVALID_ARG);
+}
+
+static double benchmark(esp_err_t (*process)(uint8_t *, size_t, int16_t *, uint16_t *))
+/* Nanoseconds per call of process over all raw words */
+{
+	static volatile int32_t sink;
+	uint8_t data[6] = { 0 };
+	int16_t temperature;
+	uint16_t humidity;
+	struct timespec start, end;
+	uint32_t raw;
+	int pass;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(pass = 0; pass < BENCHMARK_PASSES; pass++)
+	{
+		for(raw = 0; raw <= 0xFFFF; raw++)
+		{
+			data[0] = data[3] = raw >> 8;
+			data[1] = data[4] = raw & 0xFF;
+			process(data, sizeof(data), &temperature, &humidity);
+			sink += temperature + humidity;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / (BENCHMARK_PASSES * 65536.0);
+}
+
+int main(void)
+{
+	double integer_ns, float_ns;
+
+	test_exhaustive();
+
+	integer_ns = benchmark(process_raw_temp_hum_values);
+	float_ns = benchmark(process_raw_temp_hum_values_float);
+	printf("host benchmark: integer %.2f ns, float %.2f ns per sample\n", integer_ns, float_ns);
+
+	if(failures)
+		printf("%d checks failed\n", failures);
+	return failures != 0;
+}
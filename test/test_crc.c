@@ -0,0 +1,178 @@
+/*
+ * test_crc.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "commands.h"
+#include "i2c_bus.h"
+
+/* The CRC-8 table of commands.c has to give the checksum of the bit-by-bit routine from the SHT3x datasheet
+ * (polynomial 0x31, initialization 0xFF) for every 16 bit word. The I2C bus is replaced by a mock, so the checksums
+ * of the status register read and of the alert limit write are checked through the public functions as well */
+
+#define CHECK(condition) \
+	do { if(!(condition)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #condition); failures++; } } while(0)
+
+#define BENCHMARK_PASSES	100
+
+static int failures;
+static uint8_t mock_written[8];
+static uint8_t mock_response[6];
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+	return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+	return ESP_OK;
+}
+
+esp_err_t i2c_bus_start(i2c_port_t port)
+{
+	return ESP_OK;
+}
+
+esp_err_t i2c_bus_transfer(i2c_port_t port, uint8_t address, const uint8_t *write_data, size_t write_size, uint8_t *read_data, size_t read_size)
+/* Keeps what was written and answers a read with mock_response */
+{
+	if(write_size > sizeof(mock_written) || read_size > sizeof(mock_response))
+		return ESP_ERR_INVALID_SIZE;
+	if(write_size)
+		memcpy(mock_written, write_data, write_size);
+	if(read_size)
+		memcpy(read_data, mock_response, read_size);
+	return ESP_OK;
+}
+
+static uint8_t crc_bitwise(const uint8_t data[], uint8_t number_of_bytes)
+/* Bit-by-bit CRC-8 of the SHT3x datasheet, the reference for the table */
+{
+	uint8_t crc = 0xFF;
+	uint8_t byte_ctr, bit;
+
+	for(byte_ctr = 0; byte_ctr < number_of_bytes; byte_ctr++)
+	{
+		crc ^= data[byte_ctr];
+		for(bit = 8; bit > 0; bit--)
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+	}
+	return crc;
+}
+
+static void test_check_frame(void)
+/* Every word with every checksum, only the bitwise CRC is accepted, in the temperature and in the humidity word */
+{
+	uint8_t frame[6];
+	uint32_t word;
+	uint16_t crc;
+
+	/* Example of the datasheet */
+	frame[0] = 0xBE;
+	frame[1] = 0xEF;
+	CHECK(crc_bitwise(frame, 2) == 0x92);
+
+	for(word = 0; word <= 0xFFFF; word++)
+	{
+		frame[0] = frame[3] = word >> 8;
+		frame[1] = frame[4] = word & 0xFF;
+		frame[5] = crc_bitwise(frame + 3, 2);
+		for(crc = 0; crc <= 0xFF; crc++)
+		{
+			frame[2] = crc;
+			CHECK((SHT35_check_frame(frame) == ESP_OK) == (crc == frame[5]));
+		}
+		frame[2] = frame[5];
+		frame[5] ^= 0x01;
+		CHECK(SHT35_check_frame(frame) == ESP_ERR_INVALID_CRC);
+	}
+}
+
+static void test_status_register(void)
+/* The status register read accepts the checksum of its 2 data bytes only */
+{
+	SHT35_t dev = { .port = 0, .address = SHT35_SENSOR_ADDR };
+	SHT35_status_t status;
+	uint32_t word;
+
+	for(word = 0; word <= 0xFFFF; word += 0x0101)
+	{
+		mock_response[0] = word >> 8;
+		mock_response[1] = word & 0xFF;
+		mock_response[2] = crc_bitwise(mock_response, 2);
+		CHECK(SHT35_read_status(&dev, &status) == ESP_OK);
+		mock_response[2] ^= 0x80;
+		CHECK(SHT35_read_status(&dev, &status) == ESP_ERR_INVALID_CRC);
+	}
+}
+
+static void test_alert_limit(void)
+/* The alert limit write carries the checksum of the limit word it sends */
+{
+	SHT35_t dev = { .port = 0, .address = SHT35_SENSOR_ADDR };
+	uint32_t raw;
+	etAlertLimit limit;
+
+	for(limit = ALERT_HIGH_SET; limit <= ALERT_LOW_SET; limit++)
+	{
+		for(raw = 0; raw <= 0xFFFF; raw += 0x0F)
+		{
+			memset(mock_written, 0, sizeof(mock_written));
+			CHECK(SHT35_write_alert_limit(&dev, limit, raw, 0xFFFF - raw) == ESP_OK);
+			CHECK(mock_written[4] == crc_bitwise(mock_written + 2, 2));
+		}
+	}
+}
+
+static void benchmark(void)
+/* Nanoseconds per measurement frame, both words checked by the table and by the bitwise routine */
+{
+	static volatile uint32_t sink;
+	uint8_t frame[6] = { 0 };
+	struct timespec start, middle, end;
+	uint32_t word;
+	int pass;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(pass = 0; pass < BENCHMARK_PASSES; pass++)
+	{
+		for(word = 0; word <= 0xFFFF; word++)
+		{
+			frame[0] = frame[4] = word >> 8;
+			frame[1] = frame[3] = word & 0xFF;
+			sink += SHT35_check_frame(frame);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &middle);
+	for(pass = 0; pass < BENCHMARK_PASSES; pass++)
+	{
+		for(word = 0; word <= 0xFFFF; word++)
+		{
+			frame[0] = frame[4] = word >> 8;
+			frame[1] = frame[3] = word & 0xFF;
+			sink += (crc_bitwise(frame, 2) != frame[2]) | (crc_bitwise(frame + 3, 2) != frame[5]);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("host benchmark: table %.2f ns, bitwise %.2f ns per frame\n",
+			((middle.tv_sec - start.tv_sec) * 1e9 + (middle.tv_nsec - start.tv_nsec)) / (BENCHMARK_PASSES * 65536.0),
+			((end.tv_sec - middle.tv_sec) * 1e9 + (end.tv_nsec - middle.tv_nsec)) / (BENCHMARK_PASSES * 65536.0));
+}
+
+int main(void)
+{
+	test_check_frame();
+	test_status_register();
+	test_alert_limit();
+	benchmark();
+
+	if(failures)
+		printf("%d checks failed\n", failures);
+	return failures != 0;
+}
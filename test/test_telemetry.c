@@ -0,0 +1,145 @@
+/*
+ * test_telemetry.c
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "telemetry.h"
+#include "telemetry_decode.h"
+
+/* Batches of the sensor node (telemetry.c) decoded by the provisioner (telemetry_decode.c) have to give back
+ * the samples that went in, for the values and intervals at the varint and zigzag boundaries and for a batch
+ * that is ended by the message length */
+
+#define CHECK(condition) \
+	do { if(!(condition)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #condition); failures++; } } while(0)
+
+static int failures;
+static int64_t now_us;
+
+int64_t esp_timer_get_time(void)
+{
+	return now_us;
+}
+
+static void check_round_trip(telemetry_batch_t *batch, uint8_t count)
+/* Encodes the batch holding count samples and compares the decoded batch with it */
+{
+	static uint8_t message[TELEMETRY_MAX_LEN];
+	static telemetry_decoded_t decoded;
+	telemetry_batch_t sent = *batch;
+	uint16_t length;
+	uint8_t i, j;
+
+	length = telemetry_encode(batch, message);
+	CHECK(length == sent.length);
+	CHECK(length <= TELEMETRY_MAX_LEN);
+	CHECK(batch->count == 0);
+
+	memset(&decoded, 0, sizeof(decoded));
+	CHECK(telemetry_decode(message, length, &decoded));
+	CHECK(decoded.zone == sent.zone);
+	CHECK(decoded.count == count);
+	CHECK(decoded.property_count == sent.property_count);
+	for(i = 0; i < sent.property_count; i++)
+		CHECK(decoded.property_ids[i] == sent.property_ids[i]);
+	for(j = 0; j < count; j++)
+	{
+		CHECK(decoded.times[j] == sent.times[j]);
+		for(i = 0; i < sent.property_count; i++)
+			CHECK(decoded.values[i][j] == sent.values[i][j]);
+	}
+
+	/* A message cut short is malformed, or lost the properties at its end */
+	for(i = 1; i <= 8 && i < length; i++)
+		CHECK(!telemetry_decode(message, length - i, &decoded) || decoded.property_count < sent.property_count);
+}
+
+static void test_edge_values(void)
+/* Values and deltas on both sides of every varint length, and deltas that wrap around */
+{
+	static const int32_t values[] = {
+		0, -1, 1, -64, 63, 64, -65, -8192, 8191, 8192, -8193,
+		-1048576, 1048575, 1048576, -134217728, 134217727, 134217728,
+		INT32_MAX, INT32_MIN, INT32_MAX, 0, INT32_MIN, -1, INT32_MAX,
+	};
+	static const uint32_t intervals[] = { 0, 1, 127, 128, 16383, 16384, 2097151, 2097152, 268435455, 268435456 };
+	const uint16_t property_ids[] = { 0x0075, 0x00A7 };
+	telemetry_batch_t batch;
+	int32_t sample[2];
+	uint8_t count = sizeof(values) / sizeof(values[0]);
+	uint8_t i;
+
+	CHECK(telemetry_init(&batch, 3, property_ids, 2, count) == ESP_OK);
+	now_us = 0;
+	for(i = 0; i < count; i++)
+	{
+		now_us += (int64_t)intervals[i % (sizeof(intervals) / sizeof(intervals[0]))] * 100000;
+		sample[0] = values[i];
+		sample[1] = ~values[i];
+		CHECK(telemetry_add(&batch, sample) == (i == count - 1));
+	}
+	check_round_trip(&batch, count);
+
+	/* A first time at the top of the uptime range */
+	CHECK(telemetry_init(&batch, 0, property_ids, 1, 1) == ESP_OK);
+	now_us = (int64_t)UINT32_MAX * 100000;
+	sample[0] = INT32_MIN;
+	CHECK(telemetry_add(&batch, sample));
+	check_round_trip(&batch, 1);
+}
+
+static void test_full_message(void)
+/* Four properties swinging by half the range, every delta takes five octets, end the batch on the message length.
+ * A swing over the full range would wrap around to a delta of 1 */
+{
+	const uint16_t property_ids[] = { 0x0075, 0x00A7, 0x0059, 0x0079 };
+	telemetry_batch_t batch;
+	int32_t sample[TELEMETRY_MAX_PROPERTIES];
+	uint8_t count = 0, i;
+	_Bool full = false;
+
+	CHECK(telemetry_init(&batch, 1, property_ids, TELEMETRY_MAX_PROPERTIES, TELEMETRY_MAX_SAMPLES) == ESP_OK);
+	now_us = 1000000;
+	while(!full && count < TELEMETRY_MAX_SAMPLES)
+	{
+		now_us += 60000000;
+		for(i = 0; i < TELEMETRY_MAX_PROPERTIES; i++)
+			sample[i] = (count + i) & 1 ? INT32_MIN : 0;
+		full = telemetry_add(&batch, sample);
+		count++;
+	}
+	CHECK(full);
+	CHECK(count < TELEMETRY_MAX_SAMPLES);
+	/* A sample of five octet varints only, time included, might not have fit */
+	CHECK(batch.length + (1 + TELEMETRY_MAX_PROPERTIES) * 5 > TELEMETRY_MAX_LEN);
+	printf("full batch: %u samples of %u properties in %u octets\n", count, TELEMETRY_MAX_PROPERTIES, batch.length);
+	check_round_trip(&batch, count);
+}
+
+static void test_malformed(void)
+{
+	static telemetry_decoded_t decoded;
+	const uint8_t no_samples[] = { 0, 0 };
+	const uint8_t too_many_samples[] = { 0, TELEMETRY_MAX_SAMPLES + 1 };
+	const uint8_t long_varint[] = { 0, 1, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 };
+	const uint8_t odd_property_id[] = { 0, 1, 0x00, 0x75 };
+
+	CHECK(!telemetry_decode(no_samples, sizeof(no_samples), &decoded));
+	CHECK(!telemetry_decode(too_many_samples, sizeof(too_many_samples), &decoded));
+	CHECK(!telemetry_decode(long_varint, sizeof(long_varint), &decoded));
+	CHECK(!telemetry_decode(odd_property_id, sizeof(odd_property_id), &decoded));
+}
+
+int main(void)
+{
+	test_edge_values();
+	test_full_message();
+	test_malformed();
+
+	if(failures)
+		printf("%d checks failed\n", failures);
+	return failures != 0;
+}